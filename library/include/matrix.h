@@ -15,6 +15,11 @@
 typedef struct sa_matrix_int sa_matrix_int;
 typedef struct sa_matrix_flt sa_matrix_flt;
 
+typedef enum sa_pcc_match {
+  SA_PCC_MAX, // most similar row
+  SA_PCC_MIN  // most different row
+} sa_pcc_match;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -96,6 +101,25 @@ float sa_set_matrix_flt(sa_matrix_flt *m, int row, int col, float v);
 int sa_get_matrix_int(sa_matrix_int *m, int row, int cols);
 float sa_get_matrix_flt(sa_matrix_flt *m, int row, int cols);
 
+/**
+ * Finds the row with the highest (or lowest) Pearson's correlation coefficient
+ * to the specified row. The exact matrix_int row sums are maintained by the
+ * updates so a query is a single dot product pass over the matrix; matrix_flt
+ * rows modified since the previous query are re-summed first. Constant rows
+ * have no coefficient and are skipped; matrix_flt NaN values count as zero.
+ *
+ * @param m Pointer to matrix_int
+ * @param row Row to match
+ * @param match Most similar or most different row
+ * @param pcc Returned Pearson's correlation coefficient of the match
+ *
+ * @return int Row index of the match (-1 no match or invalid row, pcc is not
+ *         modified)
+ */
+int sa_pcc_matrix_int(sa_matrix_int *m, int row, sa_pcc_match match,
+                      double *pcc);
+int sa_pcc_matrix_flt(sa_matrix_flt *m, int row, sa_pcc_match match,
+                      double *pcc);
 
 /**
  * Free the associated memory.
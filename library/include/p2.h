@@ -13,9 +13,12 @@
 #define sa_p2_h_
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct sa_p2_quantile sa_p2_quantile;
 typedef struct sa_p2_histogram sa_p2_histogram;
+typedef struct sa_p2_histogram_flt sa_p2_histogram_flt;
+typedef struct sa_p2_window sa_p2_window;
 
 #ifdef __cplusplus
 extern "C"
@@ -178,6 +181,182 @@ char* sa_serialize_p2_histogram(sa_p2_histogram *p2h, size_t *len);
 int
 sa_deserialize_p2_histogram(sa_p2_histogram *p2h, const char *buf, size_t len);
 
+/**
+ * Allocates and initializes a compact histogram. The marker heights are stored
+ * as float and the marker positions as uint32_t cutting the memory in half
+ * (the histogram stops accepting observations at UINT32_MAX).
+ *
+ * @param buckets Number of histogram buckets
+ *
+ */
+sa_p2_histogram_flt* sa_create_p2_histogram_flt(unsigned short buckets);
+
+/**
+ * Zeros out the histogram counters.
+ *
+ * @param p2h Histogram struct
+ */
+void sa_init_p2_histogram_flt(sa_p2_histogram_flt *p2h);
+
+/**
+ * Updates the histogram with the provided observation.
+ *
+ * @param p2h Histogram struct
+ * @param x Observation to add
+ */
+void sa_add_p2_histogram_flt(sa_p2_histogram_flt *p2h, double x);
+
+/**
+ * Gets the number of observations that are less than or equal to the marker.
+ *
+ * @param p2h Histogram struct
+ * @param marker Selects the percentile (marker/buckets)
+ */
+unsigned long long
+sa_count_p2_histogram_flt(sa_p2_histogram_flt *p2h, unsigned short marker);
+
+/**
+ * Gets the estimated quantile value for the specified marker.
+ *
+ * @param p2h Histogram struct
+ * @param marker Selects the percentile (marker/buckets)
+ */
+double
+sa_estimate_p2_histogram_flt(sa_p2_histogram_flt *p2h, unsigned short marker);
+
+/**
+ * Free the associated memory.
+ *
+ * @param p2h Histogram struct
+ *
+ */
+void sa_destroy_p2_histogram_flt(sa_p2_histogram_flt *p2h);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param p2h Histogram struct
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_p2_histogram_flt(sa_p2_histogram_flt *p2h, size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param p2h Histogram struct
+ * @param buf Buffer containing the output of serialize_p2_histogram_flt
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid cnt
+ *
+ */
+int
+sa_deserialize_p2_histogram_flt(sa_p2_histogram_flt *p2h, const char *buf,
+                                size_t len);
+
+/**
+ * Allocates and initializes a sliding window of P2 histograms. Each row
+ * summarizes the observations for one interval (same row semantics as
+ * sa_time_series_int) and quantiles are estimated across any range of rows
+ * by merging the row summaries.
+ *
+ * @param rows Number of interval slots
+ * @param ns_per_row Nanoseconds represented in each row
+ * @param buckets Number of histogram buckets per row (the marker resolution
+ *                i.e. use 100 for a reasonable p99)
+ *
+ * @return Pointer to p2_window
+ */
+sa_p2_window* sa_create_p2_window(int rows, uint64_t ns_per_row,
+                                  unsigned short buckets);
+
+/**
+ * Zeros out the window.
+ *
+ * @param p2w Window struct
+ */
+void sa_init_p2_window(sa_p2_window *p2w);
+
+/**
+ * Updates the row containing the timestamp with the provided observation.
+ *
+ * @param p2w Window struct
+ * @param ns Timestamp (nanoseconds since Jan 1 1970) associated with x
+ * @param x Observation to add
+ *
+ * @return 0 = success
+ * 1 = timestamp is older than the window
+ */
+int sa_add_p2_window(sa_p2_window *p2w, uint64_t ns, double x);
+
+/**
+ * Estimates the p_quantile over a range of rows.
+ *
+ * @param p2w Window struct
+ * @param ns The start of the interval to analyze
+ * @param n Number of rows in the interval (truncated at the current row)
+ * @param p p_quantile to calculate (0 <= p <= 1)
+ *
+ * @return double Estimate (NaN if the interval is invalid or empty)
+ */
+double sa_estimate_p2_window(sa_p2_window *p2w, uint64_t ns, int n, double p);
+
+/**
+ * Returns the number of observations in a range of rows.
+ *
+ * @param p2w Window struct
+ * @param ns The start of the interval to analyze
+ * @param n Number of rows in the interval (truncated at the current row)
+ */
+unsigned long long
+sa_count_p2_window(sa_p2_window *p2w, uint64_t ns, int n);
+
+/**
+ * Returns the timestamp of the most recent row.
+ *
+ * @param p2w Window struct
+ *
+ * @return Timestamp (nanoseconds since Jan 1 1970)
+ */
+uint64_t sa_timestamp_p2_window(sa_p2_window *p2w);
+
+/**
+ * Free the associated memory.
+ *
+ * @param p2w Window struct
+ */
+void sa_destroy_p2_window(sa_p2_window *p2w);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param p2w Window struct
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_p2_window(sa_p2_window *p2w, size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param p2w Window struct
+ * @param buf Buffer containing the output of serialize_p2_window
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid cnt
+ * 3 = mis-matched dimensions
+ *
+ */
+int
+sa_deserialize_p2_window(sa_p2_window *p2w, const char *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
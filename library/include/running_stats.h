@@ -5,12 +5,16 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 /** Calculates the running count, mean, variance, and standard deviation
+ *  (optionally the min, max, skewness and kurtosis, the covariance and
+ *  correlation of a pair of values, or an exponentially weighted mean and
+ *  variance)
  *  @file */
 
 #ifndef sa_running_stats_h_
 #define sa_running_stats_h_
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct sa_running_stats
 {
@@ -19,6 +23,36 @@ typedef struct sa_running_stats
   double sum;
 } sa_running_stats;
 
+typedef struct sa_moment_stats
+{
+  double count;
+  double mean;
+  double m2;
+  double m3;
+  double m4;
+  double min;
+  double max;
+} sa_moment_stats;
+
+typedef struct sa_bivariate_stats
+{
+  double count;
+  double mean_x;
+  double mean_y;
+  double m2_x;
+  double m2_y;
+  double c_xy;
+} sa_bivariate_stats;
+
+typedef struct sa_ewma_stats
+{
+  uint64_t half_life;
+  uint64_t current_time;
+  double weight;
+  double mean;
+  double sum;
+} sa_ewma_stats;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -39,6 +73,43 @@ void sa_init_running_stats(sa_running_stats *s);
  */
 void sa_add_running_stats(sa_running_stats *s, double d);
 
+/**
+ * Adds an array of values to the running stats. The values are processed in
+ * fixed size blocks (count/mean/M2 computed without a per value division)
+ * that are combined with sa_merge_running_stats. Non finite values are
+ * skipped as in sa_add_running_stats.
+ *
+ * @param s Stat structure
+ * @param v Array of values
+ * @param n Number of elements in the array
+ */
+void sa_add_running_stats_array(sa_running_stats *s, const double *v, size_t n);
+void sa_add_running_stats_array_int(sa_running_stats *s, const int *v,
+                                    size_t n);
+void sa_add_running_stats_array_flt(sa_running_stats *s, const float *v,
+                                    size_t n);
+
+/**
+ * Combines the stats from another partial calculation (Chan et al. pairwise
+ * update).
+ *
+ * @param dst Stat structure receiving the combined result
+ * @param src Stat structure to merge into dst
+ */
+void sa_merge_running_stats(sa_running_stats *dst, const sa_running_stats *src);
+
+/**
+ * Combines an array of partial stats using a pairwise tree reduction (keeps
+ * the error growth logarithmic in the number of partials).
+ *
+ * @param s Stat structure receiving the result (overwritten)
+ * @param partials Array of stat structures
+ * @param n Number of elements in the array
+ */
+void sa_reduce_running_stats(sa_running_stats *s,
+                             const sa_running_stats *partials,
+                             size_t n);
+
 /**
  * Returns the variance of the stats.
  *
@@ -91,6 +162,256 @@ char* sa_serialize_running_stats(sa_running_stats *s, size_t *len);
 int
 sa_deserialize_running_stats(sa_running_stats *s, const char *buf, size_t len);
 
+/**
+ * Zeros out the moment counters.
+ *
+ * @param s Moment structure to zero out
+ */
+void sa_init_moment_stats(sa_moment_stats *s);
+
+/**
+ * Value to add to the moment stats (non finite values are skipped).
+ *
+ * @param s Moment structure
+ * @param d Value to add
+ */
+void sa_add_moment_stats(sa_moment_stats *s, double d);
+
+/**
+ * Adds an array of values to the moment stats (blocked two pass update
+ * combined with sa_merge_moment_stats).
+ *
+ * @param s Moment structure
+ * @param v Array of values
+ * @param n Number of elements in the array
+ */
+void sa_add_moment_stats_array(sa_moment_stats *s, const double *v, size_t n);
+void sa_add_moment_stats_array_int(sa_moment_stats *s, const int *v, size_t n);
+void sa_add_moment_stats_array_flt(sa_moment_stats *s, const float *v,
+                                   size_t n);
+
+/**
+ * Combines the moments from another partial calculation.
+ *
+ * @param dst Moment structure receiving the combined result
+ * @param src Moment structure to merge into dst
+ */
+void sa_merge_moment_stats(sa_moment_stats *dst, const sa_moment_stats *src);
+
+/**
+ * Returns the variance of the moment stats.
+ *
+ * @param s Moment structure
+ *
+ * @return double Variance of the stats up to this point
+ */
+double sa_variance_moment_stats(sa_moment_stats *s);
+
+/**
+ * Returns the corrected sample standard deviation of the moment stats.
+ *
+ * @param s Moment structure
+ *
+ * @return double Standard deviation of the stats up to this point
+ */
+double sa_sd_moment_stats(sa_moment_stats *s);
+
+/**
+ * Returns the uncorrected sample standard deviation of the moment stats.
+ *
+ * @param s Moment structure
+ *
+ * @return double Uncorrected standard deviation of the stats up to this point
+ */
+double sa_usd_moment_stats(sa_moment_stats *s);
+
+/**
+ * Returns the (population) skewness of the moment stats.
+ *
+ * @param s Moment structure
+ *
+ * @return double Skewness, 0 when the variance is 0
+ */
+double sa_skewness_moment_stats(sa_moment_stats *s);
+
+/**
+ * Returns the (population) excess kurtosis of the moment stats.
+ *
+ * @param s Moment structure
+ *
+ * @return double Excess kurtosis, 0 when the variance is 0
+ */
+double sa_kurtosis_moment_stats(sa_moment_stats *s);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param s Moment structure
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_moment_stats(sa_moment_stats *s, size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param s Moment structure
+ * @param buf Buffer containing the output of serialize_moment_stats
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid count value
+ *
+ */
+int
+sa_deserialize_moment_stats(sa_moment_stats *s, const char *buf, size_t len);
+
+/**
+ * Zeros out the bivariate counters.
+ *
+ * @param s Bivariate structure to zero out
+ */
+void sa_init_bivariate_stats(sa_bivariate_stats *s);
+
+/**
+ * Pair of values to add to the bivariate stats (the pair is skipped if either
+ * value is not finite).
+ *
+ * @param s Bivariate structure
+ * @param x First value
+ * @param y Second value
+ */
+void sa_add_bivariate_stats(sa_bivariate_stats *s, double x, double y);
+
+/**
+ * Combines the stats from another partial calculation.
+ *
+ * @param dst Bivariate structure receiving the combined result
+ * @param src Bivariate structure to merge into dst
+ */
+void sa_merge_bivariate_stats(sa_bivariate_stats *dst,
+                              const sa_bivariate_stats *src);
+
+/**
+ * Returns the corrected sample covariance of the pairs.
+ *
+ * @param s Bivariate structure
+ *
+ * @return double Covariance of the stats up to this point
+ */
+double sa_covariance_bivariate_stats(sa_bivariate_stats *s);
+
+/**
+ * Returns the Pearson correlation coefficient of the pairs.
+ *
+ * @param s Bivariate structure
+ *
+ * @return double Correlation [-1, 1], 0 when either variance is 0
+ */
+double sa_correlation_bivariate_stats(sa_bivariate_stats *s);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param s Bivariate structure
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_bivariate_stats(sa_bivariate_stats *s, size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param s Bivariate structure
+ * @param buf Buffer containing the output of serialize_bivariate_stats
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid count value
+ *
+ */
+int sa_deserialize_bivariate_stats(sa_bivariate_stats *s, const char *buf,
+                                   size_t len);
+
+/**
+ * Zeros out the exponentially weighted stats.
+ *
+ * @param s EWMA structure to zero out
+ * @param half_life Number of nanoseconds for a value's weight to halve (> 0)
+ */
+void sa_init_ewma_stats(sa_ewma_stats *s, uint64_t half_life);
+
+/**
+ * Value to add to the exponentially weighted stats. The existing weight is
+ * decayed by the time elapsed since the most recent value; a value older than
+ * the most recent one is decayed itself instead.
+ *
+ * @param s EWMA structure
+ * @param ns Timestamp (nanoseconds since Jan 1 1970) associated with value
+ * @param d Value to add (non finite values are skipped)
+ */
+void sa_add_ewma_stats(sa_ewma_stats *s, uint64_t ns, double d);
+
+/**
+ * Returns the exponentially weighted variance.
+ *
+ * @param s EWMA structure
+ *
+ * @return double Weighted variance of the stats up to this point
+ */
+double sa_variance_ewma_stats(sa_ewma_stats *s);
+
+/**
+ * Returns the exponentially weighted standard deviation.
+ *
+ * @param s EWMA structure
+ *
+ * @return double Weighted standard deviation of the stats up to this point
+ */
+double sa_sd_ewma_stats(sa_ewma_stats *s);
+
+/**
+ * Returns the total weight decayed to the specified time (i.e. the effective
+ * number of recent values).
+ *
+ * @param s EWMA structure
+ * @param ns Timestamp (nanoseconds since Jan 1 1970), values before the most
+ *           recent update return the undecayed weight
+ *
+ * @return double Total weight
+ */
+double sa_weight_ewma_stats(sa_ewma_stats *s, uint64_t ns);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param s EWMA structure
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_ewma_stats(sa_ewma_stats *s, size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param s EWMA structure
+ * @param buf Buffer containing the output of serialize_ewma_stats
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid weight value
+ * 3 = mismatched half life
+ *
+ */
+int
+sa_deserialize_ewma_stats(sa_ewma_stats *s, const char *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
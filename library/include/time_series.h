@@ -12,7 +12,45 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "matrix.h"
+#include "running_stats.h"
+
 typedef struct sa_time_series_int sa_time_series_int;
+typedef struct sa_time_series_int64 sa_time_series_int64;
+typedef struct sa_time_series_flt sa_time_series_flt;
+typedef struct sa_time_series_dbl sa_time_series_dbl;
+typedef struct sa_rollup_time_series_int sa_rollup_time_series_int;
+typedef struct sa_mp_stream_int sa_mp_stream_int;
+typedef struct sa_mp_workspace sa_mp_workspace;
+
+typedef enum sa_merge_op {
+  SA_MERGE_ADD,
+  SA_MERGE_SET
+} sa_merge_op;
+
+#define SA_ROLLUP_MAX_LEVELS 8
+
+typedef enum sa_rollup_cf {
+  SA_ROLLUP_SUM,
+  SA_ROLLUP_MIN, // minimum non zero row
+  SA_ROLLUP_MAX, // maximum non zero row
+  SA_ROLLUP_AVG
+} sa_rollup_cf;
+
+typedef struct sa_range_stats_int
+{
+  int64_t sum;
+  double m2; // sum of squared deviations of the non zero values
+  int min; // minimum non zero value (INT_MAX if there are none)
+  int max; // maximum non zero value (INT_MIN if there are none)
+  int nonzero; // number of non zero rows
+} sa_range_stats_int;
+
+typedef struct sa_mp_discord
+{
+  int idx; // matrix profile index of the sub-sequence
+  double distance; // distance to its nearest neighbor
+} sa_mp_discord;
 
 #ifdef __cplusplus
 extern "C"
@@ -30,6 +68,38 @@ extern "C"
  */
 sa_time_series_int* sa_create_time_series_int(int rows, uint64_t ns_per_row);
 
+/**
+ * Allocates and initializes the data structure with an incrementally
+ * maintained aggregate over the trailing window (see
+ * sa_window_stats_time_series_int).
+ *
+ * @param rows Number of observation slots
+ * @param ns_per_row Nanoseconds represented in each row
+ * @param window Number of trailing rows to aggregate (0 = disabled, <= rows)
+ *
+ * @return Pointer to time_series_int
+ *
+ */
+sa_time_series_int* sa_create_windowed_time_series_int(int rows,
+                                                       uint64_t ns_per_row,
+                                                       int window);
+
+/**
+ * Allocates and initializes the data structure with a range summary index
+ * (segment tree) so sa_range_stats_time_series_int runs in O(log rows). Each
+ * add/set costs an additional O(log rows) update.
+ *
+ * @param rows Number of observation slots
+ * @param ns_per_row Nanoseconds represented in each row
+ * @param window Number of trailing rows to aggregate (0 = disabled, <= rows)
+ *
+ * @return Pointer to time_series_int
+ *
+ */
+sa_time_series_int* sa_create_indexed_time_series_int(int rows,
+                                                      uint64_t ns_per_row,
+                                                      int window);
+
 /**
  * Zeros out the time series.
  *
@@ -50,6 +120,25 @@ void sa_init_time_series_int(sa_time_series_int *ts);
 int
 sa_add_time_series_int(sa_time_series_int *ts, uint64_t ns, int v);
 
+/**
+ * Adds a batch of values to the time series. The ring is advanced once to the
+ * latest timestamp and the values are totaled per row (in any order) before a
+ * single saturating write to each row touched, so the result matches
+ * individual adds except when an intermediate sum would have saturated.
+ *
+ * @param ts Pointer to time_series_int
+ * @param ns Array of timestamps (nanoseconds since Jan 1 1970)
+ * @param v Array of values to add
+ * @param n Number of entries in the arrays
+ *
+ * @return number of values that landed within the time series window
+ *
+ */
+size_t sa_add_time_series_int_batch(sa_time_series_int *ts,
+                                    const uint64_t *ns,
+                                    const int *v,
+                                    size_t n);
+
 /**
  * Sets the time series row to the specified value.
  *
@@ -63,6 +152,22 @@ sa_add_time_series_int(sa_time_series_int *ts, uint64_t ns, int v);
 int
 sa_set_time_series_int(sa_time_series_int *ts, uint64_t ns, int v);
 
+/**
+ * Merges one time series into another, the result matches adding/setting
+ * each source row into the destination in time order. Equal resolutions are
+ * merged as contiguous ring segments; a finer source is reduced per
+ * destination row (summed for add, last row for set) and a coarser source
+ * lands in the first destination row of each source row.
+ *
+ * @param ts Destination time_series_int
+ * @param ts1 Source time_series_int
+ * @param op SA_MERGE_ADD (saturating) or SA_MERGE_SET
+ *
+ */
+void sa_merge_time_series_int(sa_time_series_int *ts,
+                              sa_time_series_int *ts1,
+                              sa_merge_op op);
+
 /**
  * Gets the value of the time series row.
  *
@@ -75,6 +180,46 @@ sa_set_time_series_int(sa_time_series_int *ts, uint64_t ns, int v);
 int
 sa_get_time_series_int(sa_time_series_int *ts, uint64_t ns);
 
+/**
+ * Returns the stats of the trailing window (the most recent 'window' rows
+ * ending at the current row, zeros included). The sum/sum of squares are
+ * updated on every add/set and the min/max are tracked with monotonic deques
+ * so the query is O(1) (a modification to a completed row in the window
+ * triggers a single O(window) rebuild).
+ *
+ * @param ts Pointer to time_series_int
+ * @param rs Returned count/mean/variance of the window
+ * @param min Returned minimum value in the window
+ * @param max Returned maximum value in the window
+ *
+ * @return 0 = success
+ * 1 = no window configured
+ *
+ */
+int sa_window_stats_time_series_int(sa_time_series_int *ts,
+                                    sa_running_stats *rs,
+                                    int *min,
+                                    int *max);
+
+/**
+ * Returns the sum, sum of squared deviations, non zero min/max, and the non
+ * zero row count over a range of rows. O(log rows) when the time series was
+ * created with an index, otherwise the range is scanned.
+ *
+ * @param ts Pointer to time_series_int
+ * @param ns The start of the interval
+ * @param n Number of rows in the interval (0 < n <= rows)
+ * @param rs Returned range stats
+ *
+ * @return 0 = success
+ * 1 = invalid range
+ *
+ */
+int sa_range_stats_time_series_int(sa_time_series_int *ts,
+                                   uint64_t ns,
+                                   int n,
+                                   sa_range_stats_int *rs);
+
 /**
  * Returns the timestamp of the most recent row.
  *
@@ -95,7 +240,11 @@ uint64_t sa_timestamp_time_series_int(sa_time_series_int *ts);
  * @param m Sub-sequence length (n / 4 >= m > 3)
  * @param percent Percentage of data to base the calculation on (0.0 <
  *                percent <= 100). Use less than 100 to produce an estimate
- *                of the matrix profile trading accuracy for speed.
+ *                of the matrix profile trading accuracy for speed. Estimates
+ *                are seeded with a PreSCRIMP pass (SCRIMP++) sampling every
+ *                m-th sub-sequence so a small percentage already locates the
+ *                discords, percent then controls the share of diagonals used
+ *                to refine it.
  * @param mp Returned pointer to the matrix profile array (MUST be freed by the
  *           caller)
  * @param mpi Returned pointer to the matrix profile index array (MUST be freed
@@ -111,6 +260,241 @@ int sa_mp_time_series_int(sa_time_series_int *ts,
                           double *mp[],
                           int *mpi[]);
 
+/**
+ * Computes the matrix profile splitting the diagonals across multiple threads.
+ * The result is identical to sa_mp_time_series_int for the same random seed
+ * regardless of the thread count. Builds without pthread support run the
+ * calculation serially.
+ *
+ * @param ts Pointer to time_series_int
+ * @param ns The start of the interval to analyze
+ * @param n Sequence length (<= ts->rows)
+ * @param m Sub-sequence length (n / 4 >= m > 3)
+ * @param percent Percentage of data to base the calculation on (0.0 <
+ *                percent <= 100)
+ * @param threads Number of threads to use (>= 1), the calling thread is one of
+ *                them
+ * @param mp Returned pointer to the matrix profile array (MUST be freed by the
+ *           caller)
+ * @param mpi Returned pointer to the matrix profile index array (MUST be freed
+ *            by the caller)
+ * @return int Length of the returned matrix profile arrays (0 on failure). The
+ *         mp/i pointers are not modified on failure.
+ */
+int sa_mp_threads_time_series_int(sa_time_series_int *ts,
+                                  uint64_t ns,
+                                  int n,
+                                  int m,
+                                  double percent,
+                                  int threads,
+                                  double *mp[],
+                                  int *mpi[]);
+
+/**
+ * Allocates a reusable matrix profile workspace for a sequence/sub-sequence
+ * length. The workspace owns the profile buffers and a private random number
+ * generator, so repeated calls do not allocate and the diagonal order is
+ * reproducible for a seed and independent of the global rand() state. A
+ * workspace MUST NOT be used by more than one call at a time.
+ *
+ * @param n Sequence length
+ * @param m Sub-sequence length (n / 4 >= m > 3)
+ * @param seed Random number generator seed
+ *
+ * @return Pointer to mp_workspace or NULL on invalid arguments
+ */
+sa_mp_workspace* sa_create_mp_workspace(int n, int m, uint64_t seed);
+
+/**
+ * Reseeds the workspace random number generator.
+ *
+ * @param ws Pointer to mp_workspace
+ * @param seed Random number generator seed
+ */
+void sa_seed_mp_workspace(sa_mp_workspace *ws, uint64_t seed);
+
+/**
+ * Free the associated memory.
+ *
+ * @param ws Pointer to mp_workspace
+ */
+void sa_destroy_mp_workspace(sa_mp_workspace *ws);
+
+/**
+ * Computes the matrix profile using a workspace (see sa_mp_time_series_int
+ * and sa_mp_threads_time_series_int). The sequence/sub-sequence lengths are
+ * the ones the workspace was created with.
+ *
+ * @param ts Pointer to time_series_int
+ * @param ws Pointer to mp_workspace (ws n <= ts->rows)
+ * @param ns The start of the interval to analyze
+ * @param percent Percentage of data to base the calculation on (0.0 <
+ *                percent <= 100)
+ * @param threads Number of threads to use (>= 1)
+ * @param mp Returned pointer to the matrix profile array (owned by the
+ *           workspace, valid until the next call or destroy)
+ * @param mpi Returned pointer to the matrix profile index array (owned by the
+ *            workspace, valid until the next call or destroy)
+ * @return int Length of the returned matrix profile arrays (0 on failure). The
+ *         mp/i pointers are not modified on failure.
+ */
+int sa_mp_workspace_time_series_int(sa_time_series_int *ts,
+                                    sa_mp_workspace *ws,
+                                    uint64_t ns,
+                                    double percent,
+                                    int threads,
+                                    const double *mp[],
+                                    const int *mpi[]);
+
+/**
+ * Computes the distance profile of a query sub-sequence against every
+ * sub-sequence of an interval (MASS, z-normalized Euclidean distance) using
+ * FFT sliding dot products in O(n log m). The query does not have to be part
+ * of the interval, when it is the trivial match (distance 0) is included.
+ *
+ * @param ts Pointer to time_series_int
+ * @param query_ns The start of the query sub-sequence (must be complete)
+ * @param ns The start of the interval to search
+ * @param n Sequence length (<= ts->rows)
+ * @param m Sub-sequence/query length (n / 4 >= m > 3)
+ * @param dp Returned pointer to the distance profile array (MUST be freed by
+ *           the caller)
+ * @return int Length of the returned distance profile array (0 on failure).
+ *         The dp pointer is not modified on failure.
+ */
+int sa_dp_time_series_int(sa_time_series_int *ts,
+                          uint64_t query_ns,
+                          uint64_t ns,
+                          int n,
+                          int m,
+                          double *dp[]);
+
+/**
+ * Computes the distance profile using a workspace (see sa_dp_time_series_int).
+ * The sequence/sub-sequence lengths are the ones the workspace was created
+ * with.
+ *
+ * @param ts Pointer to time_series_int
+ * @param ws Pointer to mp_workspace (ws n <= ts->rows)
+ * @param query_ns The start of the query sub-sequence (must be complete)
+ * @param ns The start of the interval to search
+ * @param dp Returned pointer to the distance profile array (owned by the
+ *           workspace, shares the matrix profile buffer)
+ * @return int Length of the returned distance profile array (0 on failure).
+ *         The dp pointer is not modified on failure.
+ */
+int sa_dp_workspace_time_series_int(sa_time_series_int *ts,
+                                    sa_mp_workspace *ws,
+                                    uint64_t query_ns,
+                                    uint64_t ns,
+                                    const double *dp[]);
+
+/**
+ * Finds the top k non-overlapping discords (largest matrix profile values at
+ * least m entries apart, selected greedily) and estimates the median and 95th
+ * percentile of the profile (P2) without allocating. The first of the k scans
+ * also feeds the estimators.
+ *
+ * @param mp Matrix profile array
+ * @param len Length of the matrix profile array
+ * @param m Sub-sequence length (exclusion zone)
+ * @param k Maximum number of discords to return
+ * @param discords Returned discords (array of k), largest distance first
+ * @param p50 Returned median estimate (NULL to skip)
+ * @param p95 Returned 95th percentile estimate (NULL to skip)
+ * @return int Number of discords returned (< k when the profile is exhausted)
+ */
+int sa_mp_discords(const double *mp,
+                   int len,
+                   int m,
+                   int k,
+                   sa_mp_discord *discords,
+                   double *p50,
+                   double *p95);
+
+/**
+ * Computes the multi-dimensional matrix profile (mSTAMP) of a set of aligned
+ * time series. The k-dimensional profile entry of a sub-sequence is the
+ * smallest mean of the k smallest per dimension distances to another
+ * sub-sequence, so joint patterns spanning only some of the dimensions are
+ * found. The per dimension statistics are computed once and the diagonals are
+ * split across the threads.
+ *
+ * @param ts Array of time_series_int pointers (same ns_per_row)
+ * @param d Number of time series (dimensions)
+ * @param ns The start of the interval to analyze
+ * @param n Sequence length (<= rows of every time series)
+ * @param m Sub-sequence length (n / 4 >= m > 3)
+ * @param threads Number of threads to use (>= 1)
+ * @param mp Returned pointer to the d matrix profiles, the k-dimensional
+ *           profile starts at (k - 1) * length (MUST be freed by the caller)
+ * @param mpi Returned pointer to the d matrix profile indices laid out like
+ *            mp (MUST be freed by the caller)
+ * @return int Length of each returned matrix profile (0 on failure). The mp/i
+ *         pointers are not modified on failure.
+ */
+int sa_mmp_time_series_int(sa_time_series_int *ts[],
+                           int d,
+                           uint64_t ns,
+                           int n,
+                           int m,
+                           int threads,
+                           double *mp[],
+                           int *mpi[]);
+
+/**
+ * Computes the multi-dimensional matrix profile (see sa_mmp_time_series_int)
+ * treating every matrix row as a dimension and the columns as the sequence.
+ *
+ * @param mat Pointer to matrix_int (cols / 4 >= m)
+ * @param m Sub-sequence length (m > 3)
+ * @param threads Number of threads to use (>= 1)
+ * @param mp Returned pointer to the rows matrix profiles (MUST be freed by
+ *           the caller)
+ * @param mpi Returned pointer to the rows matrix profile indices (MUST be
+ *            freed by the caller)
+ * @return int Length of each returned matrix profile (0 on failure). The mp/i
+ *         pointers are not modified on failure.
+ */
+int sa_mmp_matrix_int(sa_matrix_int *mat,
+                      int m,
+                      int threads,
+                      double *mp[],
+                      int *mpi[]);
+
+/**
+ * Computes the AB-join matrix profile: the distance from every sub-sequence
+ * of a to its nearest neighbor in b (z-normalized Euclidean). The same series
+ * can be passed twice to compare two of its ranges, overlapping ranges
+ * include the trivial matches. The diagonals are split across the threads and
+ * the result does not depend on the thread count.
+ *
+ * @param a Pointer to time_series_int
+ * @param ans The start of the a interval
+ * @param na Length of the a sequence (m <= na <= a->rows)
+ * @param b Pointer to time_series_int
+ * @param bns The start of the b interval
+ * @param nb Length of the b sequence (m <= nb <= b->rows)
+ * @param m Sub-sequence length (m > 3)
+ * @param threads Number of threads to use (>= 1)
+ * @param mp Returned pointer to the matrix profile array of a (MUST be freed
+ *           by the caller)
+ * @param mpi Returned pointer to the nearest neighbor offsets within the b
+ *            interval (MUST be freed by the caller)
+ * @return int Length of the returned matrix profile arrays (na - m + 1, 0 on
+ *         failure). The mp/i pointers are not modified on failure.
+ */
+int sa_mp_join_time_series_int(sa_time_series_int *a,
+                               uint64_t ans,
+                               int na,
+                               sa_time_series_int *b,
+                               uint64_t bns,
+                               int nb,
+                               int m,
+                               int threads,
+                               double *mp[],
+                               int *mpi[]);
+
 /**
  * Free the associated memory.
  *
@@ -147,6 +531,228 @@ sa_deserialize_time_series_int(sa_time_series_int *ts,
                                const char *buf,
                                size_t len);
 
+/**
+ * The int64, float and double time series support the same basic operations
+ * as the int version (they are generated from one template). The int64 add
+ * saturates; an out of range timestamp returns INT64_MIN for int64 and NAN
+ * for float/double. The serialization includes a type tag so a buffer can
+ * only be restored into a time series of the same type (returns 3 on a
+ * mismatch).
+ */
+sa_time_series_int64* sa_create_time_series_int64(int rows,
+                                                  uint64_t ns_per_row);
+sa_time_series_flt* sa_create_time_series_flt(int rows, uint64_t ns_per_row);
+sa_time_series_dbl* sa_create_time_series_dbl(int rows, uint64_t ns_per_row);
+
+void sa_init_time_series_int64(sa_time_series_int64 *ts);
+void sa_init_time_series_flt(sa_time_series_flt *ts);
+void sa_init_time_series_dbl(sa_time_series_dbl *ts);
+
+int64_t
+sa_add_time_series_int64(sa_time_series_int64 *ts, uint64_t ns, int64_t v);
+float sa_add_time_series_flt(sa_time_series_flt *ts, uint64_t ns, float v);
+double sa_add_time_series_dbl(sa_time_series_dbl *ts, uint64_t ns, double v);
+
+int64_t
+sa_set_time_series_int64(sa_time_series_int64 *ts, uint64_t ns, int64_t v);
+float sa_set_time_series_flt(sa_time_series_flt *ts, uint64_t ns, float v);
+double sa_set_time_series_dbl(sa_time_series_dbl *ts, uint64_t ns, double v);
+
+int64_t sa_get_time_series_int64(sa_time_series_int64 *ts, uint64_t ns);
+float sa_get_time_series_flt(sa_time_series_flt *ts, uint64_t ns);
+double sa_get_time_series_dbl(sa_time_series_dbl *ts, uint64_t ns);
+
+uint64_t sa_timestamp_time_series_int64(sa_time_series_int64 *ts);
+uint64_t sa_timestamp_time_series_flt(sa_time_series_flt *ts);
+uint64_t sa_timestamp_time_series_dbl(sa_time_series_dbl *ts);
+
+void sa_destroy_time_series_int64(sa_time_series_int64 *ts);
+void sa_destroy_time_series_flt(sa_time_series_flt *ts);
+void sa_destroy_time_series_dbl(sa_time_series_dbl *ts);
+
+char* sa_serialize_time_series_int64(sa_time_series_int64 *ts, size_t *len);
+char* sa_serialize_time_series_flt(sa_time_series_flt *ts, size_t *len);
+char* sa_serialize_time_series_dbl(sa_time_series_dbl *ts, size_t *len);
+
+int sa_deserialize_time_series_int64(sa_time_series_int64 *ts,
+                                     const char *buf,
+                                     size_t len);
+int sa_deserialize_time_series_flt(sa_time_series_flt *ts,
+                                   const char *buf,
+                                   size_t len);
+int sa_deserialize_time_series_dbl(sa_time_series_dbl *ts,
+                                   const char *buf,
+                                   size_t len);
+
+/**
+ * Allocates and initializes a multi-resolution (RRD style) time series. Every
+ * add updates the finest level and cascades to the coarser ones: sum/avg
+ * propagate the value directly, min/max fold each finer row into the coarser
+ * bucket as it completes. A late min/max update to a completed row recomputes
+ * the coarser buckets from their finer rows and is rejected once one of those
+ * buckets has lost some of its finer rows. Values older than the finest level
+ * window are dropped.
+ *
+ * @param levels Number of resolutions (1 - SA_ROLLUP_MAX_LEVELS)
+ * @param rows Number of rows for each level, finest first
+ * @param ns_per_row Nanoseconds per row for each level, each must be a larger
+ *                   multiple of the previous level
+ * @param cf Consolidation function
+ *
+ * @return Pointer to rollup_time_series_int or NULL on invalid arguments
+ */
+sa_rollup_time_series_int*
+sa_create_rollup_time_series_int(int levels,
+                                 const int *rows,
+                                 const uint64_t *ns_per_row,
+                                 sa_rollup_cf cf);
+
+/**
+ * Zeros out all levels of the rollup.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ */
+void sa_init_rollup_time_series_int(sa_rollup_time_series_int *rts);
+
+/**
+ * Adds the specified value to every level of the rollup.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ * @param ns Timestamp (nanoseconds since Jan 1 1970) associated with value
+ * @param v Value to add
+ *
+ * @return current value of the finest level row (INT_MIN if out of range or a
+ *         rejected late min/max update)
+ */
+int sa_add_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                  uint64_t ns,
+                                  int v);
+
+/**
+ * Retrieves the consolidated value of a row, including the rows of the finer
+ * levels that have not completed yet.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ * @param level Level to query (0 = finest)
+ * @param ns Timestamp (nanoseconds since Jan 1 1970) within the row
+ *
+ * @return Consolidated value, the avg is the sum divided by the number of
+ *         finest rows in the bucket (NAN if out of range)
+ */
+double sa_get_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                     int level,
+                                     uint64_t ns);
+
+/**
+ * Returns the timestamp of the current row of the finest level.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ *
+ * @return Nanoseconds since Jan 1 1970
+ */
+uint64_t sa_timestamp_rollup_time_series_int(sa_rollup_time_series_int *rts);
+
+/**
+ * Frees all memory associated with the rollup.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ */
+void sa_destroy_rollup_time_series_int(sa_rollup_time_series_int *rts);
+
+/**
+ * Serialize the internal state to a buffer.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ * @param len Length of the returned buffer
+ *
+ * @return char* Serialized representation MUST be freed by the caller
+ */
+char* sa_serialize_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                          size_t *len);
+
+/**
+ * Restores the internal state from the serialized output.
+ *
+ * @param rts Pointer to rollup_time_series_int
+ * @param buf Buffer containing the output of
+ *            serialize_rollup_time_series_int
+ * @param len Length of the buffer
+ *
+ * @return 0 = success
+ * 1 = invalid buffer length
+ * 2 = invalid ns_per_row
+ * 3 = mis-matched dimensions or consolidation function
+ *
+ */
+int sa_deserialize_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                          const char *buf,
+                                          size_t len);
+
+/**
+ * Allocates an incremental (STAMPI) matrix profile over the trailing n
+ * completed rows of a time series. Each update folds the newly completed rows
+ * into the profile in O(n) per row instead of recomputing it. A profile entry
+ * is the distance to the nearest neighbor among all the sub-sequences that
+ * shared the window with it; the neighbor may since have left the window.
+ * Changes to a row after it has been folded in are not reflected.
+ *
+ * @param ts Pointer to time_series_int (MUST outlive the stream)
+ * @param n Sequence length (< ts->rows)
+ * @param m Sub-sequence length (n / 4 >= m > 3)
+ *
+ * @return Pointer to mp_stream_int or NULL on invalid arguments
+ */
+sa_mp_stream_int* sa_create_mp_stream_int(sa_time_series_int *ts, int n,
+                                          int m);
+
+/**
+ * Discards the profile, the next update rebuilds it from the time series.
+ *
+ * @param mps Pointer to mp_stream_int
+ */
+void sa_init_mp_stream_int(sa_mp_stream_int *mps);
+
+/**
+ * Folds the rows completed since the last update into the profile. If the
+ * time series has advanced past the retained rows the profile is rebuilt.
+ *
+ * @param mps Pointer to mp_stream_int
+ *
+ * @return double Profile value (distance to the nearest neighbor) of the most
+ *         recent sub-sequence (NAN if there are not enough completed rows,
+ *         INFINITY if it has no neighbor outside of its exclusion zone yet)
+ */
+double sa_update_mp_stream_int(sa_mp_stream_int *mps);
+
+/**
+ * Returns the start time of the most recent sub-sequence in the profile.
+ *
+ * @param mps Pointer to mp_stream_int
+ *
+ * @return Timestamp (nanoseconds since Jan 1 1970), 0 if the profile is empty
+ */
+uint64_t sa_timestamp_mp_stream_int(sa_mp_stream_int *mps);
+
+/**
+ * Copies the profile, oldest sub-sequence first.
+ *
+ * @param mps Pointer to mp_stream_int
+ * @param mp Matrix profile array (n - m + 1 elements)
+ * @param mpi Matrix profile index array (n - m + 1 elements) holding the
+ *            offset of the nearest neighbor, -1 when it has left the window
+ *            (either array can be NULL)
+ *
+ * @return int Number of entries copied
+ */
+int sa_get_mp_stream_int(sa_mp_stream_int *mps, double *mp, int *mpi);
+
+/**
+ * Free the associated memory.
+ *
+ * @param mps Pointer to mp_stream_int
+ */
+void sa_destroy_mp_stream_int(sa_mp_stream_int *mps);
+
 #ifdef __cplusplus
 }
 #endif
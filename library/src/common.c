@@ -38,3 +38,52 @@ void b2n(const char *buf, void *n, size_t len)
   memcpy(n, buf, len);
 }
 #endif
+
+
+/* 64 x 64 -> 128 bit multiplication from 32 bit halves */
+static exact_sumsq mul64(uint64_t a, uint64_t b)
+{
+  uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+  uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+  uint64_t p00 = a0 * b0;
+  uint64_t p01 = a0 * b1;
+  uint64_t p10 = a1 * b0;
+  uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+  exact_sumsq r;
+  r.lo = (mid << 32) | (p00 & 0xffffffff);
+  r.hi = a1 * b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+  return r;
+}
+
+
+void exact_sumsq_add(exact_sumsq *s, int v)
+{
+  uint64_t sq = (uint64_t)((int64_t)v * v);
+  s->lo += sq;
+  s->hi += s->lo < sq;
+}
+
+
+void exact_sumsq_sub(exact_sumsq *s, int v)
+{
+  uint64_t sq = (uint64_t)((int64_t)v * v);
+  s->hi -= s->lo < sq;
+  s->lo -= sq;
+}
+
+
+double exact_sumsq_m2(const exact_sumsq *s, int64_t sum, uint32_t n)
+{
+  if (n == 0) {return 0;}
+
+  // n * sumsq < n^2 * 2^62 fits in 128 bits for any 32 bit n
+  exact_sumsq a = mul64(s->lo, n);
+  a.hi += s->hi * n;
+  uint64_t u = sum < 0 ? 0 - (uint64_t)sum : (uint64_t)sum;
+  exact_sumsq b = mul64(u, u);
+  if (a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo)) {return 0;}
+
+  uint64_t hi = a.hi - b.hi - (a.lo < b.lo);
+  uint64_t lo = a.lo - b.lo;
+  return ((double)hi * 18446744073709551616.0 + (double)lo) / n;
+}
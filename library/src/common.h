@@ -10,6 +10,14 @@
 #define sa_common_h_
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* Exact (unsigned 128 bit) sum of squared int values, kept as two words since
+   a portable 128 bit integer type is not available. */
+typedef struct exact_sumsq {
+  uint64_t hi;
+  uint64_t lo;
+} exact_sumsq;
 
 /**
  * Copies a number into a buffer as a little endian representation.
@@ -29,4 +37,32 @@ void n2b(const void *n, char *buf, size_t len);
  */
 void b2n(const char *buf, void *n, size_t len);
 
+/**
+ * Adds the square of a value to an exact sum of squares.
+ *
+ * @param s Sum of squares
+ * @param v Value
+ */
+void exact_sumsq_add(exact_sumsq *s, int v);
+
+/**
+ * Removes the square of a previously added value from an exact sum of squares.
+ *
+ * @param s Sum of squares
+ * @param v Value
+ */
+void exact_sumsq_sub(exact_sumsq *s, int v);
+
+/**
+ * Computes the sum of squared deviations (n * sumsq - sum * sum) / n without
+ * cancellation, only the result is rounded.
+ *
+ * @param s Exact sum of squares of the values
+ * @param sum Exact sum of the values
+ * @param n Number of values
+ *
+ * @return double Sum of squared deviations (0 when n is 0)
+ */
+double exact_sumsq_m2(const exact_sumsq *s, int64_t sum, uint32_t n);
+
 #endif
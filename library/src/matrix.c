@@ -32,11 +32,43 @@ if (r < 0 || r >= m->rows || c < 0 || c >= m->cols) {                          \
 }
 
 
+static void update_stats(matrix_row_stats_int *rs, int ov, int nv)
+{
+  rs->sum += (int64_t)nv - ov;
+  exact_sumsq_sub(&rs->sumsq, ov);
+  exact_sumsq_add(&rs->sumsq, nv);
+}
+
+
+/* Recomputes the sums of a modified row with two passes; a row holding a
+ * single value has an m2 of exactly 0. */
+static void refresh_stats(matrix_row_stats_flt *rs, const float *v, int cols)
+{
+  double first = isnan(v[0]) ? 0 : v[0];
+  double sum = 0;
+  bool constant = true;
+  for (int i = 0; i < cols; ++i) {
+    double x = isnan(v[i]) ? 0 : v[i];
+    sum += x;
+    constant = constant && x == first;
+  }
+  double mean = sum / cols;
+  double m2 = 0;
+  for (int i = 0; !constant && i < cols; ++i) {
+    double d = (isnan(v[i]) ? 0 : v[i]) - mean;
+    m2 += d * d;
+  }
+  rs->sum = sum;
+  rs->m2 = m2;
+  rs->dirty = 0;
+}
+
+
 sa_matrix_int* sa_create_matrix_int(int rows, int cols)
 {
   if (rows < 1 || cols < 1) {return NULL;}
 
-  sa_matrix_int *m = malloc(sizeof(*m) + sizeof(int) * rows * cols);
+  sa_matrix_int *m = malloc(MATRIX_INT_SIZE(rows, cols));
   if (!m) {return NULL;}
 
   m->rows = rows;
@@ -50,7 +82,7 @@ sa_matrix_flt* sa_create_matrix_flt(int rows, int cols)
 {
   if (rows < 1 || cols < 1) {return NULL;}
 
-  sa_matrix_flt *m = malloc(sizeof(*m) + sizeof(float) * rows * cols);
+  sa_matrix_flt *m = malloc(MATRIX_FLT_SIZE(rows, cols));
   if (!m) {return NULL;}
 
   m->rows = rows;
@@ -66,6 +98,7 @@ void sa_init_matrix_row_int(sa_matrix_int *m, int row)
   if (row < 0 || row >= m->rows) {return;};
   int64_t idx = (int64_t)row * m->cols;
   memset(m->v + idx, 0, sizeof(int) * m->cols);
+  memset(MATRIX_STATS_INT(m) + row, 0, sizeof(matrix_row_stats_int));
 }
 
 
@@ -77,6 +110,7 @@ void sa_init_matrix_row_flt(sa_matrix_flt *m, int row)
   for (int c = 0; c < m->cols; ++c) {
     m->v[idx + c] = NAN;
   }
+  memset(MATRIX_STATS_FLT(m) + row, 0, sizeof(matrix_row_stats_flt));
 }
 
 
@@ -96,6 +130,7 @@ void sa_init_matrix_int(sa_matrix_int *m)
 {
   assert(m);
   memset(m->v, 0, sizeof(int) * m->rows * m->cols);
+  memset(MATRIX_STATS_INT(m), 0, sizeof(matrix_row_stats_int) * m->rows);
 }
 
 
@@ -105,6 +140,7 @@ void sa_init_matrix_flt(sa_matrix_flt *m)
   for (int64_t i = 0; i < (int64_t)m->rows * m->cols; ++i) {
     m->v[i] = NAN;
   }
+  memset(MATRIX_STATS_FLT(m), 0, sizeof(matrix_row_stats_flt) * m->rows);
 }
 
 
@@ -118,6 +154,7 @@ int sa_add_matrix_int(sa_matrix_int *m, int row, int col, int v)
   } else if (nv < INT_MIN) {
     nv = INT_MIN;
   }
+  update_stats(MATRIX_STATS_INT(m) + row, m->v[idx], (int)nv);
   m->v[idx] = nv;
   return nv;
 }
@@ -132,6 +169,7 @@ float sa_add_matrix_flt(sa_matrix_flt *m, int row, int col, float v)
   } else {
     m->v[idx] += v;
   }
+  MATRIX_STATS_FLT(m)[row].dirty = 1;
   return m->v[idx];
 }
 
@@ -140,6 +178,7 @@ int sa_set_matrix_int(sa_matrix_int *m, int row, int col, int v)
 {
   check_bounds_int(m, row, col);
   int64_t idx = (int64_t)row * m->cols + col;
+  update_stats(MATRIX_STATS_INT(m) + row, m->v[idx], v);
   m->v[idx] = v;
   return v;
 }
@@ -150,6 +189,7 @@ float sa_set_matrix_flt(sa_matrix_flt *m, int row, int col, float v)
   check_bounds_flt(m, row, col);
   int64_t idx = (int64_t)row * m->cols + col;
   m->v[idx] = v;
+  MATRIX_STATS_FLT(m)[row].dirty = 1;
   return v;
 }
 
@@ -170,6 +210,96 @@ float sa_get_matrix_flt(sa_matrix_flt *m, int row, int col)
 }
 
 
+/* Returns the sum of squared deviations of a row, constant rows return 0. */
+static double row_m2(const matrix_row_stats_int *rs, int cols)
+{
+  return exact_sumsq_m2(&rs->sumsq, rs->sum, (uint32_t)cols);
+}
+
+
+static const matrix_row_stats_flt* row_stats(sa_matrix_flt *m, int row)
+{
+  matrix_row_stats_flt *rs = MATRIX_STATS_FLT(m) + row;
+  if (rs->dirty) {
+    refresh_stats(rs, m->v + (int64_t)row * m->cols, m->cols);
+  }
+  return rs;
+}
+
+
+static bool pcc_better(sa_pcc_match match, double pcc, double best)
+{
+  return match == SA_PCC_MIN ? pcc < best : pcc > best;
+}
+
+
+int sa_pcc_matrix_int(sa_matrix_int *m, int row, sa_pcc_match match,
+                      double *pcc)
+{
+  assert(m && pcc);
+  if (row < 0 || row >= m->rows || m->cols < 2) {return -1;}
+
+  const matrix_row_stats_int *rs = MATRIX_STATS_INT(m);
+  double m2 = row_m2(rs + row, m->cols);
+  if (m2 == 0) {return -1;}
+
+  const int *a = m->v + (int64_t)row * m->cols;
+  double best = match == SA_PCC_MIN ? INFINITY : -INFINITY;
+  int idx = -1;
+  for (int r = 0; r < m->rows; ++r) {
+    double m2r = row_m2(rs + r, m->cols);
+    if (r == row || m2r == 0) {continue;}
+
+    const int *b = m->v + (int64_t)r * m->cols;
+    double d = 0;
+    for (int i = 0; i < m->cols; ++i) {
+      d += (double)a[i] * b[i];
+    }
+    d = (d - (double)rs[row].sum * rs[r].sum / m->cols) / sqrt(m2 * m2r);
+    if (pcc_better(match, d, best)) {
+      best = d;
+      idx = r;
+    }
+  }
+  if (idx != -1) {*pcc = best;}
+  return idx;
+}
+
+
+int sa_pcc_matrix_flt(sa_matrix_flt *m, int row, sa_pcc_match match,
+                      double *pcc)
+{
+  assert(m && pcc);
+  if (row < 0 || row >= m->rows || m->cols < 2) {return -1;}
+
+  const matrix_row_stats_flt *rs = row_stats(m, row);
+  if (rs->m2 == 0) {return -1;}
+
+  const float *a = m->v + (int64_t)row * m->cols;
+  double best = match == SA_PCC_MIN ? INFINITY : -INFINITY;
+  int idx = -1;
+  for (int r = 0; r < m->rows; ++r) {
+    if (r == row) {continue;}
+    const matrix_row_stats_flt *rsr = row_stats(m, r);
+    if (rsr->m2 == 0) {continue;}
+
+    const float *b = m->v + (int64_t)r * m->cols;
+    double d = 0;
+    for (int i = 0; i < m->cols; ++i) {
+      double p = (double)a[i] * b[i];
+      d += isnan(p) ? 0 : p;
+    }
+    d = (d - rs->sum * rsr->sum / m->cols) / sqrt(rs->m2 * rsr->m2);
+    if (pcc_better(match, d, best)) {
+      best = d;
+      idx = r;
+    }
+  }
+  if (idx != -1) {*pcc = best;}
+  return idx;
+}
+
+
 static size_t matrix_int_size(sa_matrix_int *m)
 {
   return sizeof(sa_matrix_int) + sizeof(int) * m->rows * m->cols;
@@ -265,7 +395,14 @@ int sa_deserialize_matrix_int(sa_matrix_int *m, const char *buf, size_t len)
   for (int64_t i = 0; i < (int64_t)rows * cols; ++i, cp += sizeof(int)) {
     b2n(cp, m->v + i, sizeof(int));
   }
-
+  // the row statistics are not serialized
+  matrix_row_stats_int *rs = MATRIX_STATS_INT(m);
+  for (int r = 0; r < rows; ++r) {
+    rs[r] = (matrix_row_stats_int){ 0, { 0, 0 } };
+    for (int c = 0; c < cols; ++c) {
+      update_stats(rs + r, 0, m->v[(int64_t)r * cols + c]);
+    }
+  }
   return 0;
 }
 
@@ -300,6 +437,8 @@ int sa_deserialize_matrix_flt(sa_matrix_flt *m, const char *buf, size_t len)
   for (int64_t i = 0; i < (int64_t)rows * cols; ++i, cp += sizeof(float)) {
     b2n(cp, m->v + i, sizeof(float));
   }
-
+  for (int r = 0; r < rows; ++r) {
+    MATRIX_STATS_FLT(m)[r].dirty = 1;
+  }
   return 0;
 }
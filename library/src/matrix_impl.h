@@ -9,6 +9,7 @@
 #ifndef sa_matrix_impl_h_
 #define sa_matrix_impl_h_
 
+#include "common.h"
 #include "matrix.h"
 
 struct sa_matrix_int {
@@ -23,4 +24,38 @@ struct sa_matrix_flt {
   float v[];
 };
 
+/* Per row statistics stored after the values (8 byte aligned). The int rows
+   keep an exact sum and sum of squares maintained by every update; the float
+   rows are flagged by the updates and re-summed on the next query (NaN counts
+   as zero) so neither can drift. */
+typedef struct matrix_row_stats_int {
+  int64_t sum;
+  exact_sumsq sumsq;
+} matrix_row_stats_int;
+
+typedef struct matrix_row_stats_flt {
+  double sum;
+  double m2; // sum of squared deviations (0 for a constant row)
+  int dirty; // the row was modified, sum and m2 must be recomputed
+} matrix_row_stats_flt;
+
+#define MATRIX_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+#define MATRIX_STATS_OFFSET(m) \
+  MATRIX_ALIGN(sizeof(*(m)) + sizeof((m)->v[0]) * (size_t)(m)->rows * (m)->cols)
+
+#define MATRIX_STATS_INT(m) \
+  ((matrix_row_stats_int *)((char *)(m) + MATRIX_STATS_OFFSET(m)))
+
+#define MATRIX_STATS_FLT(m) \
+  ((matrix_row_stats_flt *)((char *)(m) + MATRIX_STATS_OFFSET(m)))
+
+#define MATRIX_INT_SIZE(rows, cols) \
+  (MATRIX_ALIGN(sizeof(sa_matrix_int) + sizeof(int) * (size_t)(rows) * (cols)) \
+   + sizeof(matrix_row_stats_int) * (rows))
+
+#define MATRIX_FLT_SIZE(rows, cols) \
+  (MATRIX_ALIGN(sizeof(sa_matrix_flt) + sizeof(float) * (size_t)(rows) * \
+                (cols)) + sizeof(matrix_row_stats_flt) * (rows))
+
 #endif
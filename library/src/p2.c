@@ -9,16 +9,33 @@
 #include <assert.h>
 #include <limits.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "common.h"
 #include "p2_impl.h"
 
-static int compare_double(const void *a, const void *b)
+#define INSERTION_SORT_MAX 64
+
+#define cmp_swap(q, a, b)                                                      \
+if (q[b] < q[a]) {                                                             \
+  double t = q[a];                                                             \
+  q[a] = q[b];                                                                 \
+  q[b] = t;                                                                    \
+}
+
+/* optimal 9 comparator sorting network for the quantile warm-up */
+static void sort_markers(double *q)
 {
-  if (*(double *)a < *(double *)b) {return -1;}
-  if (*(double *)a == *(double *)b) {return 0;}
-  return 1;
+  cmp_swap(q, 0, 1);
+  cmp_swap(q, 3, 4);
+  cmp_swap(q, 2, 4);
+  cmp_swap(q, 2, 3);
+  cmp_swap(q, 0, 3);
+  cmp_swap(q, 0, 2);
+  cmp_swap(q, 1, 4);
+  cmp_swap(q, 1, 3);
+  cmp_swap(q, 1, 2);
 }
 
 
@@ -91,7 +108,7 @@ double sa_add_p2_quantile(sa_p2_quantile *p2q, double x)
   if (p2q->cnt) {
     p2q->q[--p2q->cnt] = x;
     if (p2q->cnt == 0) {
-      qsort(p2q->q, QUANTILE_MARKERS, sizeof(double), compare_double);
+      sort_markers(p2q->q);
       return p2q->n[2];
     }
     return NAN;
@@ -244,128 +261,356 @@ sa_deserialize_p2_quantile(sa_p2_quantile *p2q, const char *buf, size_t len)
 }
 
 
-sa_p2_histogram* sa_create_p2_histogram(unsigned short buckets)
+#define P2H_NAME(name) name
+#define P2H_T sa_p2_histogram
+#define P2H_Q double
+#define P2H_N double
+#define P2H_SIZE(b) P2_HISTOGRAM_SIZE(b)
+#include "p2_histogram_tmpl.h"
+
+
+static size_t histogram_size(sa_p2_histogram *p2h)
+{
+  return sizeof(unsigned short) + sizeof(double) * (p2h->b + 1U) * 2;
+}
+
+
+char* sa_serialize_p2_histogram(sa_p2_histogram *p2h, size_t *len)
+{
+  assert(p2h && len);
+
+  *len = histogram_size(p2h);
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+
+  char *cp = buf;
+  n2b(&p2h->cnt, cp, sizeof(unsigned short));
+  cp += sizeof(unsigned short);
+  for (unsigned i = 0; i < (p2h->b + 1U) * 2; ++i, cp += sizeof(double)) {
+    n2b(p2h->data + i, cp, sizeof(double));
+  }
+  return buf;
+}
+
+
+int
+sa_deserialize_p2_histogram(sa_p2_histogram *p2h, const char *buf, size_t len)
+{
+  assert(p2h && buf);
+
+  size_t elen = histogram_size(p2h);
+  if (len != elen) {
+    sa_init_p2_histogram(p2h);
+    return 1;
+  }
+
+  const char *cp = buf;
+  b2n(cp, &p2h->cnt, sizeof(unsigned short));
+  if (p2h->cnt > p2h->b + 1) {
+    sa_init_p2_histogram(p2h);
+    return 2;
+  }
+  cp += sizeof(unsigned short);
+  for (unsigned i = 0; i < (p2h->b + 1U) * 2; ++i, cp += sizeof(double)) {
+    b2n(cp, p2h->data + i, sizeof(double));
+  }
+  return 0;
+}
+
+
+#define P2H_NAME(name) name ## _flt
+#define P2H_T sa_p2_histogram_flt
+#define P2H_Q float
+#define P2H_N uint32_t
+#define P2H_SIZE(b) P2_HISTOGRAM_FLT_SIZE(b)
+#define P2H_N_MAX UINT32_MAX
+#include "p2_histogram_tmpl.h"
+
+
+static size_t histogram_flt_size(sa_p2_histogram_flt *p2h)
+{
+  return sizeof(unsigned short) + (sizeof(float) + sizeof(uint32_t))
+      * (p2h->b + 1U);
+}
+
+
+char* sa_serialize_p2_histogram_flt(sa_p2_histogram_flt *p2h, size_t *len)
 {
-  if (buckets < 4 || buckets > USHRT_MAX - 1) {return NULL;}
+  assert(p2h && len);
 
-  sa_p2_histogram *p2h = malloc(sizeof(*p2h) + sizeof(double) * (buckets + 1)
-                                * 2);
-  if (!p2h) {return NULL;}
+  *len = histogram_flt_size(p2h);
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
 
-  p2h->b = buckets;
-  sa_init_p2_histogram(p2h);
-  return p2h;
+  char *cp = buf;
+  n2b(&p2h->cnt, cp, sizeof(unsigned short));
+  cp += sizeof(unsigned short);
+  for (unsigned i = 0; i <= p2h->b; ++i, cp += sizeof(float)) {
+    n2b(p2h->data + i, cp, sizeof(float));
+  }
+  uint32_t *n = (uint32_t *)(p2h->data + p2h->b + 1);
+  for (unsigned i = 0; i <= p2h->b; ++i, cp += sizeof(uint32_t)) {
+    n2b(n + i, cp, sizeof(uint32_t));
+  }
+  return buf;
 }
 
 
-void sa_init_p2_histogram(sa_p2_histogram *p2h)
+int
+sa_deserialize_p2_histogram_flt(sa_p2_histogram_flt *p2h, const char *buf,
+                                size_t len)
 {
-  assert(p2h);
+  assert(p2h && buf);
 
-  p2h->cnt = p2h->b + 1;
-  for (unsigned short i = 0; i <= p2h->b; ++i) {
-    p2h->data[i] = 0;
+  size_t elen = histogram_flt_size(p2h);
+  if (len != elen) {
+    sa_init_p2_histogram_flt(p2h);
+    return 1;
   }
 
-  double *n = p2h->data + p2h->b + 1;
-  for (unsigned short i = 0; i <= p2h->b; ++i) {
-    n[i] = i + 1;
+  const char *cp = buf;
+  b2n(cp, &p2h->cnt, sizeof(unsigned short));
+  if (p2h->cnt > p2h->b + 1) {
+    sa_init_p2_histogram_flt(p2h);
+    return 2;
+  }
+  cp += sizeof(unsigned short);
+  for (unsigned i = 0; i <= p2h->b; ++i, cp += sizeof(float)) {
+    b2n(cp, p2h->data + i, sizeof(float));
+  }
+  uint32_t *n = (uint32_t *)(p2h->data + p2h->b + 1);
+  for (unsigned i = 0; i <= p2h->b; ++i, cp += sizeof(uint32_t)) {
+    b2n(cp, n + i, sizeof(uint32_t));
   }
+  return 0;
 }
 
 
-void sa_add_p2_histogram(sa_p2_histogram *p2h, double x)
+static sa_p2_histogram* window_row(sa_p2_window *p2w, int idx)
 {
-  assert(p2h);
+  return (sa_p2_histogram *)((char *)p2w->data + P2_HISTOGRAM_SIZE(p2w->b)
+                             * idx);
+}
+
 
-  if (p2h->cnt) {
-    p2h->data[--p2h->cnt] = x;
-    if (p2h->cnt == 0) {
-      qsort(p2h->data, p2h->b + 1, sizeof(double), compare_double);
+static int find_index_window(sa_p2_window *p2w, uint64_t ns, bool advance)
+{
+  int64_t current_row = p2w->current_time / p2w->ns_per_row;
+  int64_t requested_row = ns / p2w->ns_per_row;
+  int64_t row_delta = requested_row - current_row;
+
+  if (row_delta > 0 && advance) {
+    if (row_delta >= p2w->rows) {
+      sa_init_p2_window(p2w);
+    } else {
+      int idx = current_row % p2w->rows;
+      for (int64_t i = 0; i < row_delta; ++i) {
+        if (++idx == p2w->rows) {idx = 0;}
+        sa_init_p2_histogram(window_row(p2w, idx));
+      }
     }
-    return;
+    p2w->current_time = ns - (ns % p2w->ns_per_row);
+  } else if (row_delta > 0 || row_delta <= -p2w->rows) {
+    return -1;
   }
+  return requested_row % p2w->rows;
+}
 
+
+/* number of observations in the row that are less than or equal to x, linearly
+   interpolated between the markers */
+static double row_rank(sa_p2_histogram *p2h, double x)
+{
+  unsigned short b = p2h->b;
   double *q = p2h->data;
-  double *n = p2h->data + p2h->b + 1;
-  int k = 0;
-  if (x < q[0]) {
-    q[0] = x;
-    k = 1;
-  } else {
-    for (unsigned short i = 0; i < p2h->b - 1; ++i) {
-      if (q[i] <= x && x < q[i + 1]) {
-        k = i + 1;
-        break;
-      }
+  double *n = p2h->data + b + 1;
+
+  if (p2h->cnt) { // warm-up, the observations are stored as is
+    double r = 0;
+    for (int i = p2h->cnt; i <= b; ++i) {
+      if (q[i] <= x) {++r;}
     }
+    return r;
   }
-  if (k == 0) {
-    if (q[p2h->b - 1] <= x && x <= q[p2h->b]) {
-      k = p2h->b;
-    } else if (q[p2h->b] < x) {
-      q[p2h->b] = x;
-      k = p2h->b;
+
+  if (x < q[0]) {return 0;}
+  if (x >= q[b]) {return n[b];}
+  int lo = 0, hi = b;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (q[mid] <= x) {
+      lo = mid;
+    } else {
+      hi = mid;
     }
   }
+  return n[lo] + (n[hi] - n[lo]) * (x - q[lo]) / (q[hi] - q[lo]);
+}
 
-  for (unsigned short i = k; i <= p2h->b; ++i) {
-    ++n[i];
+
+static double row_observations(sa_p2_histogram *p2h)
+{
+  if (p2h->cnt) {return p2h->b + 1 - p2h->cnt;}
+  return p2h->data[p2h->b * 2 + 1];
+}
+
+
+static int window_range(sa_p2_window *p2w, uint64_t ns, int *n)
+{
+  if (*n < 1 || *n > p2w->rows) {return -1;}
+  int idx = find_index_window(p2w, ns, false);
+  if (idx == -1) {return -1;}
+  int64_t available = p2w->current_time / p2w->ns_per_row
+      - ns / p2w->ns_per_row + 1;
+  if (*n > available) {*n = (int)available;}
+  return idx;
+}
+
+
+sa_p2_window* sa_create_p2_window(int rows, uint64_t ns_per_row,
+                                  unsigned short buckets)
+{
+  if (rows < 2 || ns_per_row < 1 || buckets < 4 || buckets > USHRT_MAX - 1) {
+    return NULL;
   }
 
-  for (unsigned short i = 1; i < p2h->b; ++i) {
-    double n1 = 1 + i * (n[p2h->b] - 1) / p2h->b;
-    double d = n1 - n[i];
-    if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
-      d = (d > 0) ? 1 : -1;
-      double q1 = parabolic(i, d, q, n);
-      if (q[i - 1] < q1 && q1 < q[i + 1]) {
-        q[i] = q1;
-      } else {
-        q[i] = linear(i, d, q, n);
-      }
-      n[i] += d;
-    }
+  sa_p2_window *p2w = malloc(sizeof(*p2w) + P2_HISTOGRAM_SIZE(buckets) * rows);
+  if (!p2w) {return NULL;}
+
+  p2w->ns_per_row = ns_per_row;
+  p2w->rows = rows;
+  p2w->b = buckets;
+  sa_init_p2_window(p2w);
+  return p2w;
+}
+
+
+void sa_init_p2_window(sa_p2_window *p2w)
+{
+  assert(p2w);
+
+  p2w->current_time = p2w->ns_per_row * (p2w->rows - 1);
+  for (int i = 0; i < p2w->rows; ++i) {
+    sa_p2_histogram *p2h = window_row(p2w, i);
+    p2h->b = p2w->b;
+    sa_init_p2_histogram(p2h);
   }
 }
 
 
-double sa_estimate_p2_histogram(sa_p2_histogram *p2h, unsigned short marker)
+int sa_add_p2_window(sa_p2_window *p2w, uint64_t ns, double x)
 {
-  assert(p2h);
+  assert(p2w);
 
-  if (marker > p2h->b || p2h->cnt != 0) return NAN;
-  return p2h->data[marker];
+  int idx = find_index_window(p2w, ns, true);
+  if (idx == -1) {return 1;}
+  sa_add_p2_histogram(window_row(p2w, idx), x);
+  return 0;
+}
+
+
+double sa_estimate_p2_window(sa_p2_window *p2w, uint64_t ns, int n, double p)
+{
+  assert(p2w);
+
+  if (p < 0 || p > 1) {return NAN;}
+  int sidx = window_range(p2w, ns, &n);
+  if (sidx == -1) {return NAN;}
+
+  double cnt = 0;
+  double lo = INFINITY;
+  double hi = -INFINITY;
+  for (int i = 0, idx = sidx; i < n; ++i, ++idx) {
+    if (idx == p2w->rows) {idx = 0;}
+    sa_p2_histogram *p2h = window_row(p2w, idx);
+    if (p2h->cnt) {
+      for (int j = p2h->cnt; j <= p2h->b; ++j) {
+        if (p2h->data[j] < lo) {lo = p2h->data[j];}
+        if (p2h->data[j] > hi) {hi = p2h->data[j];}
+      }
+    } else {
+      if (p2h->data[0] < lo) {lo = p2h->data[0];}
+      if (p2h->data[p2h->b] > hi) {hi = p2h->data[p2h->b];}
+    }
+    cnt += row_observations(p2h);
+  }
+  if (cnt == 0) {return NAN;}
+
+  // bisect the merged (monotonic) rank function for the target position
+  double target = 1 + p * (cnt - 1);
+  for (int iter = 0; iter < 128; ++iter) {
+    double mid = lo + (hi - lo) / 2;
+    if (mid <= lo || mid >= hi) {break;}
+    double rank = 0;
+    for (int i = 0, idx = sidx; i < n; ++i, ++idx) {
+      if (idx == p2w->rows) {idx = 0;}
+      rank += row_rank(window_row(p2w, idx), mid);
+    }
+    if (rank >= target) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+
+  double rank = 0;
+  for (int i = 0, idx = sidx; i < n; ++i, ++idx) {
+    if (idx == p2w->rows) {idx = 0;}
+    rank += row_rank(window_row(p2w, idx), lo);
+  }
+  return rank >= target ? lo : hi;
 }
 
 
 unsigned long long
-sa_count_p2_histogram(sa_p2_histogram *p2h, unsigned short marker)
+sa_count_p2_window(sa_p2_window *p2w, uint64_t ns, int n)
 {
-  assert(p2h);
+  assert(p2w);
 
-  if (marker > p2h->b || p2h->cnt != 0) return 0;
-  return (unsigned long long)p2h->data[p2h->b + 1 + marker];
+  int idx = window_range(p2w, ns, &n);
+  if (idx == -1) {return 0;}
+
+  double cnt = 0;
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == p2w->rows) {idx = 0;}
+    cnt += row_observations(window_row(p2w, idx));
+  }
+  return (unsigned long long)cnt;
 }
 
 
-void sa_destroy_p2_histogram(sa_p2_histogram *p2h)
+uint64_t sa_timestamp_p2_window(sa_p2_window *p2w)
 {
-  free(p2h);
+  assert(p2w);
+  return p2w->current_time;
 }
 
 
-static size_t histogram_size(sa_p2_histogram *p2h)
+void sa_destroy_p2_window(sa_p2_window *p2w)
 {
-  return sizeof(unsigned short) + sizeof(double) * (p2h->b + 1U) * 2;
+  free(p2w);
 }
 
 
-char* sa_serialize_p2_histogram(sa_p2_histogram *p2h, size_t *len)
+static size_t window_size(sa_p2_window *p2w)
 {
-  assert(p2h && len);
+  return sizeof(uint64_t) * 2 + sizeof(int) + sizeof(unsigned short)
+      + (sizeof(unsigned short) + sizeof(double) * (p2w->b + 1U) * 2)
+      * p2w->rows;
+}
 
-  *len = histogram_size(p2h);
+
+char* sa_serialize_p2_window(sa_p2_window *p2w, size_t *len)
+{
+  assert(p2w && len);
+
+  *len = window_size(p2w);
   char *buf = malloc(*len);
   if (!buf) {
     *len = 0;
@@ -373,35 +618,75 @@ char* sa_serialize_p2_histogram(sa_p2_histogram *p2h, size_t *len)
   }
 
   char *cp = buf;
-  n2b(&p2h->cnt, cp, sizeof(unsigned short));
+  n2b(&p2w->current_time, cp, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  n2b(&p2w->ns_per_row, cp, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  n2b(&p2w->rows, cp, sizeof(int));
+  cp += sizeof(int);
+
+  n2b(&p2w->b, cp, sizeof(unsigned short));
   cp += sizeof(unsigned short);
-  for (unsigned i = 0; i < (p2h->b + 1U) * 2; ++i, cp += sizeof(double)) {
-    n2b(p2h->data + i, cp, sizeof(double));
+
+  for (int r = 0; r < p2w->rows; ++r) {
+    sa_p2_histogram *p2h = window_row(p2w, r);
+    n2b(&p2h->cnt, cp, sizeof(unsigned short));
+    cp += sizeof(unsigned short);
+    for (unsigned i = 0; i < (p2w->b + 1U) * 2; ++i, cp += sizeof(double)) {
+      n2b(p2h->data + i, cp, sizeof(double));
+    }
   }
   return buf;
 }
 
 
 int
-sa_deserialize_p2_histogram(sa_p2_histogram *p2h, const char *buf, size_t len)
+sa_deserialize_p2_window(sa_p2_window *p2w, const char *buf, size_t len)
 {
-  assert(p2h && buf);
+  assert(p2w && buf);
 
-  size_t elen = histogram_size(p2h);
+  size_t elen = window_size(p2w);
   if (len != elen) {
-    sa_init_p2_histogram(p2h);
+    sa_init_p2_window(p2w);
     return 1;
   }
 
   const char *cp = buf;
-  b2n(cp, &p2h->cnt, sizeof(unsigned short));
-  if (p2h->cnt > p2h->b + 1) {
-    sa_init_p2_histogram(p2h);
-    return 2;
-  }
+  uint64_t current_time;
+  b2n(cp, &current_time, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  uint64_t ns_per_row;
+  b2n(cp, &ns_per_row, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  int rows;
+  b2n(cp, &rows, sizeof(int));
+  cp += sizeof(int);
+
+  unsigned short b;
+  b2n(cp, &b, sizeof(unsigned short));
   cp += sizeof(unsigned short);
-  for (unsigned i = 0; i < (p2h->b + 1U) * 2; ++i, cp += sizeof(double)) {
-    b2n(cp, p2h->data + i, sizeof(double));
+
+  if (ns_per_row != p2w->ns_per_row || rows != p2w->rows || b != p2w->b) {
+    sa_init_p2_window(p2w);
+    return 3;
+  }
+
+  for (int r = 0; r < rows; ++r) {
+    sa_p2_histogram *p2h = window_row(p2w, r);
+    b2n(cp, &p2h->cnt, sizeof(unsigned short));
+    cp += sizeof(unsigned short);
+    if (p2h->cnt > b + 1) {
+      sa_init_p2_window(p2w);
+      return 2;
+    }
+    for (unsigned i = 0; i < (b + 1U) * 2; ++i, cp += sizeof(double)) {
+      b2n(cp, p2h->data + i, sizeof(double));
+    }
   }
+  p2w->current_time = current_time;
   return 0;
 }
@@ -0,0 +1,169 @@
+/* -*- Mode: C; tab_width: 8; indent_tabs_mode: nil; c_basic_offset: 2 -*- */
+/* vim: set ts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/** Typed P2 histogram implementation template. Included once per storage
+ *  layout with the following macros defined (they are undefined at the end):
+ *  - P2H_NAME(name) function name for the layout e.g. name ## _flt
+ *  - P2H_T          histogram type (b + 1 heights followed by b + 1 positions)
+ *  - P2H_Q          marker height type
+ *  - P2H_N          marker position type
+ *  - P2H_SIZE(b)    allocation size for b buckets
+ *  - P2H_N_MAX      (optional) largest position, further values are ignored
+ *  @file */
+
+#define P2H_POSITIONS(p2h) ((P2H_N *)((p2h)->data + (p2h)->b + 1))
+
+static int P2H_NAME(compare_heights)(const void *a, const void *b)
+{
+  if (*(P2H_Q *)a < *(P2H_Q *)b) {return -1;}
+  if (*(P2H_Q *)a == *(P2H_Q *)b) {return 0;}
+  return 1;
+}
+
+
+/* insertion sort for typical bucket counts, qsort for the large ones */
+static void P2H_NAME(sort_histogram)(P2H_Q *q, int len)
+{
+  if (len > INSERTION_SORT_MAX) {
+    qsort(q, len, sizeof(P2H_Q), P2H_NAME(compare_heights));
+    return;
+  }
+
+  for (int i = 1; i < len; ++i) {
+    P2H_Q x = q[i];
+    int j = i - 1;
+    for (; j >= 0 && x < q[j]; --j) {
+      q[j + 1] = q[j];
+    }
+    q[j + 1] = x;
+  }
+}
+
+
+P2H_T* P2H_NAME(sa_create_p2_histogram)(unsigned short buckets)
+{
+  if (buckets < 4 || buckets > USHRT_MAX - 1) {return NULL;}
+
+  P2H_T *p2h = malloc(P2H_SIZE(buckets));
+  if (!p2h) {return NULL;}
+
+  p2h->b = buckets;
+  P2H_NAME(sa_init_p2_histogram)(p2h);
+  return p2h;
+}
+
+
+void P2H_NAME(sa_init_p2_histogram)(P2H_T *p2h)
+{
+  assert(p2h);
+
+  p2h->cnt = p2h->b + 1;
+  for (unsigned short i = 0; i <= p2h->b; ++i) {
+    p2h->data[i] = 0;
+  }
+
+  P2H_N *n = P2H_POSITIONS(p2h);
+  for (unsigned short i = 0; i <= p2h->b; ++i) {
+    n[i] = i + 1;
+  }
+}
+
+
+void P2H_NAME(sa_add_p2_histogram)(P2H_T *p2h, double x)
+{
+  assert(p2h);
+
+  if (p2h->cnt) {
+    p2h->data[--p2h->cnt] = (P2H_Q)x;
+    if (p2h->cnt == 0) {
+      P2H_NAME(sort_histogram)(p2h->data, p2h->b + 1);
+    }
+    return;
+  }
+
+  P2H_Q *q = p2h->data;
+  P2H_N *n = P2H_POSITIONS(p2h);
+#ifdef P2H_N_MAX
+  if (n[p2h->b] == P2H_N_MAX) {return;}
+#endif
+
+  P2H_Q qx = (P2H_Q)x;
+  int k = 0;
+  if (qx < q[0]) {
+    q[0] = qx;
+    k = 1;
+  } else {
+    for (unsigned short i = 0; i < p2h->b - 1; ++i) {
+      if (q[i] <= qx && qx < q[i + 1]) {
+        k = i + 1;
+        break;
+      }
+    }
+  }
+  if (k == 0) {
+    if (q[p2h->b - 1] <= qx && qx <= q[p2h->b]) {
+      k = p2h->b;
+    } else if (q[p2h->b] < qx) {
+      q[p2h->b] = qx;
+      k = p2h->b;
+    }
+  }
+
+  for (unsigned short i = k; i <= p2h->b; ++i) {
+    ++n[i];
+  }
+
+  for (unsigned short i = 1; i < p2h->b; ++i) {
+    double n1 = 1 + i * ((double)n[p2h->b] - 1) / p2h->b;
+    double d = n1 - n[i];
+    if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i] - n[i - 1] > 1)) {
+      d = (d > 0) ? 1 : -1;
+      // the interpolation runs in double precision on the neighborhood
+      double lq[3] = { q[i - 1], q[i], q[i + 1] };
+      double ln[3] = { n[i - 1], n[i], n[i + 1] };
+      double q1 = parabolic(1, d, lq, ln);
+      if (lq[0] < q1 && q1 < lq[2]) {
+        q[i] = (P2H_Q)q1;
+      } else {
+        q[i] = (P2H_Q)linear(1, d, lq, ln);
+      }
+      n[i] = d > 0 ? n[i] + 1 : n[i] - 1;
+    }
+  }
+}
+
+
+double P2H_NAME(sa_estimate_p2_histogram)(P2H_T *p2h, unsigned short marker)
+{
+  assert(p2h);
+
+  if (marker > p2h->b || p2h->cnt != 0) return NAN;
+  return p2h->data[marker];
+}
+
+
+unsigned long long
+P2H_NAME(sa_count_p2_histogram)(P2H_T *p2h, unsigned short marker)
+{
+  assert(p2h);
+
+  if (marker > p2h->b || p2h->cnt != 0) return 0;
+  return (unsigned long long)P2H_POSITIONS(p2h)[marker];
+}
+
+
+void P2H_NAME(sa_destroy_p2_histogram)(P2H_T *p2h)
+{
+  free(p2h);
+}
+
+#undef P2H_POSITIONS
+#undef P2H_NAME
+#undef P2H_T
+#undef P2H_Q
+#undef P2H_N
+#undef P2H_SIZE
+#undef P2H_N_MAX
@@ -31,4 +31,27 @@ struct sa_p2_histogram {
   double data[];
 };
 
+#define P2_HISTOGRAM_SIZE(b) (sizeof(sa_p2_histogram) + sizeof(double) \
+                              * ((b) + 1) * 2)
+
+
+struct sa_p2_histogram_flt {
+  unsigned short cnt;
+  unsigned short b;
+  float data[]; // b + 1 heights followed by b + 1 uint32_t positions
+};
+
+#define P2_HISTOGRAM_FLT_SIZE(b) (sizeof(sa_p2_histogram_flt) \
+                                  + (sizeof(float) + sizeof(uint32_t)) \
+                                  * ((b) + 1))
+
+
+struct sa_p2_window {
+  uint64_t current_time;
+  uint64_t ns_per_row;
+  int rows;
+  unsigned short b;
+  double data[]; // rows * P2_HISTOGRAM_SIZE(b)
+};
+
 #endif
@@ -12,6 +12,9 @@
 #include <math.h>
 #include <stdlib.h>
 
+#define BLOCK_SIZE 64
+#define LANES 4
+
 void sa_init_running_stats(sa_running_stats *s)
 {
   s->count = 0.0;
@@ -36,6 +39,122 @@ void sa_add_running_stats(sa_running_stats *s, double d)
 }
 
 
+/* Two pass count/mean/M2 over a block of at most BLOCK_SIZE values. The
+   independent lane accumulators let the compiler vectorize the reductions
+   without re-associating the floating point math. */
+static void add_block(sa_running_stats *s, const double *b, size_t len)
+{
+  double cnt[LANES] = { 0 };
+  double sum[LANES] = { 0 };
+  size_t i = 0;
+  for (; i + LANES <= len; i += LANES) {
+    for (int k = 0; k < LANES; ++k) {
+      double ok = (b[i + k] - b[i + k]) == 0; // false for NaN and +/-inf
+      cnt[k] += ok;
+      sum[k] += ok ? b[i + k] : 0;
+    }
+  }
+  for (; i < len; ++i) {
+    double ok = (b[i] - b[i]) == 0;
+    cnt[0] += ok;
+    sum[0] += ok ? b[i] : 0;
+  }
+
+  sa_running_stats bs;
+  bs.count = (cnt[0] + cnt[1]) + (cnt[2] + cnt[3]);
+  if (bs.count == 0) return;
+  bs.mean = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / bs.count;
+
+  double m2[LANES] = { 0 };
+  for (i = 0; i + LANES <= len; i += LANES) {
+    for (int k = 0; k < LANES; ++k) {
+      double d = (b[i + k] - b[i + k]) == 0 ? b[i + k] - bs.mean : 0;
+      m2[k] += d * d;
+    }
+  }
+  for (; i < len; ++i) {
+    double d = (b[i] - b[i]) == 0 ? b[i] - bs.mean : 0;
+    m2[0] += d * d;
+  }
+  bs.sum = (m2[0] + m2[1]) + (m2[2] + m2[3]);
+  sa_merge_running_stats(s, &bs);
+}
+
+
+void sa_add_running_stats_array(sa_running_stats *s, const double *v, size_t n)
+{
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    add_block(s, v + i, n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE);
+  }
+}
+
+
+void sa_add_running_stats_array_int(sa_running_stats *s, const int *v,
+                                    size_t n)
+{
+  double b[BLOCK_SIZE];
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    size_t len = n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE;
+    for (size_t j = 0; j < len; ++j) {
+      b[j] = v[i + j];
+    }
+    add_block(s, b, len);
+  }
+}
+
+
+void sa_add_running_stats_array_flt(sa_running_stats *s, const float *v,
+                                    size_t n)
+{
+  double b[BLOCK_SIZE];
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    size_t len = n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE;
+    for (size_t j = 0; j < len; ++j) {
+      b[j] = v[i + j];
+    }
+    add_block(s, b, len);
+  }
+}
+
+
+void sa_merge_running_stats(sa_running_stats *dst, const sa_running_stats *src)
+{
+  if (src->count == 0) return;
+  if (dst->count == 0) {
+    *dst = *src;
+    return;
+  }
+
+  double count = dst->count + src->count;
+  double delta = src->mean - dst->mean;
+  dst->mean += delta * src->count / count;
+  dst->sum += src->sum + delta * delta * dst->count * src->count / count;
+  dst->count = count;
+}
+
+
+static sa_running_stats reduce(const sa_running_stats *partials, size_t n)
+{
+  if (n == 1) return partials[0];
+  sa_running_stats s = reduce(partials, n / 2);
+  sa_running_stats s1 = reduce(partials + n / 2, n - n / 2);
+  sa_merge_running_stats(&s, &s1);
+  return s;
+}
+
+
+void sa_reduce_running_stats(sa_running_stats *s,
+                             const sa_running_stats *partials,
+                             size_t n)
+{
+  if (n == 0) {
+    sa_init_running_stats(s);
+    return;
+  }
+  *s = reduce(partials, n);
+}
+
+
 double sa_variance_running_stats(sa_running_stats *s)
 {
   if (s->count < 2) return 0.0;
@@ -89,3 +208,460 @@ sa_deserialize_running_stats(sa_running_stats *s, const char *buf, size_t len)
   }
   return 0;
 }
+
+
+void sa_init_moment_stats(sa_moment_stats *s)
+{
+  s->count = 0.0;
+  s->mean = 0.0;
+  s->m2 = 0.0;
+  s->m3 = 0.0;
+  s->m4 = 0.0;
+  s->min = 0.0;
+  s->max = 0.0;
+}
+
+
+void sa_add_moment_stats(sa_moment_stats *s, double d)
+{
+  if (!isfinite(d)) return;
+
+  double n1 = s->count;
+  double n = ++s->count;
+  if (n == 1) {
+    s->mean = s->min = s->max = d;
+    return;
+  }
+  if (d < s->min) s->min = d;
+  if (d > s->max) s->max = d;
+
+  double delta = d - s->mean;
+  double delta_n = delta / n;
+  double delta_n2 = delta_n * delta_n;
+  double term1 = delta * delta_n * n1;
+  s->mean += delta_n;
+  s->m4 += term1 * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * s->m2
+      - 4 * delta_n * s->m3;
+  s->m3 += term1 * delta_n * (n - 2) - 3 * delta_n * s->m2;
+  s->m2 += term1;
+}
+
+
+/* Same two pass scheme as add_block with the third/fourth central moments and
+   the extremes tracked per lane. */
+static void add_moment_block(sa_moment_stats *s, const double *b, size_t len)
+{
+  double cnt[LANES] = { 0 };
+  double sum[LANES] = { 0 };
+  double mn[LANES] = { INFINITY, INFINITY, INFINITY, INFINITY };
+  double mx[LANES] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+  size_t i = 0;
+  for (; i + LANES <= len; i += LANES) {
+    for (int k = 0; k < LANES; ++k) {
+      double x = b[i + k];
+      double ok = (x - x) == 0;
+      cnt[k] += ok;
+      sum[k] += ok ? x : 0;
+      mn[k] = ok && x < mn[k] ? x : mn[k];
+      mx[k] = ok && x > mx[k] ? x : mx[k];
+    }
+  }
+  for (; i < len; ++i) {
+    double x = b[i];
+    double ok = (x - x) == 0;
+    cnt[0] += ok;
+    sum[0] += ok ? x : 0;
+    mn[0] = ok && x < mn[0] ? x : mn[0];
+    mx[0] = ok && x > mx[0] ? x : mx[0];
+  }
+
+  sa_moment_stats bs;
+  bs.count = (cnt[0] + cnt[1]) + (cnt[2] + cnt[3]);
+  if (bs.count == 0) return;
+  bs.mean = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / bs.count;
+  bs.min = fmin(fmin(mn[0], mn[1]), fmin(mn[2], mn[3]));
+  bs.max = fmax(fmax(mx[0], mx[1]), fmax(mx[2], mx[3]));
+
+  double m2[LANES] = { 0 };
+  double m3[LANES] = { 0 };
+  double m4[LANES] = { 0 };
+  for (i = 0; i + LANES <= len; i += LANES) {
+    for (int k = 0; k < LANES; ++k) {
+      double d = (b[i + k] - b[i + k]) == 0 ? b[i + k] - bs.mean : 0;
+      double d2 = d * d;
+      m2[k] += d2;
+      m3[k] += d2 * d;
+      m4[k] += d2 * d2;
+    }
+  }
+  for (; i < len; ++i) {
+    double d = (b[i] - b[i]) == 0 ? b[i] - bs.mean : 0;
+    double d2 = d * d;
+    m2[0] += d2;
+    m3[0] += d2 * d;
+    m4[0] += d2 * d2;
+  }
+  bs.m2 = (m2[0] + m2[1]) + (m2[2] + m2[3]);
+  bs.m3 = (m3[0] + m3[1]) + (m3[2] + m3[3]);
+  bs.m4 = (m4[0] + m4[1]) + (m4[2] + m4[3]);
+  sa_merge_moment_stats(s, &bs);
+}
+
+
+void sa_add_moment_stats_array(sa_moment_stats *s, const double *v, size_t n)
+{
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    add_moment_block(s, v + i, n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE);
+  }
+}
+
+
+void sa_add_moment_stats_array_int(sa_moment_stats *s, const int *v, size_t n)
+{
+  double b[BLOCK_SIZE];
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    size_t len = n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE;
+    for (size_t j = 0; j < len; ++j) {
+      b[j] = v[i + j];
+    }
+    add_moment_block(s, b, len);
+  }
+}
+
+
+void sa_add_moment_stats_array_flt(sa_moment_stats *s, const float *v,
+                                   size_t n)
+{
+  double b[BLOCK_SIZE];
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    size_t len = n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE;
+    for (size_t j = 0; j < len; ++j) {
+      b[j] = v[i + j];
+    }
+    add_moment_block(s, b, len);
+  }
+}
+
+
+void sa_merge_moment_stats(sa_moment_stats *dst, const sa_moment_stats *src)
+{
+  if (src->count == 0) return;
+  if (dst->count == 0) {
+    *dst = *src;
+    return;
+  }
+
+  double na = dst->count;
+  double nb = src->count;
+  double n = na + nb;
+  double delta = src->mean - dst->mean;
+  double delta_n = delta / n;
+  double delta_n2 = delta_n * delta_n;
+  double nanb = na * nb;
+
+  double m4 = dst->m4 + src->m4
+      + delta * delta_n * delta_n2 * nanb * (na * na - nanb + nb * nb)
+      + 6 * delta_n2 * (na * na * src->m2 + nb * nb * dst->m2)
+      + 4 * delta_n * (na * src->m3 - nb * dst->m3);
+  double m3 = dst->m3 + src->m3
+      + delta * delta_n2 * nanb * (na - nb)
+      + 3 * delta_n * (na * src->m2 - nb * dst->m2);
+  dst->m2 += src->m2 + delta * delta_n * nanb;
+  dst->m3 = m3;
+  dst->m4 = m4;
+  dst->mean += delta_n * nb;
+  dst->count = n;
+  if (src->min < dst->min) dst->min = src->min;
+  if (src->max > dst->max) dst->max = src->max;
+}
+
+
+double sa_variance_moment_stats(sa_moment_stats *s)
+{
+  if (s->count < 2) return 0.0;
+  return s->m2 / (s->count - 1);
+}
+
+
+double sa_sd_moment_stats(sa_moment_stats *s)
+{
+  if (s->count < 2) return 0.0;
+  return sqrt(s->m2 / (s->count - 1));
+}
+
+
+double sa_usd_moment_stats(sa_moment_stats *s)
+{
+  if (s->count < 2) return 0.0;
+  return sqrt(s->m2 / s->count);
+}
+
+
+double sa_skewness_moment_stats(sa_moment_stats *s)
+{
+  if (s->count < 2 || s->m2 == 0) return 0.0;
+  return sqrt(s->count) * s->m3 / pow(s->m2, 1.5);
+}
+
+
+double sa_kurtosis_moment_stats(sa_moment_stats *s)
+{
+  if (s->count < 2 || s->m2 == 0) return 0.0;
+  return s->count * s->m4 / (s->m2 * s->m2) - 3.0;
+}
+
+
+char* sa_serialize_moment_stats(sa_moment_stats *s, size_t *len)
+{
+  *len = sizeof(double) * 7;
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+  n2b(&s->count, buf, sizeof(double));
+  n2b(&s->mean, buf + sizeof(double), sizeof(double));
+  n2b(&s->m2, buf + sizeof(double) * 2, sizeof(double));
+  n2b(&s->m3, buf + sizeof(double) * 3, sizeof(double));
+  n2b(&s->m4, buf + sizeof(double) * 4, sizeof(double));
+  n2b(&s->min, buf + sizeof(double) * 5, sizeof(double));
+  n2b(&s->max, buf + sizeof(double) * 6, sizeof(double));
+  return buf;
+}
+
+
+int
+sa_deserialize_moment_stats(sa_moment_stats *s, const char *buf, size_t len)
+{
+  size_t elen = sizeof(double) * 7;
+  if (len != elen) {
+    sa_init_moment_stats(s);
+    return 1;
+  }
+  b2n(buf, &s->count, sizeof(double));
+  b2n(buf + sizeof(double), &s->mean, sizeof(double));
+  b2n(buf + sizeof(double) * 2, &s->m2, sizeof(double));
+  b2n(buf + sizeof(double) * 3, &s->m3, sizeof(double));
+  b2n(buf + sizeof(double) * 4, &s->m4, sizeof(double));
+  b2n(buf + sizeof(double) * 5, &s->min, sizeof(double));
+  b2n(buf + sizeof(double) * 6, &s->max, sizeof(double));
+  if (s->count < 0) {
+    sa_init_moment_stats(s);
+    return 2;
+  }
+  return 0;
+}
+
+
+void sa_init_bivariate_stats(sa_bivariate_stats *s)
+{
+  s->count = 0.0;
+  s->mean_x = 0.0;
+  s->mean_y = 0.0;
+  s->m2_x = 0.0;
+  s->m2_y = 0.0;
+  s->c_xy = 0.0;
+}
+
+
+void sa_add_bivariate_stats(sa_bivariate_stats *s, double x, double y)
+{
+  if (!isfinite(x) || !isfinite(y)) return;
+
+  double n = ++s->count;
+  double dx = x - s->mean_x;
+  double dy = y - s->mean_y;
+  s->mean_x += dx / n;
+  s->mean_y += dy / n;
+  s->m2_x += dx * (x - s->mean_x);
+  s->m2_y += dy * (y - s->mean_y);
+  s->c_xy += dx * (y - s->mean_y);
+}
+
+
+void sa_merge_bivariate_stats(sa_bivariate_stats *dst,
+                              const sa_bivariate_stats *src)
+{
+  if (src->count == 0) return;
+  if (dst->count == 0) {
+    *dst = *src;
+    return;
+  }
+
+  double count = dst->count + src->count;
+  double f = dst->count * src->count / count;
+  double dx = src->mean_x - dst->mean_x;
+  double dy = src->mean_y - dst->mean_y;
+  dst->mean_x += dx * src->count / count;
+  dst->mean_y += dy * src->count / count;
+  dst->m2_x += src->m2_x + dx * dx * f;
+  dst->m2_y += src->m2_y + dy * dy * f;
+  dst->c_xy += src->c_xy + dx * dy * f;
+  dst->count = count;
+}
+
+
+double sa_covariance_bivariate_stats(sa_bivariate_stats *s)
+{
+  if (s->count < 2) return 0.0;
+  return s->c_xy / (s->count - 1);
+}
+
+
+double sa_correlation_bivariate_stats(sa_bivariate_stats *s)
+{
+  if (s->m2_x <= 0 || s->m2_y <= 0) return 0.0;
+  double r = s->c_xy / sqrt(s->m2_x * s->m2_y);
+  if (r > 1) return 1.0; // clamp the rounding error
+  if (r < -1) return -1.0;
+  return r;
+}
+
+
+char* sa_serialize_bivariate_stats(sa_bivariate_stats *s, size_t *len)
+{
+  *len = sizeof(double) * 6;
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+  n2b(&s->count, buf, sizeof(double));
+  n2b(&s->mean_x, buf + sizeof(double), sizeof(double));
+  n2b(&s->mean_y, buf + sizeof(double) * 2, sizeof(double));
+  n2b(&s->m2_x, buf + sizeof(double) * 3, sizeof(double));
+  n2b(&s->m2_y, buf + sizeof(double) * 4, sizeof(double));
+  n2b(&s->c_xy, buf + sizeof(double) * 5, sizeof(double));
+  return buf;
+}
+
+
+int sa_deserialize_bivariate_stats(sa_bivariate_stats *s, const char *buf,
+                                   size_t len)
+{
+  size_t elen = sizeof(double) * 6;
+  if (len != elen) {
+    sa_init_bivariate_stats(s);
+    return 1;
+  }
+  b2n(buf, &s->count, sizeof(double));
+  b2n(buf + sizeof(double), &s->mean_x, sizeof(double));
+  b2n(buf + sizeof(double) * 2, &s->mean_y, sizeof(double));
+  b2n(buf + sizeof(double) * 3, &s->m2_x, sizeof(double));
+  b2n(buf + sizeof(double) * 4, &s->m2_y, sizeof(double));
+  b2n(buf + sizeof(double) * 5, &s->c_xy, sizeof(double));
+  if (s->count < 0) {
+    sa_init_bivariate_stats(s);
+    return 2;
+  }
+  return 0;
+}
+
+
+/* Weight remaining after 'dt' nanoseconds. */
+static double decay(sa_ewma_stats *s, uint64_t dt)
+{
+  return exp2(-(double)dt / s->half_life);
+}
+
+
+void sa_init_ewma_stats(sa_ewma_stats *s, uint64_t half_life)
+{
+  s->half_life = half_life ? half_life : 1;
+  s->current_time = 0;
+  s->weight = 0.0;
+  s->mean = 0.0;
+  s->sum = 0.0;
+}
+
+
+void sa_add_ewma_stats(sa_ewma_stats *s, uint64_t ns, double d)
+{
+  if (!isfinite(d)) return;
+
+  double w = 1.0;
+  if (s->weight == 0) {
+    s->current_time = ns;
+  } else if (ns > s->current_time) {
+    double a = decay(s, ns - s->current_time);
+    s->weight *= a;
+    s->sum *= a;
+    s->current_time = ns;
+  } else if (ns < s->current_time) {
+    w = decay(s, s->current_time - ns);
+  }
+
+  s->weight += w;
+  double delta = d - s->mean;
+  s->mean += w * delta / s->weight;
+  s->sum += w * delta * (d - s->mean);
+}
+
+
+double sa_variance_ewma_stats(sa_ewma_stats *s)
+{
+  if (s->weight == 0) return 0.0;
+  return s->sum / s->weight;
+}
+
+
+double sa_sd_ewma_stats(sa_ewma_stats *s)
+{
+  if (s->weight == 0) return 0.0;
+  return sqrt(s->sum / s->weight);
+}
+
+
+double sa_weight_ewma_stats(sa_ewma_stats *s, uint64_t ns)
+{
+  if (ns <= s->current_time) return s->weight;
+  return s->weight * decay(s, ns - s->current_time);
+}
+
+
+char* sa_serialize_ewma_stats(sa_ewma_stats *s, size_t *len)
+{
+  *len = sizeof(uint64_t) * 2 + sizeof(double) * 3;
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+  char *p = buf;
+  n2b(&s->half_life, p, sizeof(uint64_t));
+  p += sizeof(uint64_t);
+  n2b(&s->current_time, p, sizeof(uint64_t));
+  p += sizeof(uint64_t);
+  n2b(&s->weight, p, sizeof(double));
+  n2b(&s->mean, p + sizeof(double), sizeof(double));
+  n2b(&s->sum, p + sizeof(double) * 2, sizeof(double));
+  return buf;
+}
+
+
+int
+sa_deserialize_ewma_stats(sa_ewma_stats *s, const char *buf, size_t len)
+{
+  size_t elen = sizeof(uint64_t) * 2 + sizeof(double) * 3;
+  if (len != elen) {
+    sa_init_ewma_stats(s, s->half_life);
+    return 1;
+  }
+  uint64_t half_life;
+  b2n(buf, &half_life, sizeof(uint64_t));
+  if (half_life != s->half_life) {
+    sa_init_ewma_stats(s, s->half_life);
+    return 3;
+  }
+  buf += sizeof(uint64_t);
+  b2n(buf, &s->current_time, sizeof(uint64_t));
+  buf += sizeof(uint64_t);
+  b2n(buf, &s->weight, sizeof(double));
+  b2n(buf + sizeof(double), &s->mean, sizeof(double));
+  b2n(buf + sizeof(double) * 2, &s->sum, sizeof(double));
+  if (!(s->weight >= 0)) {
+    sa_init_ewma_stats(s, s->half_life);
+    return 2;
+  }
+  return 0;
+}
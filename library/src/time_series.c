@@ -13,288 +13,2086 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "common.h"
+#include "matrix_impl.h"
+#include "p2_impl.h"
 #include "running_stats.h"
 #include "time_series_impl.h"
 
-struct mp_calc {
-  double  *stats;
-  double  *dp;
-  double  *mp;
-  int     *mpi;
-  int     *rand;
-  int     rand_len;
-  int     mp_len;
-  int     n;
-  int     m;
-  int     sidx;
+struct sa_mp_workspace {
+  double    *t;
+  double    *mu;
+  double    *isd;
+  double    *mp;
+  double    *wmp; // private profiles of the additional threads
+  int       *mpi;
+  int       *wmpi;
+  int       *rand;
+  double    *fft; // overlap-save spectra and buffers (lazily allocated)
+  uint64_t  rng; // xorshift64* state
+  int       fft_len;
+  int       fft_blocks;
+  int       wthreads; // number of private profiles allocated
+  int       rand_len;
+  int       mp_len;
+  int       n;
+  int       m;
+  int       sidx;
 };
 
 
-static int find_index_int(sa_time_series_int *ts, uint64_t ns, bool advance)
+static int window_value(sa_time_series_int *ts, int64_t current_row,
+                        uint32_t row)
+{
+  int idx = TS_RING_INDEX(ts, current_row)
+      - (int)((uint32_t)current_row - row);
+  if (idx < 0) {idx += ts->rows;}
+  return ts->v[idx];
+}
+
+
+static void window_evict(sa_time_series_int *ts, ts_window_int *w,
+                         int64_t current_row)
+{
+  uint32_t *dq = w->dq;
+  while (w->min_len > 0
+         && (uint32_t)current_row - dq[w->min_head] >= (uint32_t)ts->window) {
+    if (++w->min_head == ts->window) {w->min_head = 0;}
+    --w->min_len;
+  }
+  dq += ts->window;
+  while (w->max_len > 0
+         && (uint32_t)current_row - dq[w->max_head] >= (uint32_t)ts->window) {
+    if (++w->max_head == ts->window) {w->max_head = 0;}
+    --w->max_len;
+  }
+}
+
+
+static void window_push(sa_time_series_int *ts, ts_window_int *w,
+                        int64_t current_row, uint32_t row, int v)
+{
+  uint32_t *dq = w->dq;
+  while (w->min_len > 0) {
+    int b = (w->min_head + w->min_len - 1) % ts->window;
+    if (window_value(ts, current_row, dq[b]) < v) {break;}
+    --w->min_len;
+  }
+  dq[(w->min_head + w->min_len++) % ts->window] = row;
+
+  dq += ts->window;
+  while (w->max_len > 0) {
+    int b = (w->max_head + w->max_len - 1) % ts->window;
+    if (window_value(ts, current_row, dq[b]) > v) {break;}
+    --w->max_len;
+  }
+  dq[(w->max_head + w->max_len++) % ts->window] = row;
+}
+
+
+static void window_rebuild(sa_time_series_int *ts, ts_window_int *w)
+{
+  int64_t current_row = ts->current_row;
+  w->min_head = w->min_len = w->max_head = w->max_len = 0;
+  for (int age = ts->window - 1; age > 0; --age) {
+    uint32_t row = (uint32_t)(current_row - age);
+    window_push(ts, w, current_row, row, window_value(ts, current_row, row));
+  }
+  w->dirty = 0;
+}
+
+
+static void window_reset(sa_time_series_int *ts)
+{
+  if (!ts->window) {return;}
+
+  ts_window_int *w = TS_WINDOW_INT(ts);
+  int idx = ts->current_idx;
+  w->sum = 0;
+  w->sumsq = (exact_sumsq){ 0, 0 };
+  for (int i = 0; i < ts->window; ++i) {
+    int v = ts->v[idx];
+    w->sum += v;
+    exact_sumsq_add(&w->sumsq, v);
+    if (--idx < 0) {idx = ts->rows - 1;}
+  }
+  w->dirty = 1;
+}
+
+
+/* Called before the rows between the current and the requested row are
+   zeroed. */
+static void window_advance(sa_time_series_int *ts, int64_t current_row,
+                           int64_t row_delta)
+{
+  ts_window_int *w = TS_WINDOW_INT(ts);
+  int64_t requested_row = current_row + row_delta;
+  if (row_delta >= ts->window) {
+    w->sum = 0;
+    w->sumsq = (exact_sumsq){ 0, 0 };
+    w->min_head = w->min_len = w->max_head = w->max_len = 0;
+    w->dirty = 0;
+    if (ts->window > 1) {
+      window_push(ts, w, requested_row, (uint32_t)(requested_row - 1), 0);
+    }
+    return;
+  }
+
+  int idx = ts->current_idx - ts->window + 1;
+  if (idx < 0) {idx += ts->rows;}
+  for (int i = 0; i < row_delta; ++i) {
+    int v = ts->v[idx];
+    w->sum -= v;
+    exact_sumsq_sub(&w->sumsq, v);
+    if (++idx == ts->rows) {idx = 0;}
+  }
+  if (w->dirty) {return;}
+
+  window_evict(ts, w, requested_row);
+  window_push(ts, w, requested_row, (uint32_t)current_row,
+              ts->v[ts->current_idx]);
+  if (row_delta > 1) { // the skipped rows are all zero, only the last matters
+    window_push(ts, w, requested_row, (uint32_t)(requested_row - 1), 0);
+  }
+}
+
+
+static void window_update(sa_time_series_int *ts, int idx, int ov, int nv)
+{
+  if (!ts->window || ov == nv) {return;}
+
+  int age = ts->current_idx - idx;
+  if (age < 0) {age += ts->rows;}
+  if (age >= ts->window) {return;}
+
+  ts_window_int *w = TS_WINDOW_INT(ts);
+  w->sum += (int64_t)nv - ov;
+  exact_sumsq_sub(&w->sumsq, ov);
+  exact_sumsq_add(&w->sumsq, nv);
+  if (age > 0) {w->dirty = 1;}
+}
+
+
+static void index_leaf(sa_range_stats_int *r, int v)
+{
+  r->sum = v;
+  r->m2 = 0;
+  r->min = v ? v : INT_MAX;
+  r->max = v ? v : INT_MIN;
+  r->nonzero = v != 0;
+}
+
+
+static void index_combine(sa_range_stats_int *r, const sa_range_stats_int *a,
+                          const sa_range_stats_int *b)
+{
+  sa_running_stats s = { a->nonzero, a->nonzero ? (double)a->sum / a->nonzero
+    : 0, a->m2 };
+  sa_running_stats s1 = { b->nonzero, b->nonzero ? (double)b->sum / b->nonzero
+    : 0, b->m2 };
+  sa_merge_running_stats(&s, &s1);
+  r->m2 = s.sum;
+  r->sum = a->sum + b->sum;
+  r->min = a->min < b->min ? a->min : b->min;
+  r->max = a->max > b->max ? a->max : b->max;
+  r->nonzero = a->nonzero + b->nonzero;
+}
+
+
+static void index_rebuild(sa_time_series_int *ts)
+{
+  if (!ts->index) {return;}
+
+  sa_range_stats_int *t = TS_INDEX_INT(ts);
+  for (int i = 0; i < ts->rows; ++i) {
+    index_leaf(t + ts->rows + i, ts->v[i]);
+  }
+  for (int i = ts->rows - 1; i > 0; --i) {
+    index_combine(t + i, t + 2 * i, t + 2 * i + 1);
+  }
+}
+
+
+static void index_update(sa_time_series_int *ts, int idx)
 {
-  int64_t current_row = ts->current_time / ts->ns_per_row;
-  int64_t requested_row = ns / ts->ns_per_row;
-  int64_t row_delta = requested_row - current_row;
+  if (!ts->index) {return;}
 
-  if (row_delta > 0 && advance) {
-    if (row_delta >= ts->rows) {
-      memset(ts->v, 0, sizeof(int) * ts->rows);
+  sa_range_stats_int *t = TS_INDEX_INT(ts);
+  int i = ts->rows + idx;
+  index_leaf(t + i, ts->v[idx]);
+  for (i >>= 1; i > 0; i >>= 1) {
+    index_combine(t + i, t + 2 * i, t + 2 * i + 1);
+  }
+}
+
+
+/* Called after 'n' rows starting at 'idx' have been zeroed. */
+static void index_zeroed(sa_time_series_int *ts, int idx, int n)
+{
+  if (!ts->index) {return;}
+
+  // a full rebuild is cheaper once the point updates exceed ~rows nodes
+  int depth = 1;
+  for (int r = ts->rows; r > 1; r >>= 1) {++depth;}
+  if ((int64_t)n * depth >= ts->rows) {
+    index_rebuild(ts);
+    return;
+  }
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == ts->rows) {idx = 0;}
+    index_update(ts, idx);
+  }
+}
+
+
+static void index_query(sa_time_series_int *ts, int l, int r,
+                        sa_range_stats_int *rs)
+{
+  sa_range_stats_int *t = TS_INDEX_INT(ts);
+  for (l += ts->rows, r += ts->rows; l < r; l >>= 1, r >>= 1) {
+    if (l & 1) {index_combine(rs, rs, t + l++);}
+    if (r & 1) {index_combine(rs, rs, t + --r);}
+  }
+}
+
+
+/* Zeroes the rows between the current and the requested row and makes the
+   requested row current. */
+static void advance_int(sa_time_series_int *ts, uint64_t row_delta)
+{
+  int64_t current_row = ts->current_row;
+  if (ts->window) {window_advance(ts, current_row, row_delta);}
+  int oidx = ts->current_idx + 1;
+  if (oidx == ts->rows) {oidx = 0;}
+  if (row_delta >= (uint64_t)ts->rows) {
+    memset(ts->v, 0, sizeof(int) * ts->rows);
+    index_rebuild(ts);
+    ts->current_idx = TS_RING_INDEX(ts, ts->current_row + row_delta);
+  } else {
+    int delta = (int)row_delta;
+    if (oidx + delta <= ts->rows) {
+      memset(ts->v + oidx, 0, sizeof(int) * delta);
     } else {
-      int oidx = current_row % ts->rows + 1;
-      if (oidx == ts->rows) {oidx = 0;}
-      if (oidx + row_delta <= ts->rows) {
-        memset(ts->v + oidx, 0, sizeof(int) * row_delta);
-      } else {
-        memset(ts->v + oidx, 0, sizeof(int) * (ts->rows - oidx));
-        memset(ts->v, 0, sizeof(int) * (oidx + row_delta - ts->rows));
-      }
+      memset(ts->v + oidx, 0, sizeof(int) * (ts->rows - oidx));
+      memset(ts->v, 0, sizeof(int) * (oidx + delta - ts->rows));
     }
-    ts->current_time = ns - (ns % ts->ns_per_row);
-  } else if (requested_row > current_row || abs(row_delta) >= ts->rows) {
-    return -1;
+    index_zeroed(ts, oidx, delta);
+    ts->current_idx += delta;
+    if (ts->current_idx >= ts->rows) {ts->current_idx -= ts->rows;}
   }
-  return requested_row % ts->rows;
+  ts->current_row += row_delta;
+  ts->current_time = ts->current_row * ts->ns_per_row;
 }
 
 
-sa_time_series_int* sa_create_time_series_int(int rows, uint64_t ns_per_row)
+static int find_index_int(sa_time_series_int *ts, uint64_t ns, bool advance)
+{
+  if (ns >= ts->current_time) {
+    uint64_t offset = ns - ts->current_time;
+    if (offset < ts->ns_per_row) {return ts->current_idx;}
+    if (!advance) {return -1;}
+    offset -= ts->ns_per_row; // the next row needs no division
+    advance_int(ts, offset < ts->ns_per_row ? 1
+                : offset / ts->ns_per_row + 1);
+    return ts->current_idx;
+  }
+
+  uint64_t row_delta = ts->current_row - ns / ts->ns_per_row;
+  if (row_delta >= (uint64_t)ts->rows) {return -1;}
+  int idx = ts->current_idx - (int)row_delta;
+  if (idx < 0) {idx += ts->rows;}
+  return idx;
+}
+
+
+static sa_time_series_int* create_time_series_int(int rows,
+                                                  uint64_t ns_per_row,
+                                                  int window,
+                                                  int index)
 {
-  if (rows < 2 || ns_per_row < 1) {return NULL;}
+  if (rows < 2 || ns_per_row < 1 || window < 0 || window > rows) {
+    return NULL;
+  }
 
-  sa_time_series_int *ts = malloc(sizeof(*ts) + sizeof(int) * rows);
+  sa_time_series_int *ts = malloc(TIME_SERIES_INT_SIZE(rows, window, index));
   if (!ts) {return NULL;}
 
   ts->ns_per_row = ns_per_row;
   ts->rows = rows;
+  ts->window = window;
+  ts->index = index;
   sa_init_time_series_int(ts);
   return ts;
 }
 
 
+sa_time_series_int* sa_create_time_series_int(int rows, uint64_t ns_per_row)
+{
+  return create_time_series_int(rows, ns_per_row, 0, 0);
+}
+
+
+sa_time_series_int* sa_create_windowed_time_series_int(int rows,
+                                                       uint64_t ns_per_row,
+                                                       int window)
+{
+  return create_time_series_int(rows, ns_per_row, window, 0);
+}
+
+
+sa_time_series_int* sa_create_indexed_time_series_int(int rows,
+                                                      uint64_t ns_per_row,
+                                                      int window)
+{
+  return create_time_series_int(rows, ns_per_row, window, 1);
+}
+
+
 void sa_destroy_time_series_int(sa_time_series_int *ts)
 {
   free(ts);
 }
 
 
-void sa_init_time_series_int(sa_time_series_int *ts)
+void sa_init_time_series_int(sa_time_series_int *ts)
+{
+  assert(ts);
+  ts->mask = (ts->rows & (ts->rows - 1)) == 0 ? ts->rows - 1 : 0;
+  ts->current_row = ts->rows - 1;
+  ts->current_idx = ts->rows - 1;
+  ts->current_time = ts->ns_per_row * ts->current_row;
+  memset(ts->v, 0, sizeof(int) * ts->rows);
+  window_reset(ts);
+  index_rebuild(ts);
+}
+
+
+static void add_row_int(sa_time_series_int *ts, int idx, int64_t v)
+{
+  int ov = ts->v[idx];
+  int64_t nv = ov + v;
+  if (nv > INT_MAX) {
+    nv = INT_MAX;
+  } else if (nv < INT_MIN) {
+    nv = INT_MIN;
+  }
+  ts->v[idx] = nv;
+  window_update(ts, idx, ov, nv);
+  index_update(ts, idx);
+}
+
+
+static void set_row_int(sa_time_series_int *ts, int idx, int v)
+{
+  int ov = ts->v[idx];
+  ts->v[idx] = v;
+  window_update(ts, idx, ov, v);
+  index_update(ts, idx);
+}
+
+
+int sa_add_time_series_int(sa_time_series_int *ts, uint64_t ns, int v)
+{
+  assert(ts);
+  int idx = find_index_int(ts, ns, true);
+  if (idx == -1) {return INT_MIN;}
+  add_row_int(ts, idx, v);
+  return ts->v[idx];
+}
+
+
+/* Ring index of a timestamp no later than the current row (-1 when it has
+ * left the window). */
+static int batch_index(sa_time_series_int *ts, uint64_t ns)
+{
+  uint64_t delta = ts->current_row - ns / ts->ns_per_row;
+  if (delta >= (uint64_t)ts->rows) {return -1;}
+  int idx = ts->current_idx - (int)delta;
+  return idx < 0 ? idx + ts->rows : idx;
+}
+
+
+struct batch_entry {
+  int idx;
+  int v;
+};
+
+
+static int cmp_batch_entry(const void *a, const void *b)
+{
+  int x = ((const struct batch_entry *)a)->idx;
+  int y = ((const struct batch_entry *)b)->idx;
+  return (x > y) - (x < y);
+}
+
+
+/* Totals values touching more rows than the batch table holds: a rows sized
+ * scratch when there are at least as many values as rows, otherwise the values
+ * are sorted by row. Falls back to individual writes when the memory is not
+ * available. */
+static size_t batch_many_rows(sa_time_series_int *ts, const uint64_t *ns,
+                              const int *v, size_t n)
+{
+  size_t added = 0;
+  if ((size_t)ts->rows <= n) {
+    int64_t *sum = calloc(ts->rows, sizeof(int64_t));
+    if (sum) {
+      for (size_t i = 0; i < n; ++i) {
+        int idx = batch_index(ts, ns[i]);
+        if (idx == -1) {continue;}
+        sum[idx] += v[i];
+        ++added;
+      }
+      for (int idx = 0; idx < ts->rows; ++idx) {
+        if (sum[idx]) {add_row_int(ts, idx, sum[idx]);}
+      }
+      free(sum);
+      return added;
+    }
+  } else {
+    struct batch_entry *e = malloc(sizeof(struct batch_entry) * n);
+    if (e) {
+      for (size_t i = 0; i < n; ++i) {
+        int idx = batch_index(ts, ns[i]);
+        if (idx != -1) {e[added++] = (struct batch_entry){ idx, v[i] };}
+      }
+      qsort(e, added, sizeof(struct batch_entry), cmp_batch_entry);
+      for (size_t i = 0; i < added;) {
+        int64_t sum = 0;
+        size_t j = i;
+        for (; j < added && e[j].idx == e[i].idx; ++j) {
+          sum += e[j].v;
+        }
+        if (sum) {add_row_int(ts, e[i].idx, sum);}
+        i = j;
+      }
+      free(e);
+      return added;
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    int idx = batch_index(ts, ns[i]);
+    if (idx == -1) {continue;}
+    add_row_int(ts, idx, v[i]);
+    ++added;
+  }
+  return added;
+}
+
+
+/* Per row totals in a small open addressing table, most batches only touch a
+ * few rows. */
+#define BATCH_SLOTS 64
+#define BATCH_MAX_USED 48
+
+struct batch_table {
+  int     key[BATCH_SLOTS];
+  int64_t sum[BATCH_SLOTS];
+  int     used;
+};
+
+
+static void batch_flush(sa_time_series_int *ts, struct batch_table *t)
+{
+  for (int h = 0; h < BATCH_SLOTS; ++h) {
+    if (t->key[h] != -1 && t->sum[h]) {add_row_int(ts, t->key[h], t->sum[h]);}
+    t->key[h] = -1;
+    t->sum[h] = 0;
+  }
+  t->used = 0;
+}
+
+
+size_t sa_add_time_series_int_batch(sa_time_series_int *ts,
+                                    const uint64_t *ns,
+                                    const int *v,
+                                    size_t n)
+{
+  assert(ts && (n == 0 || (ns && v)));
+
+  // the values are processed in cache sized chunks, the totals are written
+  // before the ring advances (rows left behind are zeroed either way)
+  enum { chunk = 4096 };
+  struct batch_table t = { .used = 0 };
+  for (int h = 0; h < BATCH_SLOTS; ++h) {
+    t.key[h] = -1;
+  }
+  size_t added = 0;
+  for (size_t start = 0; start < n; start += chunk) {
+    size_t end = n - start < chunk ? n : start + chunk;
+    uint64_t max = ns[start];
+    for (size_t i = start + 1; i < end; ++i) {
+      if (ns[i] > max) {max = ns[i];}
+    }
+    if (max - ts->current_time >= ts->ns_per_row && max > ts->current_time) {
+      batch_flush(ts, &t);
+      find_index_int(ts, max, true);
+    }
+
+    for (size_t i = start; i < end; ++i) {
+      int idx = batch_index(ts, ns[i]);
+      if (idx == -1) {continue;}
+      uint32_t h = ((uint32_t)idx * 2654435761u) >> 26;
+      while (t.key[h] != -1 && t.key[h] != idx) {
+        h = (h + 1) & (BATCH_SLOTS - 1);
+      }
+      if (t.key[h] == -1) {
+        if (t.used == BATCH_MAX_USED) {
+          batch_flush(ts, &t);
+          added += batch_many_rows(ts, ns + i, v + i, end - i);
+          break;
+        }
+        t.key[h] = idx;
+        ++t.used;
+      }
+      t.sum[h] += v[i];
+      ++added;
+    }
+  }
+  batch_flush(ts, &t);
+  return added;
+}
+
+
+int sa_set_time_series_int(sa_time_series_int *ts, uint64_t ns, int v)
+{
+  assert(ts);
+  int idx = find_index_int(ts, ns, true);
+  if (idx == -1) {return INT_MIN;}
+  set_row_int(ts, idx, v);
+  return v;
+}
+
+
+static int saturating_add_int(int a, int b)
+{
+  int r = (int)((unsigned)a + (unsigned)b);
+  int m = ((a ^ r) & (b ^ r)) >> 31; // all ones on overflow
+  return (((a >> 31) ^ INT_MAX) & m) | (r & ~m);
+}
+
+
+/* Branch free and loading each block before storing it so the compiler can
+   vectorize it at -O2 (also safe when d == s). */
+static void add_segment_int(int *d, const int *s, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    int a0 = d[i], a1 = d[i + 1], a2 = d[i + 2], a3 = d[i + 3];
+    int b0 = s[i], b1 = s[i + 1], b2 = s[i + 2], b3 = s[i + 3];
+    d[i] = saturating_add_int(a0, b0);
+    d[i + 1] = saturating_add_int(a1, b1);
+    d[i + 2] = saturating_add_int(a2, b2);
+    d[i + 3] = saturating_add_int(a3, b3);
+  }
+  for (; i < n; ++i) {
+    d[i] = saturating_add_int(d[i], s[i]);
+  }
+}
+
+
+/* Equal resolutions; the overlapping rows are merged as contiguous ring
+   segments and the window/index are rebuilt once. */
+static void merge_aligned_int(sa_time_series_int *ts, sa_time_series_int *ts1,
+                              sa_merge_op op)
+{
+  uint64_t first = ts1->current_row - (ts1->rows - 1);
+  uint64_t dfirst = ts->current_row - (ts->rows - 1);
+  if (first < dfirst) {first = dfirst;}
+  if (first > ts1->current_row) {return;}
+
+  int n = (int)(ts1->current_row - first) + 1;
+  int sidx = ts1->current_idx - (n - 1);
+  if (sidx < 0) {sidx += ts1->rows;}
+  int didx = ts->current_idx - (int)(ts->current_row - first);
+  if (didx < 0) {didx += ts->rows;}
+
+  while (n > 0) {
+    int len = n;
+    if (ts->rows - didx < len) {len = ts->rows - didx;}
+    if (ts1->rows - sidx < len) {len = ts1->rows - sidx;}
+    if (op == SA_MERGE_SET) {
+      memmove(ts->v + didx, ts1->v + sidx, sizeof(int) * len);
+    } else {
+      add_segment_int(ts->v + didx, ts1->v + sidx, len);
+    }
+    didx += len;
+    if (didx == ts->rows) {didx = 0;}
+    sidx += len;
+    if (sidx == ts1->rows) {sidx = 0;}
+    n -= len;
+  }
+  window_reset(ts);
+  index_rebuild(ts);
+}
+
+
+void sa_merge_time_series_int(sa_time_series_int *ts,
+                              sa_time_series_int *ts1,
+                              sa_merge_op op)
+{
+  assert(ts && ts1);
+  find_index_int(ts, ts1->current_time, true);
+  if (ts->ns_per_row == ts1->ns_per_row) {
+    merge_aligned_int(ts, ts1, op);
+    return;
+  }
+
+  // the source rows are reduced into runs that land in the same row
+  uint64_t ns = ts1->current_time - ts1->ns_per_row * (ts1->rows - 1);
+  int sidx = ts1->current_idx + 1;
+  uint64_t run_start = 0;
+  int run_idx = -1;
+  int64_t run_v = 0;
+  for (int i = 0; i < ts1->rows; ++i, ++sidx, ns += ts1->ns_per_row) {
+    if (sidx == ts1->rows) {sidx = 0;}
+    if (run_idx == -1 || ns - run_start >= ts->ns_per_row) {
+      int idx = find_index_int(ts, ns, false);
+      if (idx == -1) {continue;}
+      if (run_idx != -1) {
+        if (op == SA_MERGE_SET) {
+          set_row_int(ts, run_idx, (int)run_v);
+        } else {
+          add_row_int(ts, run_idx, run_v);
+        }
+      }
+      run_start = ns - ns % ts->ns_per_row;
+      run_idx = idx;
+      run_v = 0;
+    }
+    run_v = op == SA_MERGE_SET ? ts1->v[sidx] : run_v + ts1->v[sidx];
+  }
+  if (run_idx != -1) {
+    if (op == SA_MERGE_SET) {
+      set_row_int(ts, run_idx, (int)run_v);
+    } else {
+      add_row_int(ts, run_idx, run_v);
+    }
+  }
+}
+
+
+int sa_get_time_series_int(sa_time_series_int *ts, uint64_t ns)
+{
+  assert(ts);
+  int idx = find_index_int(ts, ns, false);
+  if (idx == -1) {return INT_MIN;}
+  return ts->v[idx];
+}
+
+
+static uint64_t xorshift64s(uint64_t *s)
+{
+  uint64_t x = *s;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *s = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+static void shuffle_idx(uint64_t *rng, int *a, int len)
+{
+  for (int i = 0; i < len - 1; ++i) {
+    int j = i + (int)(xorshift64s(rng) % (uint64_t)(len - i));
+    int tmp = a[j];
+    a[j] = a[i];
+    a[i] = tmp;
+  }
+}
+
+
+/* Clears the profile and shuffles the diagonal groups, they are shuffled in
+   groups of four adjacent diagonals */
+static void reset_workspace(sa_mp_workspace *c)
+{
+  for (int i = 0; i < c->mp_len; ++i) {
+    c->mp[i] = INFINITY;
+  }
+  memset(c->mpi, 0, sizeof(int) * c->mp_len);
+
+  for (int i = 0, idx = c->m / 4 + 1; idx < c->mp_len; ++i, idx += 4) {
+    c->rand[i] = idx;
+  }
+  shuffle_idx(&c->rng, c->rand, c->rand_len);
+}
+
+
+/* Computes the mean and inverse standard deviation of every sub-sequence, the
+ * values (and results) are stride elements apart. */
+static void sliding_stats(const double *t, int stride, int n, int m,
+                          double *mu, double *isd)
+{
+  sa_running_stats rs;
+  sa_init_running_stats(&rs);
+  for (int i = 0; i < m; ++i) {
+    sa_add_running_stats(&rs, t[i * stride]);
+  }
+
+  int window = 0;
+  for (int i = m; i < n; ++i) {
+    mu[window * stride] = rs.mean;
+    isd[window * stride] = 1 / sa_usd_running_stats(&rs);
+    ++window;
+    double pm = rs.mean;
+    double in = t[i * stride], out = t[(i - m) * stride];
+    rs.mean += (in - out) / rs.count;
+    rs.sum += (in - pm) * (in - rs.mean) - (out - pm) * (out - rs.mean);
+  }
+  mu[window * stride] = rs.mean;
+  isd[window * stride] = 1 / sa_usd_running_stats(&rs);
+}
+
+
+/* Linearizes n rows of the ring buffer starting at ring index sidx */
+static void linearize(sa_time_series_int *ts, int sidx, int n, int stride,
+                      double *t)
+{
+  int len = ts->rows - sidx < n ? ts->rows - sidx : n;
+  for (int i = 0; i < len; ++i) {
+    t[i * stride] = ts->v[sidx + i];
+  }
+  for (int i = len; i < n; ++i) {
+    t[i * stride] = ts->v[i - len];
+  }
+}
+
+
+static void compute_stats(sa_time_series_int *ts, sa_mp_workspace *c)
+{
+  linearize(ts, c->sidx, c->n, 1, c->t);
+  sliding_stats(c->t, 1, c->n, c->m, c->mu, c->isd);
+}
+
+
+/* In place iterative radix-2 FFT, len must be a power of two. tw holds the
+ * len / 2 twiddle factors (cosines followed by sines). The inverse transform
+ * is not scaled. */
+static void fft(double *re, double *im, int len, const double *tw,
+                bool inverse)
+{
+  for (int i = 1, j = 0; i < len; ++i) {
+    int bit = len >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      double tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+      tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+    }
+  }
+
+  for (int a = 0; a < len; a += 2) {
+    double xr = re[a + 1], xi = im[a + 1];
+    re[a + 1] = re[a] - xr;
+    im[a + 1] = im[a] - xi;
+    re[a] += xr;
+    im[a] += xi;
+  }
+
+  const double *tc = tw, *ts = tw + len / 2;
+  double sign = inverse ? 1 : -1;
+  for (int half = 2; half < len; half <<= 1) {
+    int step = len / (half * 2);
+    for (int k = 0; k < half; ++k) {
+      double wr = tc[k * step], wi = sign * ts[k * step];
+      for (int a = k; a < len; a += half * 2) {
+        int b = a + half;
+        double xr = re[b] * wr - im[b] * wi;
+        double xi = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - xr;
+        im[b] = im[a] - xi;
+        re[a] += xr;
+        im[a] += xi;
+      }
+    }
+  }
+}
+
+
+static double mp_lastz(sa_mp_workspace *c, int diag, int k)
+{
+  double lastz = 0;
+  for (int x = k; x < k + c->m; ++x) {
+    lastz += c->t[x + diag] * c->t[x];
+  }
+  return lastz;
+}
+
+
+static void mp_update(double *mp, int *mpi, int i, int j, double d)
+{
+  if (d < mp[j]) {
+    mp[j] = d;
+    mpi[j] = i;
+  }
+  if (d < mp[i]) {
+    mp[i] = d;
+    mpi[i] = j;
+  }
+}
+
+
+/* Splits the mean centered window into blocks of fft_len values overlapping
+ * by m - 1 and transforms them for the overlap-save sliding dot products,
+ * centering keeps the FFT round off relative to the variance. The buffer is
+ * laid out as the block spectra, the query and work spectra, the twiddle
+ * factors and the two dot product arrays. */
+static bool fft_window(sa_mp_workspace *c, double *center)
+{
+  int len = c->fft_len;
+  int step = len - c->m + 1;
+  if (!c->fft) {
+    for (len = 4; len < c->m * 4; len <<= 1) {}
+    step = len - c->m + 1;
+    int blocks = (c->mp_len + step - 1) / step;
+    c->fft = malloc(sizeof(double) * ((size_t)len * (2 * blocks + 5)
+                                      + 2 * c->mp_len));
+    if (!c->fft) {return false;}
+    c->fft_len = len;
+    c->fft_blocks = blocks;
+    double *tw = c->fft + (size_t)len * (2 * blocks + 4);
+    double w = 2 * acos(-1.0) / len;
+    for (int k = 0; k < len / 2; ++k) {
+      tw[k] = cos(w * k);
+      tw[k + len / 2] = sin(w * k);
+    }
+  }
+
+  *center = 0;
+  for (int i = 0; i < c->n; ++i) {
+    *center += c->t[i];
+  }
+  *center /= c->n;
+
+  const double *tw = c->fft + (size_t)len * (2 * c->fft_blocks + 4);
+  for (int b = 0; b < c->fft_blocks; ++b) {
+    double *re = c->fft + (size_t)len * 2 * b, *im = re + len;
+    for (int k = 0, idx = b * step; k < len; ++k, ++idx) {
+      re[k] = idx < c->n ? c->t[idx] - *center : 0;
+      im[k] = 0;
+    }
+    fft(re, im, len, tw, false);
+  }
+  return true;
+}
+
+
+/* Computes the dot products of the queries qa and qb (m values each, qb may
+ * be NULL) centered by the same amount as the window with every window
+ * sub-sequence. The queries share the transforms as the real and imaginary
+ * parts since the window is real. Returns the dot product arrays. */
+static double* sliding_dots(sa_mp_workspace *c, const double *qa,
+                            const double *qb, double center)
+{
+  int len = c->fft_len, step = len - c->m + 1;
+  double *qre = c->fft + (size_t)len * 2 * c->fft_blocks, *qim = qre + len;
+  double *wre = qim + len, *wim = wre + len;
+  const double *tw = wim + len;
+  double *da = wim + len * 2, *db = da + c->mp_len;
+
+  for (int x = 0; x < len; ++x) {
+    qre[x] = x < c->m ? qa[c->m - 1 - x] - center : 0;
+    qim[x] = x < c->m && qb ? qb[c->m - 1 - x] - center : 0;
+  }
+  fft(qre, qim, len, tw, false);
+
+  double scale = 1.0 / len;
+  for (int b = 0; b < c->fft_blocks; ++b) {
+    const double *re = c->fft + (size_t)len * 2 * b, *im = re + len;
+    for (int k = 0; k < len; ++k) {
+      wre[k] = qre[k] * re[k] - qim[k] * im[k];
+      wim[k] = qre[k] * im[k] + qim[k] * re[k];
+    }
+    fft(wre, wim, len, tw, true);
+    int j = b * step;
+    int end = c->mp_len - j < step ? c->mp_len - j : step;
+    for (int k = 0; k < end; ++k) {
+      da[j + k] = wre[k + c->m - 1] * scale;
+      db[j + k] = wim[k + c->m - 1] * scale;
+    }
+  }
+  return da;
+}
+
+
+/* Updates the profile with the distance profile of the sub-sequence starting
+ * at i (qt holds its dot products with the centered window) and refines the
+ * diagonal of its nearest neighbor up to step - 1 positions in both
+ * directions. */
+static void prescrimp_row(sa_mp_workspace *c, int i, double *qt,
+                          double center, int step)
+{
+  const double *t = c->t, *mu = c->mu, *isd = c->isd;
+  double *mp = c->mp;
+  int *mpi = c->mpi;
+  double dm = c->m, mi = dm * (mu[i] - center), isdi = isd[i];
+  int excl = c->m / 4, bj = -1;
+  int lo = i - excl > 0 ? i - excl : 0;
+  int hi = i + excl < c->mp_len ? i + excl + 1 : c->mp_len;
+
+  // the distances overwrite the dot products
+  double best = INFINITY;
+  for (int j = 0; j < c->mp_len; ++j) {
+    qt[j] = 2 * (dm - (qt[j] - mi * (mu[j] - center)) * isdi * isd[j]);
+  }
+  for (int j = 0; j < c->mp_len; ++j) {
+    if (j == lo) {
+      j = hi - 1;
+      continue;
+    }
+    double d = qt[j];
+    if (d < mp[j]) {
+      mp[j] = d;
+      mpi[j] = i;
+    }
+    if (d < best) {
+      best = d;
+      bj = j;
+    }
+  }
+  if (bj == -1) {return;}
+  if (best < mp[i]) {
+    mp[i] = best;
+    mpi[i] = bj;
+  }
+
+  int a = i < bj ? i : bj, b = i < bj ? bj : i;
+  double q0 = mp_lastz(c, b - a, a);
+  double q = q0;
+  for (int k = 1; k < step && b + k < c->mp_len; ++k) {
+    q += t[a + k + c->m - 1] * t[b + k + c->m - 1]
+        - t[a + k - 1] * t[b + k - 1];
+    mp_update(mp, mpi, a + k, b + k,
+              2 * (dm - (q - dm * mu[a + k] * mu[b + k]) * isd[a + k]
+                   * isd[b + k]));
+  }
+  q = q0;
+  for (int k = 1; k < step && a - k >= 0; ++k) {
+    q += t[a - k] * t[b - k] - t[a - k + c->m] * t[b - k + c->m];
+    mp_update(mp, mpi, a - k, b - k,
+              2 * (dm - (q - dm * mu[a - k] * mu[b - k]) * isd[a - k]
+                   * isd[b - k]));
+  }
+}
+
+
+/* PreSCRIMP (SCRIMP++) seeding pass: the distance profiles of every m-th
+ * sub-sequence are computed with FFT sliding dot products, each followed by a
+ * walk of m - 1 positions in both directions along the nearest neighbor
+ * diagonal. This produces a close approximation of the profile in
+ * O(n^2 log m / m) so the SCRIMP diagonals only have to refine it. The m / 4
+ * interval of the paper costs more than the exact profile for short
+ * sub-sequences given the vectorized diagonal kernel. */
+static bool prescrimp(sa_mp_workspace *c)
+{
+  double center;
+  if (!fft_window(c, &center)) {return false;}
+
+  int step = c->m;
+  for (int i = 0; i < c->mp_len; i += step * 2) {
+    int i2 = i + step < c->mp_len ? i + step : -1;
+    double *da = sliding_dots(c, c->t + i, i2 != -1 ? c->t + i2 : NULL,
+                              center);
+    prescrimp_row(c, i, da, center, step);
+    if (i2 != -1) {
+      prescrimp_row(c, i2, da + c->mp_len, center, step);
+    }
+  }
+  return true;
+}
+
+
+/* Evaluates a diagonal (j = i + diag) of the distance matrix starting at
+ * position k where lastz is the dot product of the two sub-sequences. */
+static void scrimp_diagonal(sa_mp_workspace *c, int diag, int k, double lastz,
+                            double *mp, int *mpi)
+{
+  const double *t = c->t, *mu = c->mu, *isd = c->isd;
+  double dm = c->m;
+  for (int i = k, j = k + diag; j < c->mp_len; ++i, ++j) {
+    if (i > k) {
+      lastz = lastz + t[j + c->m - 1] * t[i + c->m - 1] - t[j - 1] * t[i - 1];
+    }
+    double d = 2 * (dm - (lastz - dm * mu[i] * mu[j]) * isd[j] * isd[i]);
+    if (d < mp[j]) {
+      mp[j] = d;
+      mpi[j] = i;
+    }
+    if (d < mp[i]) {
+      mp[i] = d;
+      mpi[i] = j;
+    }
+  }
+}
+
+
+#if defined(__GNUC__)
+typedef double mp_v4d __attribute__((vector_size(32)));
+typedef int64_t mp_v4l __attribute__((vector_size(32)));
+#define MP_LOAD(v, p) memcpy(&(v), (p), sizeof(v))
+
+#if defined(__x86_64__) && defined(__linux__)
+#define MP_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define MP_TARGET_CLONES
+#endif
+
+/* Evaluates four adjacent diagonals in lock step. The lanes share the i side
+ * and read contiguous j side values so each step is a handful of vector
+ * instructions (AVX2 when the host supports it) and the four independent
+ * running dot products hide the latency of the recurrence. The profile is
+ * only touched when one of the lanes improves it. Groups running past the end
+ * of the profile and the remaining positions of the shorter lanes use the
+ * scalar evaluation. */
+MP_TARGET_CLONES
+static void scrimp_diagonals(sa_mp_workspace *c, int diag, double *mp, int *mpi)
+{
+  const double *t = c->t, *mu = c->mu, *isd = c->isd;
+  double dm = c->m;
+  int len = c->mp_len - diag - 3;
+  if (len <= 0) {
+    for (int l = 0; diag + l < c->mp_len; ++l) {
+      scrimp_diagonal(c, diag + l, 0, mp_lastz(c, diag + l, 0), mp, mpi);
+    }
+    return;
+  }
+
+  mp_v4d q = { 0, 0, 0, 0 }, a, b;
+  for (int x = 0; x < c->m; ++x) {
+    MP_LOAD(a, t + x + diag);
+    q += a * t[x];
+  }
+
+  for (int k = 0;; ++k) {
+    mp_v4d muj, isdj, mpj;
+    MP_LOAD(muj, mu + k + diag);
+    MP_LOAD(isdj, isd + k + diag);
+    MP_LOAD(mpj, mp + k + diag);
+    mp_v4d d = 2 * (dm - (q - dm * mu[k] * muj) * isdj * isd[k]);
+    mp_v4l lt = (d < mpj) | (d < mp[k]);
+    if (lt[0] | lt[1] | lt[2] | lt[3]) {
+      for (int l = 0; l < 4; ++l) {
+        if (d[l] < mp[k + diag + l]) {
+          mp[k + diag + l] = d[l];
+          mpi[k + diag + l] = k;
+        }
+      }
+      for (int l = 0; l < 4; ++l) {
+        if (d[l] < mp[k]) {
+          mp[k] = d[l];
+          mpi[k] = k + diag + l;
+        }
+      }
+    }
+    if (k + 1 == len) {break;}
+
+    MP_LOAD(a, t + k + c->m + diag);
+    MP_LOAD(b, t + k + diag);
+    q += a * t[k + c->m] - b * t[k];
+  }
+
+  for (int l = 0; l < 3; ++l) {
+    scrimp_diagonal(c, diag + l, len, mp_lastz(c, diag + l, len), mp, mpi);
+  }
+}
+#else
+static void scrimp_diagonals(sa_mp_workspace *c, int diag, double *mp, int *mpi)
+{
+  for (int l = 0; l < 4 && diag + l < c->mp_len; ++l) {
+    scrimp_diagonal(c, diag + l, 0, mp_lastz(c, diag + l, 0), mp, mpi);
+  }
+}
+#endif
+
+
+struct mp_worker {
+  sa_mp_workspace *c;
+  double          *mp;
+  int             *mpi;
+  int             start;
+  int             end;
+};
+
+
+static void* scrimp_worker(void *arg)
+{
+  struct mp_worker *w = arg;
+  for (int ri = w->start; ri < w->end; ++ri) {
+    scrimp_diagonals(w->c, w->c->rand[ri], w->mp, w->mpi);
+  }
+  return NULL;
+}
+
+
+#ifdef HAVE_PTHREAD
+/* Runs fn on each of the worker arguments (size bytes apart), the calling
+ * thread runs the first one. */
+static bool run_workers(void *(*fn)(void *), void *args, size_t size,
+                        int threads)
+{
+  pthread_t *tid = malloc(sizeof(pthread_t) * threads);
+  if (!tid) {return false;}
+
+  char *a = args;
+  int started = 1;
+  for (; started < threads; ++started) {
+    if (pthread_create(tid + started, NULL, fn, a + size * started)) {break;}
+  }
+  bool ok = started == threads;
+  if (ok) {fn(a);}
+  for (int t = 1; t < started; ++t) {
+    pthread_join(tid[t], NULL);
+  }
+  free(tid);
+  return ok;
+}
+#endif
+
+
+/* Each worker takes a contiguous slice of the shuffled diagonal groups and
+ * keeps a private profile. Merging the profiles in slice order with a strict
+ * less than keeps the first group that reached the minimum, so the result
+ * is identical to the serial calculation regardless of the thread count. */
+static bool scrimp_threads(sa_mp_workspace *c, int groups, int threads)
+{
+#ifdef HAVE_PTHREAD
+  if (c->wthreads < threads - 1) {
+    size_t len = (size_t)c->mp_len * (threads - 1);
+    double *wmp = realloc(c->wmp, sizeof(double) * len);
+    if (wmp) {c->wmp = wmp;}
+    int *wmpi = realloc(c->wmpi, sizeof(int) * len);
+    if (wmpi) {c->wmpi = wmpi;}
+    if (!wmp || !wmpi) {return false;}
+    c->wthreads = threads - 1;
+  }
+
+  struct mp_worker *w = malloc(sizeof(struct mp_worker) * threads);
+  if (!w) {return false;}
+  for (int t = 0; t < threads; ++t) {
+    w[t].c = c;
+    w[t].start = (int)((int64_t)groups * t / threads);
+    w[t].end = (int)((int64_t)groups * (t + 1) / threads);
+    if (t == 0) {
+      w[t].mp = c->mp;
+      w[t].mpi = c->mpi;
+      continue;
+    }
+    w[t].mp = c->wmp + (size_t)c->mp_len * (t - 1);
+    w[t].mpi = c->wmpi + (size_t)c->mp_len * (t - 1);
+    for (int i = 0; i < c->mp_len; ++i) {
+      w[t].mp[i] = INFINITY;
+    }
+  }
+  bool ok = run_workers(scrimp_worker, w, sizeof(struct mp_worker), threads);
+  for (int t = 1; ok && t < threads; ++t) {
+    for (int i = 0; i < c->mp_len; ++i) {
+      if (w[t].mp[i] < c->mp[i]) {
+        c->mp[i] = w[t].mp[i];
+        c->mpi[i] = w[t].mpi[i];
+      }
+    }
+  }
+  free(w);
+  return ok;
+#else
+  (void)threads;
+  struct mp_worker w = { c, c->mp, c->mpi, 0, groups };
+  scrimp_worker(&w);
+  return true;
+#endif
+}
+
+
+static bool scrimp_int(sa_time_series_int *ts, sa_mp_workspace *c, int stop,
+                       int threads)
+{
+  compute_stats(ts, c);
+  int groups = stop / 4 < c->rand_len ? stop / 4 + 1 : c->rand_len;
+  if (groups < c->rand_len && !prescrimp(c)) {return false;}
+  if (threads > groups) {threads = groups;}
+  if (threads > 1) {
+    if (!scrimp_threads(c, groups, threads)) {return false;}
+  } else {
+    struct mp_worker w = { c, c->mp, c->mpi, 0, groups };
+    scrimp_worker(&w);
+  }
+
+  // convert to distances
+  for (int i = 0; i < c->mp_len; ++i) {
+    c->mp[i] = sqrt(fabs(c->mp[i]));
+  }
+  return true;
+}
+
+
+sa_mp_workspace* sa_create_mp_workspace(int n, int m, uint64_t seed)
+{
+  if (m < 4 || n / 4 < m) {return NULL;}
+
+  sa_mp_workspace *c = calloc(1, sizeof(sa_mp_workspace));
+  if (!c) {return NULL;}
+
+  c->n = n;
+  c->m = m;
+  c->mp_len = n - m + 1;
+  c->rand_len = (c->mp_len - m / 4 - 1 + 3) / 4;
+  sa_seed_mp_workspace(c, seed);
+
+  // linearized window followed by the sub-sequence means and inverse standard
+  // deviations
+  c->t = malloc(sizeof(double) * (c->n + 2 * c->mp_len));
+  c->mp = malloc(sizeof(double) * c->mp_len);
+  c->mpi = malloc(sizeof(int) * c->mp_len);
+  c->rand = malloc(sizeof(int) * c->rand_len);
+  if (!c->t || !c->mp || !c->mpi || !c->rand) {
+    sa_destroy_mp_workspace(c);
+    return NULL;
+  }
+  c->mu = c->t + c->n;
+  c->isd = c->mu + c->mp_len;
+  return c;
+}
+
+
+void sa_seed_mp_workspace(sa_mp_workspace *ws, uint64_t seed)
+{
+  assert(ws);
+  // splitmix64 spreads the seed over the xorshift state which must not be 0
+  seed += 0x9E3779B97F4A7C15ULL;
+  seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+  seed ^= seed >> 31;
+  ws->rng = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+
+void sa_destroy_mp_workspace(sa_mp_workspace *ws)
+{
+  if (!ws) {return;}
+  free(ws->t);
+  free(ws->mp);
+  free(ws->mpi);
+  free(ws->wmp);
+  free(ws->wmpi);
+  free(ws->rand);
+  free(ws->fft);
+  free(ws);
+}
+
+
+int sa_mp_workspace_time_series_int(sa_time_series_int *ts,
+                                    sa_mp_workspace *ws,
+                                    uint64_t ns,
+                                    double percent,
+                                    int threads,
+                                    const double *mp[],
+                                    const int *mpi[])
+{
+  assert(ws);
+  int idx = find_index_int(ts, ns, false);
+  if (idx == -1 || ws->n > ts->rows || percent <= 0 || percent > 100
+      || threads < 1) {
+    return 0;
+  }
+
+  ws->sidx = idx;
+  reset_workspace(ws);
+  if (!scrimp_int(ts, ws, percent / 100 * ws->mp_len + 1, threads)) {
+    return 0;
+  }
+  *mp = ws->mp;
+  *mpi = ws->mpi;
+  return ws->mp_len;
+}
+
+
+int sa_mp_time_series_int(sa_time_series_int *ts,
+                          uint64_t ns,
+                          int n,
+                          int m,
+                          double percent,
+                          double *mp[],
+                          int *mpi[])
+{
+  return sa_mp_threads_time_series_int(ts, ns, n, m, percent, 1, mp, mpi);
+}
+
+
+int sa_mp_threads_time_series_int(sa_time_series_int *ts,
+                                  uint64_t ns,
+                                  int n,
+                                  int m,
+                                  double percent,
+                                  int threads,
+                                  double *mp[],
+                                  int *mpi[])
+{
+  sa_mp_workspace *ws = sa_create_mp_workspace(n, m, (uint64_t)rand());
+  if (!ws) {return 0;}
+
+  const double *wmp;
+  const int *wmpi;
+  int len = sa_mp_workspace_time_series_int(ts, ws, ns, percent, threads, &wmp,
+                                            &wmpi);
+  if (len) {
+    // hand the profile over to the caller
+    *mp = ws->mp;
+    *mpi = ws->mpi;
+    ws->mp = NULL;
+    ws->mpi = NULL;
+  }
+  sa_destroy_mp_workspace(ws);
+  return len;
+}
+
+
+int sa_dp_workspace_time_series_int(sa_time_series_int *ts,
+                                    sa_mp_workspace *ws,
+                                    uint64_t query_ns,
+                                    uint64_t ns,
+                                    const double *dp[])
+{
+  assert(ws);
+  int idx = find_index_int(ts, ns, false);
+  int qidx = find_index_int(ts, query_ns, false);
+  if (idx == -1 || qidx == -1 || ws->n > ts->rows
+      || query_ns / ts->ns_per_row + ws->m - 1 > ts->current_row) {
+    return 0;
+  }
+
+  ws->sidx = idx;
+  compute_stats(ts, ws);
+  double center;
+  if (!fft_window(ws, &center)) {return 0;}
+
+  // the query is staged in the profile buffer, it is consumed before the
+  // distances are written
+  double *q = ws->mp;
+  sa_running_stats rs;
+  sa_init_running_stats(&rs);
+  for (int x = 0; x < ws->m; ++x) {
+    q[x] = ts->v[(qidx + x) % ts->rows];
+    sa_add_running_stats(&rs, q[x]);
+  }
+  double dm = ws->m, mq = dm * (rs.mean - center);
+  double isdq = 1 / sa_usd_running_stats(&rs);
+  const double *qt = sliding_dots(ws, q, NULL, center);
+  for (int j = 0; j < ws->mp_len; ++j) {
+    ws->mp[j] = sqrt(fabs(2 * (dm - (qt[j] - mq * (ws->mu[j] - center))
+                               * isdq * ws->isd[j])));
+  }
+  *dp = ws->mp;
+  return ws->mp_len;
+}
+
+
+int sa_dp_time_series_int(sa_time_series_int *ts,
+                          uint64_t query_ns,
+                          uint64_t ns,
+                          int n,
+                          int m,
+                          double *dp[])
+{
+  sa_mp_workspace *ws = sa_create_mp_workspace(n, m, 0);
+  if (!ws) {return 0;}
+
+  const double *wdp;
+  int len = sa_dp_workspace_time_series_int(ts, ws, query_ns, ns, &wdp);
+  if (len) {
+    *dp = ws->mp;
+    ws->mp = NULL;
+  }
+  sa_destroy_mp_workspace(ws);
+  return len;
+}
+
+
+int sa_mp_discords(const double *mp,
+                   int len,
+                   int m,
+                   int k,
+                   sa_mp_discord *discords,
+                   double *p50,
+                   double *p95)
+{
+  assert(mp && (discords || k == 0));
+  sa_p2_quantile q50 = { .p = 0.50f }, q95 = { .p = 0.95f };
+  sa_init_p2_quantile(&q50);
+  sa_init_p2_quantile(&q95);
+  double e50 = NAN, e95 = NAN;
+
+  int found = 0;
+  for (int d = 0; d < k || (d == 0 && (p50 || p95)); ++d) {
+    int idx = -1;
+    double discord = -INFINITY;
+    for (int i = 0; i < len; ++i) {
+      if (d == 0 && (p50 || p95)) {
+        e50 = sa_add_p2_quantile(&q50, mp[i]);
+        e95 = sa_add_p2_quantile(&q95, mp[i]);
+      }
+      if (d < k && mp[i] > discord) {
+        bool overlaps = false;
+        for (int j = 0; j < found && !overlaps; ++j) {
+          overlaps = abs(discords[j].idx - i) < m;
+        }
+        if (!overlaps) {
+          discord = mp[i];
+          idx = i;
+        }
+      }
+    }
+    if (idx != -1) {
+      discords[found].idx = idx;
+      discords[found].distance = discord;
+      ++found;
+    }
+  }
+  if (p50) {*p50 = e50;}
+  if (p95) {*p95 = e95;}
+  return found;
+}
+
+
+struct mmp_calc {
+  double  *t; // values interleaved by dimension t[x * d + k]
+  double  *mu;
+  double  *isd;
+  int     d;
+  int     n;
+  int     m;
+  int     mp_len;
+};
+
+
+struct mmp_worker {
+  const struct mmp_calc *c;
+  double                *mp; // sums of the k smallest, interleaved
+  int                   *mpi;
+  double                *q; // running dot product of each dimension
+  double                *dist;
+  int                   start;
+  int                   end;
+};
+
+
+/* Evaluates the diagonals start to end - 1. Every step updates the dot
+ * products of all the dimensions in one contiguous pass, sorts the per
+ * dimension distances and updates the k-dimensional profiles with the sum of
+ * the k smallest ones (mSTAMP, averaged once at the end). */
+static void* mmp_worker(void *arg)
+{
+  struct mmp_worker *w = arg;
+  const struct mmp_calc *c = w->c;
+  const double *t = c->t;
+  double *q = w->q, *dist = w->dist, dm = c->m;
+  int d = c->d, m = c->m;
+
+  for (int diag = w->start; diag < w->end; ++diag) {
+    for (int k = 0; k < d; ++k) {
+      q[k] = 0;
+    }
+    for (int x = 0; x < m; ++x) {
+      const double *a = t + x * d, *b = t + (x + diag) * d;
+      for (int k = 0; k < d; ++k) {
+        q[k] += a[k] * b[k];
+      }
+    }
+
+    for (int i = 0, j = diag; j < c->mp_len; ++i, ++j) {
+      if (i > 0) {
+        const double *ai = t + (i + m - 1) * d, *aj = t + (j + m - 1) * d;
+        const double *oi = t + (i - 1) * d, *oj = t + (j - 1) * d;
+        for (int k = 0; k < d; ++k) {
+          q[k] += ai[k] * aj[k] - oi[k] * oj[k];
+        }
+      }
+      const double *mui = c->mu + i * d, *muj = c->mu + j * d;
+      const double *isdi = c->isd + i * d, *isdj = c->isd + j * d;
+      for (int k = 0; k < d; ++k) {
+        dist[k] = sqrt(fabs(2 * (dm - (q[k] - dm * mui[k] * muj[k]) * isdi[k]
+                                 * isdj[k])));
+      }
+      for (int k = 1; k < d; ++k) {
+        double v = dist[k];
+        int x = k - 1;
+        for (; x >= 0 && dist[x] > v; --x) {
+          dist[x + 1] = dist[x];
+        }
+        dist[x + 1] = v;
+      }
+
+      double sum = 0;
+      double *mpi = w->mp + i * d, *mpj = w->mp + j * d;
+      int *idxi = w->mpi + i * d, *idxj = w->mpi + j * d;
+      for (int k = 0; k < d; ++k) {
+        sum += dist[k];
+        if (sum < mpi[k]) {
+          mpi[k] = sum;
+          idxi[k] = j;
+        }
+        if (sum < mpj[k]) {
+          mpj[k] = sum;
+          idxj[k] = i;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+
+/* Computes the per dimension statistics once and splits the diagonals into
+ * contiguous slices of equal work (a diagonal costs its length). The private
+ * profiles are merged in slice order so the result does not depend on the
+ * thread count. The returned profiles are the sums averaged and grouped by
+ * dimension count. */
+static int mmp_compute(struct mmp_calc *c, int threads, double *mp[],
+                       int *mpi[])
+{
+  int d = c->d, len = c->mp_len, first = c->m / 4 + 1;
+  for (int k = 0; k < d; ++k) {
+    sliding_stats(c->t + k, d, c->n, c->m, c->mu + k, c->isd + k);
+  }
+#ifndef HAVE_PTHREAD
+  threads = 1;
+#endif
+  if (threads > len - first) {threads = len - first;}
+
+  size_t plen = (size_t)len * d;
+  double *wmp = malloc(sizeof(double) * (plen + 2 * d) * threads);
+  int *wmpi = malloc(sizeof(int) * plen * threads);
+  struct mmp_worker *w = malloc(sizeof(struct mmp_worker) * threads);
+  double *omp = malloc(sizeof(double) * plen);
+  int *ompi = malloc(sizeof(int) * plen);
+  bool ok = wmp && wmpi && w && omp && ompi;
+  if (ok) {
+    int64_t total = 0, acc = 0;
+    for (int diag = first; diag < len; ++diag) {
+      total += len - diag;
+    }
+    for (int t = 0, diag = first; t < threads; ++t) {
+      w[t].c = c;
+      w[t].mp = wmp + plen * t;
+      w[t].mpi = wmpi + plen * t;
+      w[t].q = wmp + plen * threads + 2 * d * t;
+      w[t].dist = w[t].q + d;
+      w[t].start = diag;
+      for (; diag < len && acc * threads < total * (t + 1); ++diag) {
+        acc += len - diag;
+      }
+      w[t].end = t == threads - 1 ? len : diag;
+      for (size_t i = 0; i < plen; ++i) {
+        w[t].mp[i] = INFINITY;
+        w[t].mpi[i] = 0;
+      }
+    }
+#ifdef HAVE_PTHREAD
+    ok = run_workers(mmp_worker, w, sizeof(struct mmp_worker), threads);
+#else
+    mmp_worker(w);
+#endif
+  }
+  if (ok) {
+    for (int t = 1; t < threads; ++t) {
+      for (size_t i = 0; i < plen; ++i) {
+        if (w[t].mp[i] < wmp[i]) {
+          wmp[i] = w[t].mp[i];
+          wmpi[i] = w[t].mpi[i];
+        }
+      }
+    }
+    for (int k = 0; k < d; ++k) {
+      for (int i = 0; i < len; ++i) {
+        omp[k * len + i] = wmp[i * d + k] / (k + 1);
+        ompi[k * len + i] = wmpi[i * d + k];
+      }
+    }
+    *mp = omp;
+    *mpi = ompi;
+  } else {
+    free(omp);
+    free(ompi);
+  }
+  free(w);
+  free(wmpi);
+  free(wmp);
+  return ok ? len : 0;
+}
+
+
+int sa_mmp_time_series_int(sa_time_series_int *ts[],
+                           int d,
+                           uint64_t ns,
+                           int n,
+                           int m,
+                           int threads,
+                           double *mp[],
+                           int *mpi[])
+{
+  if (d < 1 || m < 4 || n / 4 < m || threads < 1) {return 0;}
+  for (int k = 0; k < d; ++k) {
+    if (ts[k]->ns_per_row != ts[0]->ns_per_row || n > ts[k]->rows
+        || find_index_int(ts[k], ns, false) == -1) {
+      return 0;
+    }
+  }
+
+  struct mmp_calc c = { .d = d, .n = n, .m = m, .mp_len = n - m + 1 };
+  c.t = malloc(sizeof(double) * ((size_t)n + 2 * c.mp_len) * d);
+  if (!c.t) {return 0;}
+  c.mu = c.t + (size_t)n * d;
+  c.isd = c.mu + (size_t)c.mp_len * d;
+  for (int k = 0; k < d; ++k) {
+    linearize(ts[k], find_index_int(ts[k], ns, false), n, d, c.t + k);
+  }
+  int len = mmp_compute(&c, threads, mp, mpi);
+  free(c.t);
+  return len;
+}
+
+
+int sa_mmp_matrix_int(sa_matrix_int *mat,
+                      int m,
+                      int threads,
+                      double *mp[],
+                      int *mpi[])
+{
+  assert(mat);
+  int d = mat->rows, n = mat->cols;
+  if (m < 4 || n / 4 < m || threads < 1) {return 0;}
+
+  struct mmp_calc c = { .d = d, .n = n, .m = m, .mp_len = n - m + 1 };
+  c.t = malloc(sizeof(double) * ((size_t)n + 2 * c.mp_len) * d);
+  if (!c.t) {return 0;}
+  c.mu = c.t + (size_t)n * d;
+  c.isd = c.mu + (size_t)c.mp_len * d;
+  for (int k = 0; k < d; ++k) {
+    for (int x = 0; x < n; ++x) {
+      c.t[x * d + k] = mat->v[k * n + x];
+    }
+  }
+  int len = mmp_compute(&c, threads, mp, mpi);
+  free(c.t);
+  return len;
+}
+
+
+struct join_calc {
+  double  *ta; // linearized sequence a followed by its statistics
+  double  *mua;
+  double  *isda;
+  double  *tb;
+  double  *mub;
+  double  *isdb;
+  int     m;
+  int     la; // number of sub-sequences in a
+  int     lb;
+};
+
+
+struct join_worker {
+  const struct join_calc *c;
+  double                 *mp; // squared distances until the final pass
+  int                    *mpi;
+  int                    start;
+  int                    end;
+};
+
+
+/* Evaluates the diagonals start to end - 1, diagonal g pairs a[i] with
+ * b[i - g + lb - 1]. */
+static void* join_worker(void *arg)
 {
-  assert(ts);
-  ts->current_time = ts->ns_per_row * (ts->rows - 1);
-  memset(ts->v, 0, sizeof(int) * ts->rows);
+  struct join_worker *w = arg;
+  const struct join_calc *c = w->c;
+  const double *ta = c->ta, *tb = c->tb;
+  double dm = c->m;
+
+  for (int g = w->start; g < w->end; ++g) {
+    int offset = g - (c->lb - 1);
+    int i = offset > 0 ? offset : 0;
+    int j = offset < 0 ? -offset : 0;
+    int len = c->la - i < c->lb - j ? c->la - i : c->lb - j;
+    double q = 0;
+    for (int x = 0; x < c->m; ++x) {
+      q += ta[i + x] * tb[j + x];
+    }
+    for (int s = 0; s < len; ++s, ++i, ++j) {
+      if (s > 0) {
+        q += ta[i + c->m - 1] * tb[j + c->m - 1] - ta[i - 1] * tb[j - 1];
+      }
+      double d = 2 * (dm - (q - dm * c->mua[i] * c->mub[j]) * c->isda[i]
+                      * c->isdb[j]);
+      if (d < w->mp[i]) {
+        w->mp[i] = d;
+        w->mpi[i] = j;
+      }
+    }
+  }
+  return NULL;
 }
 
 
-int sa_add_time_series_int(sa_time_series_int *ts, uint64_t ns, int v)
+/* Splits the diagonals into contiguous slices of equal work like mmp_compute,
+ * the first slice writes directly into the returned profile. */
+static int join_compute(struct join_calc *c, int threads, double *mp[],
+                        int *mpi[])
 {
-  assert(ts);
-  int idx = find_index_int(ts, ns, true);
-  if (idx == -1) {return INT_MIN;}
-  int64_t nv = (int64_t)ts->v[idx] + v;
-  if (nv > INT_MAX) {
-    nv = INT_MAX;
-  } else if (nv < INT_MIN) {
-    nv = INT_MIN;
+  int diags = c->la + c->lb - 1;
+#ifndef HAVE_PTHREAD
+  threads = 1;
+#endif
+  if (threads > diags) {threads = diags;}
+
+  size_t plen = (size_t)c->la;
+  double *omp = malloc(sizeof(double) * plen);
+  int *ompi = malloc(sizeof(int) * plen);
+  // private profiles of the remaining slices (never a zero byte allocation)
+  double *wmp = malloc(sizeof(double) * plen * (threads - 1) + 1);
+  int *wmpi = malloc(sizeof(int) * plen * (threads - 1) + 1);
+  struct join_worker *w = malloc(sizeof(struct join_worker) * threads);
+  bool ok = omp && ompi && wmp && wmpi && w;
+  if (ok) {
+    int64_t total = (int64_t)c->la * c->lb, acc = 0;
+    for (int t = 0, g = 0; t < threads; ++t) {
+      w[t].c = c;
+      w[t].mp = t == 0 ? omp : wmp + plen * (t - 1);
+      w[t].mpi = t == 0 ? ompi : wmpi + plen * (t - 1);
+      w[t].start = g;
+      for (; g < diags && acc * threads < total * (t + 1); ++g) {
+        int offset = g - (c->lb - 1);
+        int i = offset > 0 ? offset : 0, j = offset < 0 ? -offset : 0;
+        acc += c->la - i < c->lb - j ? c->la - i : c->lb - j;
+      }
+      w[t].end = t == threads - 1 ? diags : g;
+      for (size_t i = 0; i < plen; ++i) {
+        w[t].mp[i] = INFINITY;
+        w[t].mpi[i] = 0;
+      }
+    }
+#ifdef HAVE_PTHREAD
+    ok = run_workers(join_worker, w, sizeof(struct join_worker), threads);
+#else
+    join_worker(w);
+#endif
   }
-  ts->v[idx] = nv;
-  return nv;
+  if (ok) {
+    for (int t = 1; t < threads; ++t) {
+      for (size_t i = 0; i < plen; ++i) {
+        if (w[t].mp[i] < omp[i]) {
+          omp[i] = w[t].mp[i];
+          ompi[i] = w[t].mpi[i];
+        }
+      }
+    }
+    for (size_t i = 0; i < plen; ++i) {
+      omp[i] = sqrt(fabs(omp[i]));
+    }
+    *mp = omp;
+    *mpi = ompi;
+  } else {
+    free(omp);
+    free(ompi);
+  }
+  free(w);
+  free(wmpi);
+  free(wmp);
+  return ok ? c->la : 0;
 }
 
 
-int sa_set_time_series_int(sa_time_series_int *ts, uint64_t ns, int v)
+int sa_mp_join_time_series_int(sa_time_series_int *a,
+                               uint64_t ans,
+                               int na,
+                               sa_time_series_int *b,
+                               uint64_t bns,
+                               int nb,
+                               int m,
+                               int threads,
+                               double *mp[],
+                               int *mpi[])
 {
-  assert(ts);
-  int idx = find_index_int(ts, ns, true);
-  if (idx == -1) {return INT_MIN;}
-  ts->v[idx] = v;
-  return v;
+  assert(a && b);
+  int aidx = find_index_int(a, ans, false);
+  int bidx = find_index_int(b, bns, false);
+  if (aidx == -1 || bidx == -1 || m < 4 || na < m || nb < m || na > a->rows
+      || nb > b->rows || threads < 1) {
+    return 0;
+  }
+
+  struct join_calc c = { .m = m, .la = na - m + 1, .lb = nb - m + 1 };
+  c.ta = malloc(sizeof(double) * ((size_t)na + 2 * c.la + nb + 2 * c.lb));
+  if (!c.ta) {return 0;}
+  c.mua = c.ta + na;
+  c.isda = c.mua + c.la;
+  c.tb = c.isda + c.la;
+  c.mub = c.tb + nb;
+  c.isdb = c.mub + c.lb;
+  linearize(a, aidx, na, 1, c.ta);
+  sliding_stats(c.ta, 1, na, m, c.mua, c.isda);
+  linearize(b, bidx, nb, 1, c.tb);
+  sliding_stats(c.tb, 1, nb, m, c.mub, c.isdb);
+  int len = join_compute(&c, threads, mp, mpi);
+  free(c.ta);
+  return len;
 }
 
 
-int sa_get_time_series_int(sa_time_series_int *ts, uint64_t ns)
+static double stream_dot(sa_time_series_int *ts, uint64_t a, uint64_t b, int m)
 {
-  assert(ts);
-  int idx = find_index_int(ts, ns, false);
-  if (idx == -1) {return INT_MIN;}
-  return ts->v[idx];
+  double dot = 0;
+  for (int x = 0; x < m; ++x) {
+    dot += (double)ts->v[TS_RING_INDEX(ts, a + x)]
+        * ts->v[TS_RING_INDEX(ts, b + x)];
+  }
+  return dot;
 }
 
 
-static void shuffle_idx(int *a, int len)
+/* Folds the sub-sequence starting at row s into the profile; the previous
+   call MUST have been for s - 1 unless the stream is empty. The dot product
+   row is recomputed directly once per len sub-sequences to bound the
+   rounding drift of the recurrence. */
+static void stream_add_int(sa_mp_stream_int *mps, uint64_t s)
 {
-  for (int i = 0; i < len - 1; ++i) {
-    int j = i + rand() / (RAND_MAX / (len - i) + 1);
-    int tmp = a[j];
-    a[j] = a[i];
-    a[i] = tmp;
+  sa_time_series_int *ts = mps->ts;
+  double *mu = MP_STREAM_MU(mps);
+  double *isd = MP_STREAM_ISD(mps);
+  double *mp = MP_STREAM_MP(mps);
+  double *qo = MP_STREAM_QT(mps, mps->qt);
+  double *qn = MP_STREAM_QT(mps, !mps->qt);
+  uint64_t *mpi = MP_STREAM_MPI(mps);
+  int m = mps->m, len = mps->len;
+  int slot = (int)(s % len);
+
+  double mean = 0, ss = 0;
+  for (int x = 0; x < m; ++x) {
+    mean += ts->v[TS_RING_INDEX(ts, s + x)];
+  }
+  mean /= m;
+  for (int x = 0; x < m; ++x) {
+    double d = ts->v[TS_RING_INDEX(ts, s + x)] - mean;
+    ss += d * d;
+  }
+  mu[slot] = mean;
+  isd[slot] = 1 / sqrt(ss / m);
+
+  int count = mps->count < len ? mps->count + 1 : len;
+  uint64_t oldest = s - count + 1;
+  int js = (int)(oldest % len);
+  if (mps->count == 0 || s % len == 0) {
+    for (int i = 0, j = js; i < count; ++i) {
+      qn[j] = stream_dot(ts, oldest + i, s, m);
+      if (++j == len) {j = 0;}
+    }
+  } else {
+    // a growing window has no previous dot product for its oldest entry
+    int i = 0, j = js;
+    if (mps->count < len) {
+      qn[j] = stream_dot(ts, oldest, s, m);
+      if (++j == len) {j = 0;}
+      ++i;
+    }
+    double a = ts->v[TS_RING_INDEX(ts, s - 1)];
+    double b = ts->v[TS_RING_INDEX(ts, s + m - 1)];
+    int p = j == 0 ? len - 1 : j - 1;
+    int t0 = TS_RING_INDEX(ts, oldest + i - 1);
+    int t1 = TS_RING_INDEX(ts, oldest + i + m - 1);
+    for (; i < count; ++i) {
+      qn[j] = qo[p] - ts->v[t0] * a + ts->v[t1] * b;
+      p = j;
+      if (++j == len) {j = 0;}
+      if (++t0 == ts->rows) {t0 = 0;}
+      if (++t1 == ts->rows) {t1 = 0;}
+    }
+  }
+
+  double dm = m, mus = dm * mean, isds = isd[slot];
+  double best = INFINITY;
+  uint64_t bi = UINT64_MAX;
+  int neighbors = count - m / 4 - 1;
+  for (int i = 0, j = js; i < neighbors; ++i) {
+    double d = 2 * (dm - (qn[j] - mus * mu[j]) * isd[j] * isds);
+    if (d < mp[j]) {
+      mp[j] = d;
+      mpi[j] = s;
+    }
+    if (d < best) {
+      best = d;
+      bi = oldest + i;
+    }
+    if (++j == len) {j = 0;}
   }
+  mp[slot] = best;
+  mpi[slot] = bi;
+  mps->qt = !mps->qt;
+  mps->count = count;
+  mps->last = s;
 }
 
 
-static bool init_calc(struct mp_calc *c, int n, int m)
+sa_mp_stream_int* sa_create_mp_stream_int(sa_time_series_int *ts, int n, int m)
 {
-  c->n = n;
-  c->m = m;
-  c->mp_len = n - m + 1;
-  c->rand = NULL;
-  c->mpi = NULL;
-  c->mp = NULL;
-  c->dp = NULL;
+  if (!ts || n >= ts->rows || m < 4 || n / 4 < m) {return NULL;}
 
-  c->stats = malloc(sizeof(double) * 2 * c->mp_len);
-  if (!c->stats) {return false;}
+  sa_mp_stream_int *mps = malloc(MP_STREAM_INT_SIZE(n, m));
+  if (!mps) {return NULL;}
 
-  c->dp = malloc(sizeof(double) * c->n);
-  if (!c->dp) {return false;}
+  mps->ts = ts;
+  mps->n = n;
+  mps->m = m;
+  mps->len = n - m + 1;
+  sa_init_mp_stream_int(mps);
+  return mps;
+}
 
-  c->mp = malloc(sizeof(double) * c->mp_len);
-  if (!c->mp) {return false;}
 
-  c->mpi = calloc(c->mp_len, sizeof(int));
-  if (!c->mpi) {return false;}
+void sa_init_mp_stream_int(sa_mp_stream_int *mps)
+{
+  assert(mps);
+  mps->last = 0;
+  mps->count = 0;
+  mps->qt = 0;
+}
 
-  int exclude = m / 4;
-  c->rand_len = c->mp_len - exclude - 1;
-  c->rand = malloc(sizeof(int) * c->rand_len);
-  if (!c->rand) {return false;}
 
-  for (int i = 0; i < c->mp_len; ++i) {
-    c->mp[i] = INFINITY;
+double sa_update_mp_stream_int(sa_mp_stream_int *mps)
+{
+  assert(mps);
+  sa_time_series_int *ts = mps->ts;
+  if (ts->current_row < (uint64_t)mps->n) {return NAN;}
+
+  // the current row is still open, the newest sub-sequence ends before it
+  uint64_t target = ts->current_row - mps->m;
+  uint64_t first = ts->current_row - (ts->rows - 1);
+  uint64_t s = mps->last + 1;
+  if (mps->count == 0 || target < mps->last
+      || target - mps->last >= (uint64_t)mps->len
+      || mps->last + 1 < first + mps->len) {
+    mps->count = 0;
+    s = target - (mps->len - 1);
   }
-
-  for (int i = 0, idx = exclude + 1; idx < c->mp_len; ++i, ++idx) {
-    c->rand[i] = idx;
+  for (; s <= target; ++s) {
+    stream_add_int(mps, s);
   }
-  shuffle_idx(c->rand, c->rand_len);
-  return true;
+  return sqrt(fabs(MP_STREAM_MP(mps)[mps->last % mps->len]));
 }
 
 
-static int tsidx(int j, int n, int offset)
+uint64_t sa_timestamp_mp_stream_int(sa_mp_stream_int *mps)
 {
-  int idx = j + offset;
-  return idx >= n ? idx - n : idx;
+  assert(mps);
+  return mps->count ? mps->last * mps->ts->ns_per_row : 0;
 }
 
 
-static void compute_stats(sa_time_series_int *ts, struct mp_calc *c)
+int sa_get_mp_stream_int(sa_mp_stream_int *mps, double *mp, int *mpi)
 {
-  sa_running_stats rs;
-  sa_init_running_stats(&rs);
-  int window = 0;
-  int idx = c->sidx;
-  for (int i = 0; i < c->n; ++i, ++idx) {
-    if (idx == ts->rows) {idx = 0;}
-    if (i >= c->m) {
-      c->stats[window * 2] = rs.mean;
-      c->stats[window * 2 + 1] = sa_usd_running_stats(&rs);
-      ++window;
-      int fi = idx - c->m;
-      if (fi < 0) {
-        fi += ts->rows;
-      }
-      double pm = rs.mean;
-      rs.mean += (ts->v[idx] - ts->v[fi]) / rs.count;
-      rs.sum += (ts->v[idx] - pm) * (ts->v[idx] - rs.mean) -
-          (ts->v[fi] - pm) * (ts->v[fi] - rs.mean);
-    } else {
-      sa_add_running_stats(&rs, ts->v[idx]);
+  assert(mps);
+  double *v = MP_STREAM_MP(mps);
+  uint64_t *vi = MP_STREAM_MPI(mps);
+  uint64_t oldest = mps->last - mps->count + 1;
+  int j = (int)(oldest % mps->len);
+  for (int i = 0; i < mps->count; ++i) {
+    if (mp) {mp[i] = sqrt(fabs(v[j]));}
+    if (mpi) {
+      mpi[i] = vi[j] >= oldest && vi[j] <= mps->last ? (int)(vi[j] - oldest)
+          : -1;
     }
+    if (++j == mps->len) {j = 0;}
   }
-  c->stats[window * 2] = rs.mean;
-  c->stats[window * 2 + 1] = sa_usd_running_stats(&rs);
+  return mps->count;
 }
 
 
-static void scrimp_int(sa_time_series_int *ts, struct mp_calc *c, int stop)
+void sa_destroy_mp_stream_int(sa_mp_stream_int *mps)
 {
-  compute_stats(ts, c);
-  int j, i;
-  double d, lastz;
-  for (int ri = 0; ri < c->rand_len; ++ri) {
-    int diag = c->rand[ri];
-    for (j = diag; j < c->n; ++j) {
-      c->dp[j] = ts->v[tsidx(j, ts->rows, c->sidx)]
-          * ts->v[tsidx(j - diag, ts->rows, c->sidx)];
-    }
-
-    // evaluate the first distance value in the current diagonal
-    lastz = 0;
-    for (j = 0; j < c->m; j++) {
-      lastz += c->dp[j + diag];
-    }
-
-    j = diag, i = 0;
-    d = 2 * (c->m - (lastz - c->m * c->stats[j * 2] * c->stats[i * 2])
-             / (c->stats[j * 2 + 1] * c->stats[i * 2 + 1]));
-    if (d < c->mp[j]) {
-      c->mp[j] = d;
-      c->mpi[j] = i;
-    }
-    if (d < c->mp[i]) {
-      c->mp[i] = d;
-      c->mpi[i] = j;
-    }
-
-    // evaluate the remaining distance values in the current diagonal
-    for (j = diag + 1; j < c->mp_len; ++j) {
-      i = j - diag;
-      lastz = lastz + c->dp[j + c->m - 1] - c->dp[j - 1];
-      d = 2 * (c->m - (lastz - c->m * c->stats[j * 2] * c->stats[i * 2])
-               / (c->stats[j * 2 + 1] * c->stats[i * 2 + 1]));
-      if (d < c->mp[j]) {
-        c->mp[j] = d;
-        c->mpi[j] = i;
-      }
-      if (d < c->mp[i]) {
-        c->mp[i] = d;
-        c->mpi[i] = j;
-      }
-    }
-    if (ri == stop) {
-      break;
-    }
-  }
+  free(mps);
+}
 
-  // convert to distances
-  for (i = 0; i < c->mp_len; ++i) {
-    c->mp[i] = sqrt(fabs(c->mp[i]));
+
+int sa_window_stats_time_series_int(sa_time_series_int *ts,
+                                    sa_running_stats *rs,
+                                    int *min,
+                                    int *max)
+{
+  assert(ts && rs && min && max);
+  if (!ts->window) {return 1;}
+
+  ts_window_int *w = TS_WINDOW_INT(ts);
+  if (w->dirty) {window_rebuild(ts, w);}
+
+  int64_t current_row = ts->current_row;
+  *min = *max = ts->v[ts->current_idx];
+  if (w->min_len) {
+    int v = window_value(ts, current_row, w->dq[w->min_head]);
+    if (v < *min) {*min = v;}
   }
+  if (w->max_len) {
+    int v = window_value(ts, current_row, w->dq[ts->window + w->max_head]);
+    if (v > *max) {*max = v;}
+  }
+
+  rs->count = ts->window;
+  rs->mean = (double)w->sum / ts->window;
+  rs->sum = exact_sumsq_m2(&w->sumsq, w->sum, (uint32_t)ts->window);
+  return 0;
 }
 
 
-int sa_mp_time_series_int(sa_time_series_int *ts,
-                          uint64_t ns,
-                          int n,
-                          int m,
-                          double percent,
-                          double *mp[],
-                          int *mpi[])
+int sa_range_stats_time_series_int(sa_time_series_int *ts,
+                                   uint64_t ns,
+                                   int n,
+                                   sa_range_stats_int *rs)
 {
+  assert(ts && rs);
   int idx = find_index_int(ts, ns, false);
-  if (idx == -1 || n > ts->rows || percent <= 0 || percent > 100
-      || m < 4 || n / 4 < m) {
+  if (idx == -1 || n < 1 || n > ts->rows) {return 1;}
+
+  rs->sum = 0;
+  rs->m2 = 0;
+  rs->min = INT_MAX;
+  rs->max = INT_MIN;
+  rs->nonzero = 0;
+  if (ts->index) {
+    int len = ts->rows - idx < n ? ts->rows - idx : n;
+    index_query(ts, idx, idx + len, rs);
+    index_query(ts, 0, n - len, rs);
     return 0;
   }
 
-  struct mp_calc c;
-  c.sidx = idx;
-  if (!init_calc(&c, n, m)) {
-    free(c.stats);
-    free(c.dp);
-    free(c.rand);
-    free(c.mp);
-    free(c.mpi);
-    return 0;
+  // two passes, the deviations are taken from the exact mean of the first
+  int start = idx;
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == ts->rows) {idx = 0;}
+    int v = ts->v[idx];
+    if (!v) {continue;}
+    rs->sum += v;
+    if (v < rs->min) {rs->min = v;}
+    if (v > rs->max) {rs->max = v;}
+    ++rs->nonzero;
+  }
+  if (!rs->nonzero) {return 0;}
+
+  double mean = (double)rs->sum / rs->nonzero;
+  idx = start;
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == ts->rows) {idx = 0;}
+    int v = ts->v[idx];
+    if (v) {
+      double d = v - mean;
+      rs->m2 += d * d;
+    }
   }
-  scrimp_int(ts, &c, percent / 100 * c.mp_len + 1);
-  free(c.stats);
-  free(c.dp);
-  free(c.rand);
-  *mp = c.mp;
-  *mpi = c.mpi;
-  return c.mp_len;
+  return 0;
 }
 
 
@@ -307,22 +2105,13 @@ uint64_t sa_timestamp_time_series_int(sa_time_series_int *ts)
 
 static size_t time_series_int_size(sa_time_series_int *ts)
 {
-  return sizeof(sa_time_series_int) + sizeof(int) * ts->rows;
+  // fixed at the original struct layout (the header padding is zero filled)
+  return sizeof(uint64_t) * 2 + sizeof(int) * 2 + sizeof(int) * ts->rows;
 }
 
 
-char* sa_serialize_time_series_int(sa_time_series_int *ts, size_t *len)
+static void serialize_int(sa_time_series_int *ts, char *cp)
 {
-  assert(ts && len);
-
-  *len = time_series_int_size(ts);
-  char *buf = malloc(*len);
-  if (!buf) {
-    *len = 0;
-    return NULL;
-  }
-
-  char *cp = buf;
   n2b(&ts->current_time, cp, sizeof(uint64_t));
   cp += sizeof(uint64_t);
 
@@ -335,6 +2124,21 @@ char* sa_serialize_time_series_int(sa_time_series_int *ts, size_t *len)
   for (int i = 0; i < ts->rows; ++i, cp += sizeof(int)) {
     n2b(ts->v + i, cp, sizeof(int));
   }
+  memset(cp, 0, sizeof(int));
+}
+
+
+char* sa_serialize_time_series_int(sa_time_series_int *ts, size_t *len)
+{
+  assert(ts && len);
+
+  *len = time_series_int_size(ts);
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+  serialize_int(ts, buf);
   return buf;
 }
 
@@ -374,6 +2178,331 @@ sa_deserialize_time_series_int(sa_time_series_int *ts, const char *buf,
   for (int i = 0; i < rows; ++i, cp += sizeof(int)) {
     b2n(cp, ts->v + i, sizeof(int));
   }
+  ts->current_row = ts->current_time / ts->ns_per_row;
+  ts->current_time = ts->current_row * ts->ns_per_row;
+  ts->current_idx = TS_RING_INDEX(ts, ts->current_row);
+  window_reset(ts);
+  index_rebuild(ts);
+  return 0;
+}
+
+
+static int rollup_combine(sa_rollup_cf cf, int a, int b)
+{
+  if (a == 0) {return b;}
+  if (b == 0) {return a;}
+  if (cf == SA_ROLLUP_MIN) {return a < b ? a : b;}
+  return a > b ? a : b;
+}
+
+
+static void rollup_fold(sa_rollup_time_series_int *rts, int l, uint64_t ns,
+                        int v);
+
+/* Folds the current row of level l into the next level, called before level l
+   advances past it. */
+static void rollup_close(sa_rollup_time_series_int *rts, int l)
+{
+  if (l + 1 == rts->levels) {return;}
+  sa_time_series_int *ts = rts->level[l];
+  rollup_fold(rts, l + 1, ts->current_time, ts->v[ts->current_idx]);
+}
+
+
+static void rollup_fold(sa_rollup_time_series_int *rts, int l, uint64_t ns,
+                        int v)
+{
+  if (v == 0) {return;}
+  sa_time_series_int *ts = rts->level[l];
+  if (ns >= ts->current_time && ns - ts->current_time >= ts->ns_per_row) {
+    rollup_close(rts, l);
+  }
+  int idx = find_index_int(ts, ns, true);
+  if (idx == -1) {return;}
+  ts->v[idx] = rollup_combine(rts->cf, ts->v[idx], v);
+}
+
+
+/* Returns true when every coarser bucket containing ns still has all of its
+   finer rows, so a late update to the finest row can be propagated exactly. */
+static bool rollup_repairable(sa_rollup_time_series_int *rts, uint64_t ns)
+{
+  for (int l = 1; l < rts->levels; ++l) {
+    sa_time_series_int *fts = rts->level[l - 1];
+    uint64_t span = fts->ns_per_row * (fts->rows - 1);
+    uint64_t start = ns - ns % rts->level[l]->ns_per_row;
+    if (fts->current_time > span && start < fts->current_time - span) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* Recomputes the bucket of level l containing ns from the completed rows of
+   level l - 1. */
+static int rollup_bucket(sa_rollup_time_series_int *rts, int l, uint64_t ns)
+{
+  sa_time_series_int *fts = rts->level[l - 1];
+  uint64_t t = ns - ns % rts->level[l]->ns_per_row;
+  uint64_t end = t + rts->level[l]->ns_per_row;
+  int v = 0;
+  for (; t < end && t < fts->current_time; t += fts->ns_per_row) {
+    v = rollup_combine(rts->cf, v,
+                       fts->v[TS_RING_INDEX(fts, t / fts->ns_per_row)]);
+  }
+  return v;
+}
+
+
+/* Propagates a late update of a completed row of level l - 1 by recomputing
+   the containing buckets, a min/max cannot be patched by combining alone. */
+static void rollup_update(sa_rollup_time_series_int *rts, int l, uint64_t ns)
+{
+  for (; l < rts->levels; ++l) {
+    sa_time_series_int *ts = rts->level[l];
+    int v = rollup_bucket(rts, l, ns);
+    if (ns >= ts->current_time && ns - ts->current_time >= ts->ns_per_row) {
+      rollup_fold(rts, l, ns, v); // the finer rows were empty until now
+      return;
+    }
+    int idx = find_index_int(ts, ns, false);
+    if (idx == -1 || ts->v[idx] == v) {return;}
+    ts->v[idx] = v;
+    if (idx == ts->current_idx) {return;} // folded when the row completes
+  }
+}
+
+
+sa_rollup_time_series_int*
+sa_create_rollup_time_series_int(int levels,
+                                 const int *rows,
+                                 const uint64_t *ns_per_row,
+                                 sa_rollup_cf cf)
+{
+  if (levels < 1 || levels > SA_ROLLUP_MAX_LEVELS || !rows || !ns_per_row
+      || cf < SA_ROLLUP_SUM || cf > SA_ROLLUP_AVG) {
+    return NULL;
+  }
+
+  size_t len = TS_ALIGN(sizeof(sa_rollup_time_series_int));
+  for (int l = 0; l < levels; ++l) {
+    if (rows[l] < 2 || ns_per_row[l] < 1) {return NULL;}
+    if (l > 0 && (ns_per_row[l] <= ns_per_row[l - 1]
+                  || ns_per_row[l] % ns_per_row[l - 1])) {
+      return NULL;
+    }
+    len += TIME_SERIES_INT_SIZE(rows[l], 0, 0);
+  }
+
+  sa_rollup_time_series_int *rts = malloc(len);
+  if (!rts) {return NULL;}
+
+  rts->levels = levels;
+  rts->cf = cf;
+  sa_time_series_int *ts = ROLLUP_FIRST_LEVEL_INT(rts);
+  for (int l = 0; l < levels; ++l) {
+    ts->ns_per_row = ns_per_row[l];
+    ts->rows = rows[l];
+    ts->window = 0;
+    ts->index = 0;
+    ts = ROLLUP_NEXT_LEVEL_INT(ts);
+  }
+  sa_init_rollup_time_series_int(rts);
+  return rts;
+}
+
+
+void sa_init_rollup_time_series_int(sa_rollup_time_series_int *rts)
+{
+  assert(rts);
+  sa_time_series_int *ts = ROLLUP_FIRST_LEVEL_INT(rts);
+  for (int l = 0; l < rts->levels; ++l) {
+    rts->level[l] = ts;
+    sa_init_time_series_int(ts);
+    ts = ROLLUP_NEXT_LEVEL_INT(ts);
+  }
+}
+
+
+int sa_add_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                  uint64_t ns,
+                                  int v)
+{
+  assert(rts);
+  sa_time_series_int *ts = rts->level[0];
+  bool fold = rts->cf == SA_ROLLUP_MIN || rts->cf == SA_ROLLUP_MAX;
+  if (fold && ns >= ts->current_time
+      && ns - ts->current_time >= ts->ns_per_row) {
+    rollup_close(rts, 0);
+  } else if (fold && ns < ts->current_time && !rollup_repairable(rts, ns)) {
+    return INT_MIN;
+  }
+  int idx = find_index_int(ts, ns, true);
+  if (idx == -1) {return INT_MIN;}
+  add_row_int(ts, idx, v);
+
+  if (!fold) {
+    for (int l = 1; l < rts->levels; ++l) {
+      sa_add_time_series_int(rts->level[l], ns, v);
+    }
+  } else if (idx != ts->current_idx && rts->levels > 1) {
+    rollup_update(rts, 1, ns);
+  }
+  return ts->v[idx];
+}
+
+
+double sa_get_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                     int level,
+                                     uint64_t ns)
+{
+  assert(rts);
+  if (level < 0 || level >= rts->levels) {return NAN;}
+  sa_time_series_int *ts0 = rts->level[0];
+  if (ns >= ts0->current_time && ns - ts0->current_time >= ts0->ns_per_row) {
+    return NAN;
+  }
+
+  sa_time_series_int *ts = rts->level[level];
+  int v = 0; // a min/max level that has not advanced to ns yet is empty
+  if (ns < ts->current_time || ns - ts->current_time < ts->ns_per_row) {
+    int idx = find_index_int(ts, ns, false);
+    if (idx == -1) {return NAN;}
+    v = ts->v[idx];
+  }
+
+  switch (rts->cf) {
+  case SA_ROLLUP_SUM:
+    return v;
+  case SA_ROLLUP_AVG:
+    return (double)v * ts0->ns_per_row / ts->ns_per_row;
+  default:
+    break;
+  }
+
+  // combine the rows of the finer levels that have not been folded in yet
+  uint64_t bucket = ns - ns % ts->ns_per_row;
+  for (int l = level - 1; l >= 0; --l) {
+    sa_time_series_int *fts = rts->level[l];
+    if (fts->current_time - fts->current_time % ts->ns_per_row == bucket) {
+      v = rollup_combine(rts->cf, v, fts->v[fts->current_idx]);
+    }
+  }
+  return v;
+}
+
+
+uint64_t sa_timestamp_rollup_time_series_int(sa_rollup_time_series_int *rts)
+{
+  assert(rts);
+  return rts->level[0]->current_time;
+}
+
+
+void sa_destroy_rollup_time_series_int(sa_rollup_time_series_int *rts)
+{
+  free(rts);
+}
+
+
+static size_t rollup_time_series_int_size(sa_rollup_time_series_int *rts)
+{
+  size_t len = sizeof(int) * 2;
+  for (int l = 0; l < rts->levels; ++l) {
+    len += time_series_int_size(rts->level[l]);
+  }
+  return len;
+}
+
+
+char* sa_serialize_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                          size_t *len)
+{
+  assert(rts && len);
+
+  *len = rollup_time_series_int_size(rts);
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+
+  char *cp = buf;
+  n2b(&rts->levels, cp, sizeof(int));
+  cp += sizeof(int);
+
+  int cf = rts->cf;
+  n2b(&cf, cp, sizeof(int));
+  cp += sizeof(int);
+
+  for (int l = 0; l < rts->levels; ++l) {
+    serialize_int(rts->level[l], cp);
+    cp += time_series_int_size(rts->level[l]);
+  }
+  return buf;
+}
+
+
+int sa_deserialize_rollup_time_series_int(sa_rollup_time_series_int *rts,
+                                          const char *buf,
+                                          size_t len)
+{
+  assert(rts && buf);
+
+  if (len != rollup_time_series_int_size(rts)) {
+    sa_init_rollup_time_series_int(rts);
+    return 1;
+  }
+
+  const char *cp = buf;
+  int levels, cf;
+  b2n(cp, &levels, sizeof(int));
+  cp += sizeof(int);
+  b2n(cp, &cf, sizeof(int));
+  cp += sizeof(int);
+  if (levels != rts->levels || cf != (int)rts->cf) {
+    sa_init_rollup_time_series_int(rts);
+    return 3;
+  }
 
+  for (int l = 0; l < rts->levels; ++l) {
+    size_t llen = time_series_int_size(rts->level[l]);
+    int rv = sa_deserialize_time_series_int(rts->level[l], cp, llen);
+    if (rv) {
+      sa_init_rollup_time_series_int(rts);
+      return rv;
+    }
+    cp += llen;
+  }
   return 0;
 }
+
+
+static int64_t add_int64(int64_t a, int64_t b)
+{
+  if (b > 0 && a > INT64_MAX - b) {return INT64_MAX;}
+  if (b < 0 && a < INT64_MIN - b) {return INT64_MIN;}
+  return a + b;
+}
+
+#define TS_SUFFIX int64
+#define TS_TYPE int64_t
+#define TS_TAG 1
+#define TS_INVALID INT64_MIN
+#define TS_ADD(a, b) add_int64(a, b)
+#include "time_series_tmpl.h"
+
+#define TS_SUFFIX flt
+#define TS_TYPE float
+#define TS_TAG 2
+#define TS_INVALID NAN
+#define TS_ADD(a, b) ((a) + (b))
+#include "time_series_tmpl.h"
+
+#define TS_SUFFIX dbl
+#define TS_TYPE double
+#define TS_TAG 3
+#define TS_INVALID NAN
+#define TS_ADD(a, b) ((a) + (b))
+#include "time_series_tmpl.h"
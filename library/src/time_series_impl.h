@@ -9,13 +9,109 @@
 #ifndef sa_time_series_impl_h_
 #define sa_time_series_impl_h_
 
+#include "common.h"
 #include "time_series.h"
 
 struct sa_time_series_int {
   uint64_t current_time;
   uint64_t ns_per_row;
+  uint64_t current_row; // current_time / ns_per_row
+  int current_idx; // ring index of the current row
+  int mask; // rows - 1 when rows is a power of two, otherwise 0
   int rows;
+  int window; // number of trailing rows aggregated (0 = disabled)
+  int index; // non zero when the range summary index is maintained
   int v[];
 };
 
+#define TIME_SERIES_STRUCT(suffix, type) \
+struct sa_time_series_##suffix { \
+  uint64_t current_time; \
+  uint64_t ns_per_row; \
+  uint64_t current_row; \
+  int current_idx; \
+  int mask; \
+  int rows; \
+  type v[]; \
+}
+
+TIME_SERIES_STRUCT(int64, int64_t);
+TIME_SERIES_STRUCT(flt, float);
+TIME_SERIES_STRUCT(dbl, double);
+
+#define TS_RING_INDEX(ts, row) ((ts)->mask ? (int)((row) & (ts)->mask) \
+                                : (int)((row) % (ts)->rows))
+
+/* Trailing window aggregate, stored after the row values (8 byte aligned)
+   when a window is configured. The deques hold the (truncated) absolute row
+   numbers of the completed rows in the window; the current row is always
+   checked directly since it is still being updated. */
+typedef struct ts_window_int {
+  int64_t sum;
+  exact_sumsq sumsq;
+  int dirty; // a completed row was modified, the deques must be rebuilt
+  int min_head;
+  int min_len;
+  int max_head;
+  int max_len;
+  uint32_t dq[]; // min deque [window] followed by the max deque [window]
+} ts_window_int;
+
+#define TS_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+#define TS_WINDOW_SIZE(window) ((window) ? \
+  TS_ALIGN(sizeof(ts_window_int) + sizeof(uint32_t) * 2 * (window)) : 0)
+
+#define TS_WINDOW_INT(ts) ((ts_window_int *)((char *)(ts) + \
+  TS_ALIGN(sizeof(sa_time_series_int) + sizeof(int) * (ts)->rows)))
+
+/* The index is an iterative segment tree over the ring positions; the leaves
+   are stored at [rows, 2 * rows) and node 0 is unused. */
+#define TS_INDEX_INT(ts) ((sa_range_stats_int *)((char *)TS_WINDOW_INT(ts) + \
+                          TS_WINDOW_SIZE((ts)->window)))
+
+#define TIME_SERIES_INT_SIZE(rows, window, index) \
+  (TS_ALIGN(sizeof(sa_time_series_int) + sizeof(int) * (rows)) + \
+   TS_WINDOW_SIZE(window) + \
+   ((index) ? sizeof(sa_range_stats_int) * 2 * (rows) : 0))
+
+/* The rollup levels are plain time series stored back to back after the
+   struct, finest first; init sets up the level pointers from the configured
+   rows/ns_per_row of each level header. */
+struct sa_rollup_time_series_int {
+  int levels;
+  sa_rollup_cf cf;
+  sa_time_series_int *level[SA_ROLLUP_MAX_LEVELS];
+};
+
+#define ROLLUP_FIRST_LEVEL_INT(rts) ((sa_time_series_int *)((char *)(rts) + \
+  TS_ALIGN(sizeof(sa_rollup_time_series_int))))
+
+#define ROLLUP_NEXT_LEVEL_INT(ts) ((sa_time_series_int *)((char *)(ts) + \
+  TIME_SERIES_INT_SIZE((ts)->rows, 0, 0)))
+
+/* The incremental profile keeps rings of len = n - m + 1 entries indexed by
+   the absolute start row of each sub-sequence: mean, inverse standard
+   deviation, profile value, two rows of dot products (the most recent
+   sub-sequence against the window, alternating between updates) and the
+   absolute start row of each nearest neighbor. */
+struct sa_mp_stream_int {
+  sa_time_series_int *ts;
+  uint64_t last; // start row of the most recent sub-sequence
+  int n;
+  int m;
+  int len;
+  int count; // number of sub-sequences in the window (0 = empty)
+  int qt; // index of the current dot product row
+  double v[];
+};
+
+#define MP_STREAM_MU(mps) ((mps)->v)
+#define MP_STREAM_ISD(mps) ((mps)->v + (mps)->len)
+#define MP_STREAM_MP(mps) ((mps)->v + 2 * (mps)->len)
+#define MP_STREAM_QT(mps, i) ((mps)->v + (3 + (i)) * (mps)->len)
+#define MP_STREAM_MPI(mps) ((uint64_t *)((mps)->v + 5 * (mps)->len))
+#define MP_STREAM_INT_SIZE(n, m) (sizeof(sa_mp_stream_int) + \
+  (sizeof(double) * 5 + sizeof(uint64_t)) * ((n) - (m) + 1))
+
 #endif
@@ -0,0 +1,218 @@
+/* -*- Mode: C; tab_width: 8; indent_tabs_mode: nil; c_basic_offset: 2 -*- */
+/* vim: set ts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/** Typed time series implementation template. Included once per value type
+ *  with the following macros defined (they are undefined at the end):
+ *  - TS_SUFFIX     type suffix e.g. int64
+ *  - TS_TYPE       value type
+ *  - TS_TAG        serialization type tag
+ *  - TS_INVALID    value returned when the timestamp is out of range
+ *  - TS_ADD(a, b)  addition (saturating for the integer types)
+ *  @file */
+
+#define TS_CAT_(a, b) a ## _ ## b
+#define TS_CAT(a, b) TS_CAT_(a, b)
+#define TS_NAME(name) TS_CAT(name, TS_SUFFIX)
+#define TS_T TS_NAME(sa_time_series)
+
+static void TS_NAME(advance)(TS_T *ts, uint64_t row_delta)
+{
+  int oidx = ts->current_idx + 1;
+  if (oidx == ts->rows) {oidx = 0;}
+  if (row_delta >= (uint64_t)ts->rows) {
+    memset(ts->v, 0, sizeof(TS_TYPE) * ts->rows);
+    ts->current_idx = TS_RING_INDEX(ts, ts->current_row + row_delta);
+  } else {
+    int delta = (int)row_delta;
+    if (oidx + delta <= ts->rows) {
+      memset(ts->v + oidx, 0, sizeof(TS_TYPE) * delta);
+    } else {
+      memset(ts->v + oidx, 0, sizeof(TS_TYPE) * (ts->rows - oidx));
+      memset(ts->v, 0, sizeof(TS_TYPE) * (oidx + delta - ts->rows));
+    }
+    ts->current_idx += delta;
+    if (ts->current_idx >= ts->rows) {ts->current_idx -= ts->rows;}
+  }
+  ts->current_row += row_delta;
+  ts->current_time = ts->current_row * ts->ns_per_row;
+}
+
+
+static int TS_NAME(find_index)(TS_T *ts, uint64_t ns, bool advance)
+{
+  if (ns >= ts->current_time) {
+    uint64_t offset = ns - ts->current_time;
+    if (offset < ts->ns_per_row) {return ts->current_idx;}
+    if (!advance) {return -1;}
+    offset -= ts->ns_per_row;
+    TS_NAME(advance)(ts, offset < ts->ns_per_row ? 1
+                     : offset / ts->ns_per_row + 1);
+    return ts->current_idx;
+  }
+
+  uint64_t row_delta = ts->current_row - ns / ts->ns_per_row;
+  if (row_delta >= (uint64_t)ts->rows) {return -1;}
+  int idx = ts->current_idx - (int)row_delta;
+  if (idx < 0) {idx += ts->rows;}
+  return idx;
+}
+
+
+TS_T* TS_NAME(sa_create_time_series)(int rows, uint64_t ns_per_row)
+{
+  if (rows < 2 || ns_per_row < 1) {return NULL;}
+
+  TS_T *ts = malloc(sizeof(*ts) + sizeof(TS_TYPE) * rows);
+  if (!ts) {return NULL;}
+
+  ts->ns_per_row = ns_per_row;
+  ts->rows = rows;
+  TS_NAME(sa_init_time_series)(ts);
+  return ts;
+}
+
+
+void TS_NAME(sa_destroy_time_series)(TS_T *ts)
+{
+  free(ts);
+}
+
+
+void TS_NAME(sa_init_time_series)(TS_T *ts)
+{
+  assert(ts);
+  ts->mask = (ts->rows & (ts->rows - 1)) == 0 ? ts->rows - 1 : 0;
+  ts->current_row = ts->rows - 1;
+  ts->current_idx = ts->rows - 1;
+  ts->current_time = ts->ns_per_row * ts->current_row;
+  memset(ts->v, 0, sizeof(TS_TYPE) * ts->rows);
+}
+
+
+TS_TYPE TS_NAME(sa_add_time_series)(TS_T *ts, uint64_t ns, TS_TYPE v)
+{
+  assert(ts);
+  int idx = TS_NAME(find_index)(ts, ns, true);
+  if (idx == -1) {return TS_INVALID;}
+  ts->v[idx] = TS_ADD(ts->v[idx], v);
+  return ts->v[idx];
+}
+
+
+TS_TYPE TS_NAME(sa_set_time_series)(TS_T *ts, uint64_t ns, TS_TYPE v)
+{
+  assert(ts);
+  int idx = TS_NAME(find_index)(ts, ns, true);
+  if (idx == -1) {return TS_INVALID;}
+  ts->v[idx] = v;
+  return v;
+}
+
+
+TS_TYPE TS_NAME(sa_get_time_series)(TS_T *ts, uint64_t ns)
+{
+  assert(ts);
+  int idx = TS_NAME(find_index)(ts, ns, false);
+  if (idx == -1) {return TS_INVALID;}
+  return ts->v[idx];
+}
+
+
+uint64_t TS_NAME(sa_timestamp_time_series)(TS_T *ts)
+{
+  assert(ts);
+  return ts->current_time;
+}
+
+
+static size_t TS_NAME(time_series_size)(TS_T *ts)
+{
+  return sizeof(uint64_t) * 2 + sizeof(int) * 2 + sizeof(TS_TYPE) * ts->rows;
+}
+
+
+char* TS_NAME(sa_serialize_time_series)(TS_T *ts, size_t *len)
+{
+  assert(ts && len);
+
+  *len = TS_NAME(time_series_size)(ts);
+  char *buf = malloc(*len);
+  if (!buf) {
+    *len = 0;
+    return NULL;
+  }
+
+  char *cp = buf;
+  n2b(&ts->current_time, cp, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  n2b(&ts->ns_per_row, cp, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  n2b(&ts->rows, cp, sizeof(int));
+  cp += sizeof(int);
+
+  int tag = TS_TAG;
+  n2b(&tag, cp, sizeof(int));
+  cp += sizeof(int);
+
+  for (int i = 0; i < ts->rows; ++i, cp += sizeof(TS_TYPE)) {
+    n2b(ts->v + i, cp, sizeof(TS_TYPE));
+  }
+  return buf;
+}
+
+
+int TS_NAME(sa_deserialize_time_series)(TS_T *ts, const char *buf, size_t len)
+{
+  assert(ts && buf);
+
+  size_t elen = TS_NAME(time_series_size)(ts);
+  if (len != elen) {
+    TS_NAME(sa_init_time_series)(ts);
+    return 1;
+  }
+
+  const char *cp = buf;
+  b2n(cp, &ts->current_time, sizeof(uint64_t));
+  cp += sizeof(uint64_t);
+
+  uint64_t ns_per_row;
+  b2n(cp, &ns_per_row, sizeof(uint64_t));
+  if (ns_per_row != ts->ns_per_row) {
+    TS_NAME(sa_init_time_series)(ts);
+    return 2;
+  }
+  cp += sizeof(uint64_t);
+
+  int rows, tag;
+  b2n(cp, &rows, sizeof(int));
+  cp += sizeof(int);
+  b2n(cp, &tag, sizeof(int));
+  cp += sizeof(int);
+  if (rows != ts->rows || tag != TS_TAG) {
+    TS_NAME(sa_init_time_series)(ts);
+    return 3;
+  }
+
+  for (int i = 0; i < rows; ++i, cp += sizeof(TS_TYPE)) {
+    b2n(cp, ts->v + i, sizeof(TS_TYPE));
+  }
+  ts->current_row = ts->current_time / ts->ns_per_row;
+  ts->current_time = ts->current_row * ts->ns_per_row;
+  ts->current_idx = TS_RING_INDEX(ts, ts->current_row);
+  return 0;
+}
+
+#undef TS_T
+#undef TS_NAME
+#undef TS_CAT
+#undef TS_CAT_
+#undef TS_SUFFIX
+#undef TS_TYPE
+#undef TS_TAG
+#undef TS_INVALID
+#undef TS_ADD
@@ -128,12 +128,250 @@ static char* test_serialize_matrix_int()
 }
 
 
+/* Two pass reference: the coefficient of every other row, NaN counts as zero */
+static int reference_pcc(const double *v, int rows, int cols, int row,
+                         sa_pcc_match match, double *pcc)
+{
+  double mean[rows], sd[rows];
+  for (int r = 0; r < rows; ++r) {
+    double sum = 0, ss = 0;
+    for (int c = 0; c < cols; ++c) {
+      sum += isnan(v[r * cols + c]) ? 0 : v[r * cols + c];
+    }
+    mean[r] = sum / cols;
+    for (int c = 0; c < cols; ++c) {
+      double x = isnan(v[r * cols + c]) ? 0 : v[r * cols + c];
+      ss += (x - mean[r]) * (x - mean[r]);
+    }
+    sd[r] = sqrt(ss);
+  }
+  if (sd[row] == 0) {return -1;}
+
+  int idx = -1;
+  for (int r = 0; r < rows; ++r) {
+    if (r == row || sd[r] == 0) {continue;}
+    double d = 0;
+    for (int c = 0; c < cols; ++c) {
+      double a = isnan(v[row * cols + c]) ? 0 : v[row * cols + c];
+      double b = isnan(v[r * cols + c]) ? 0 : v[r * cols + c];
+      d += (a - mean[row]) * (b - mean[r]);
+    }
+    d /= sd[row] * sd[r];
+    if (idx == -1 || (match == SA_PCC_MIN ? d < *pcc : d > *pcc)) {
+      *pcc = d;
+      idx = r;
+    }
+  }
+  return idx;
+}
+
+
+static char* test_pcc_matrix_int()
+{
+  const int data[4][4] = {
+    { 1, 2, 5, 10 },
+    { 0, 1, 2, 3 },
+    { -1, 0, 7, 26 },
+    { 1, 2, 3, 4 }
+  };
+  sa_matrix_int *m = sa_create_matrix_int(4, 4);
+  mu_assert(m, "creation failed");
+  double pcc = 0;
+  mu_assert_rv(-1, sa_pcc_matrix_int(m, 3, SA_PCC_MAX, &pcc));
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      sa_add_matrix_int(m, r, c, data[r][c]);
+    }
+  }
+  mu_assert_rv(1, sa_pcc_matrix_int(m, 3, SA_PCC_MAX, &pcc));
+  mu_assert(fabs(1 - pcc) < 1e-9, "received %g", pcc);
+  mu_assert_rv(2, sa_pcc_matrix_int(m, 3, SA_PCC_MIN, &pcc));
+  mu_assert(fabs(0.90765069670774 - pcc) < 1e-9, "received %g", pcc);
+  sa_init_matrix_row_int(m, 1);
+  mu_assert_rv(0, sa_pcc_matrix_int(m, 3, SA_PCC_MAX, &pcc));
+  mu_assert(fabs(0.95831484749991 - pcc) < 1e-9, "received %g", pcc);
+  mu_assert_rv(-1, sa_pcc_matrix_int(m, 1, SA_PCC_MAX, &pcc)); // constant
+  mu_assert_rv(-1, sa_pcc_matrix_int(m, 4, SA_PCC_MAX, &pcc));
+  mu_assert_rv(-1, sa_pcc_matrix_int(m, -1, SA_PCC_MAX, &pcc));
+  sa_destroy_matrix_int(m);
+
+  // the maintained statistics track every kind of update
+  enum { rows = 8, cols = 32 };
+  double v[rows * cols] = { 0 };
+  m = sa_create_matrix_int(rows, cols);
+  mu_assert(m, "creation failed");
+  srand(5);
+  for (int i = 0; i < 5000; ++i) {
+    int r = rand() % rows, c = rand() % cols;
+    switch (rand() % 8) {
+    case 0:
+      sa_set_matrix_int(m, r, c, rand() % 1000 - 500);
+      break;
+    case 1:
+      if (i % 50 == 0) {sa_init_matrix_row_int(m, r);}
+      break;
+    default:
+      sa_add_matrix_int(m, r, c, rand() % 100 - 50);
+      break;
+    }
+  }
+  sa_add_matrix_int(m, 0, 0, INT_MAX); // saturates
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      v[r * cols + c] = sa_get_matrix_int(m, r, c);
+    }
+  }
+
+  size_t len;
+  char *buf = sa_serialize_matrix_int(m, &len);
+  mu_assert(buf, "serialize failed");
+  sa_matrix_int *m1 = sa_create_matrix_int(rows, cols);
+  mu_assert(m1, "creation failed");
+  mu_assert_rv(0, sa_deserialize_matrix_int(m1, buf, len));
+  free(buf);
+  for (int r = 0; r < rows; ++r) {
+    for (int match = SA_PCC_MAX; match <= SA_PCC_MIN; ++match) {
+      double e = 0, rv = 0, rv1 = 0;
+      int eidx = reference_pcc(v, rows, cols, r, match, &e);
+      mu_assert_rv(eidx, sa_pcc_matrix_int(m, r, match, &rv));
+      mu_assert_rv(eidx, sa_pcc_matrix_int(m1, r, match, &rv1));
+      mu_assert(fabs(e - rv) < 1e-9 && fabs(e - rv1) < 1e-9,
+                "row: %d expected %g received %g/%g", r, e, rv, rv1);
+    }
+  }
+  sa_destroy_matrix_int(m1);
+  sa_destroy_matrix_int(m);
+
+  // a transient large value does not leave any error in the row sums
+  const double tv[2 * 4] = { 1, 2, 3, 4, 4, 3, 2, 1 };
+  m = sa_create_matrix_int(2, 4);
+  mu_assert(m, "creation failed");
+  for (int i = 0; i < 8; ++i) {
+    sa_set_matrix_int(m, i / 4, i % 4, tv[i]);
+  }
+  sa_set_matrix_int(m, 0, 0, 2000000000);
+  sa_set_matrix_int(m, 0, 0, INT_MIN);
+  sa_add_matrix_int(m, 1, 3, INT_MAX);
+  sa_set_matrix_int(m, 0, 0, 1);
+  sa_set_matrix_int(m, 1, 3, 1);
+  for (int r = 0; r < 2; ++r) {
+    double e = 0, rv = 0;
+    mu_assert_rv(reference_pcc(tv, 2, 4, r, SA_PCC_MAX, &e),
+                 sa_pcc_matrix_int(m, r, SA_PCC_MAX, &rv));
+    mu_assert(fabs(e - rv) < 1e-9, "row: %d expected %g received %g", r, e,
+              rv);
+  }
+  sa_destroy_matrix_int(m);
+  return NULL;
+}
+
+
+static char* test_pcc_matrix_flt()
+{
+  const float data[4][4] = {
+    { 1, 2, 5, 10 },
+    { NAN, 1, 2, 3 },
+    { -1, NAN, 7, 26 },
+    { 1, 2, 3, 4 }
+  };
+  sa_matrix_flt *m = sa_create_matrix_flt(4, 4);
+  mu_assert(m, "creation failed");
+  double pcc = 0;
+  mu_assert_rv(-1, sa_pcc_matrix_flt(m, 3, SA_PCC_MAX, &pcc));
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      sa_add_matrix_flt(m, r, c, data[r][c]);
+    }
+  }
+  mu_assert_rv(1, sa_pcc_matrix_flt(m, 3, SA_PCC_MAX, &pcc));
+  mu_assert(fabs(1 - pcc) < 1e-9, "received %g", pcc);
+  mu_assert_rv(2, sa_pcc_matrix_flt(m, 3, SA_PCC_MIN, &pcc));
+  mu_assert(fabs(0.90765069670774 - pcc) < 1e-9, "received %g", pcc);
+  sa_init_matrix_row_flt(m, 1);
+  mu_assert_rv(0, sa_pcc_matrix_flt(m, 3, SA_PCC_MAX, &pcc));
+  mu_assert(fabs(0.95831484749991 - pcc) < 1e-9, "received %g", pcc);
+  mu_assert_rv(-1, sa_pcc_matrix_flt(m, 1, SA_PCC_MAX, &pcc)); // all NaN
+
+  // set to and from NaN
+  sa_set_matrix_flt(m, 0, 0, NAN);
+  sa_set_matrix_flt(m, 2, 1, 4.5f);
+  sa_add_matrix_flt(m, 0, 0, 1.5f);
+  sa_add_matrix_flt(m, 2, 3, NAN);
+  double v[16];
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      v[r * 4 + c] = sa_get_matrix_flt(m, r, c);
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    for (int match = SA_PCC_MAX; match <= SA_PCC_MIN; ++match) {
+      double e = 0, rv = 0;
+      int eidx = reference_pcc(v, 4, 4, r, match, &e);
+      mu_assert_rv(eidx, sa_pcc_matrix_flt(m, r, match, &rv));
+      mu_assert(fabs(e - rv) < 1e-9, "row: %d expected %g received %g", r, e,
+                rv);
+    }
+  }
+  sa_destroy_matrix_flt(m);
+
+  const double tv[2 * 4] = { 1, 2, 3, 4, 4, 3, 2, 1 };
+  m = sa_create_matrix_flt(2, 4);
+  mu_assert(m, "creation failed");
+  for (int i = 0; i < 8; ++i) {
+    sa_set_matrix_flt(m, i / 4, i % 4, tv[i]);
+  }
+  sa_set_matrix_flt(m, 0, 0, 1e30f);
+  mu_assert_rv(1, sa_pcc_matrix_flt(m, 0, SA_PCC_MAX, &pcc));
+  sa_add_matrix_flt(m, 1, 3, -3e20f);
+  sa_set_matrix_flt(m, 0, 0, 1);
+  sa_set_matrix_flt(m, 1, 3, 1);
+  for (int r = 0; r < 2; ++r) {
+    double e = 0, rv = 0;
+    mu_assert_rv(reference_pcc(tv, 2, 4, r, SA_PCC_MAX, &e),
+                 sa_pcc_matrix_flt(m, r, SA_PCC_MAX, &rv));
+    mu_assert(fabs(e - rv) < 1e-9, "row: %d expected %g received %g", r, e,
+              rv);
+  }
+  sa_destroy_matrix_flt(m);
+  return NULL;
+}
+
+
+static char* benchmark_pcc_matrix_int()
+{
+  int rows = 168, cols = 1440, iter = 100;
+  sa_matrix_int *m = sa_create_matrix_int(rows, cols);
+  mu_assert(m, "creation failed");
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      sa_set_matrix_int(m, r, c, rand() % 1000);
+    }
+  }
+
+  double pcc;
+  clock_t t = clock();
+  for (int i = 0; i < iter; ++i) {
+    mu_assert(sa_pcc_matrix_int(m, i % rows, SA_PCC_MAX, &pcc) != -1,
+              "no match");
+  }
+  t = clock() - t;
+  sa_destroy_matrix_int(m);
+  printf("benchmark pcc_matrix_int: %g\n", ((double)t) / CLOCKS_PER_SEC
+         / iter);
+  return NULL;
+}
+
+
 static char* all_tests()
 {
   mu_run_test(test_stub);
   mu_run_test(test_create_matrix_int);
   mu_run_test(test_matrix_int);
   mu_run_test(test_serialize_matrix_int);
+  mu_run_test(test_pcc_matrix_int);
+  mu_run_test(test_pcc_matrix_flt);
+
+  mu_run_test(benchmark_pcc_matrix_int);
   return NULL;
 }
 
@@ -107,6 +107,61 @@ static char* test_calculation_quantile()
 }
 
 
+static char* test_warmup_sort_quantile()
+{
+  sa_p2_quantile *p2q = sa_create_p2_quantile(0.5);
+  mu_assert(p2q, "creation failed");
+
+  // every permutation of five distinct values
+  for (int a = 0; a < 5; ++a) {
+    for (int b = 0; b < 5; ++b) {
+      if (b == a) continue;
+      for (int c = 0; c < 5; ++c) {
+        if (c == a || c == b) continue;
+        for (int d = 0; d < 5; ++d) {
+          if (d == a || d == b || d == c) continue;
+          int e = 10 - a - b - c - d;
+          sa_init_p2_quantile(p2q);
+          sa_add_p2_quantile(p2q, a);
+          sa_add_p2_quantile(p2q, b);
+          sa_add_p2_quantile(p2q, c);
+          sa_add_p2_quantile(p2q, d);
+          sa_add_p2_quantile(p2q, e);
+          for (unsigned short i = 0; i < 5; ++i) {
+            double rv = sa_estimate_p2_quantile(p2q, i);
+            mu_assert(rv == i, "%d%d%d%d%d marker: %hu received: %g", a, b, c,
+                      d, e, i, rv);
+          }
+        }
+      }
+    }
+  }
+  sa_destroy_p2_quantile(p2q);
+  return NULL;
+}
+
+
+static char* test_warmup_sort_histogram()
+{
+  unsigned short buckets[] = { 4, 10, 100 };
+  for (size_t i = 0; i < sizeof(buckets) / sizeof(buckets[0]); ++i) {
+    unsigned short b = buckets[i];
+    sa_p2_histogram *p2h = sa_create_p2_histogram(b);
+    mu_assert(p2h, "creation failed");
+    for (unsigned short x = 0; x <= b; ++x) {
+      sa_add_p2_histogram(p2h, (x * 7) % (b + 1)); // b + 1 is never a
+                                                   // multiple of 7 here
+    }
+    for (unsigned short m = 0; m <= b; ++m) {
+      double rv = sa_estimate_p2_histogram(p2h, m);
+      mu_assert(rv == m, "buckets: %hu marker: %hu received: %g", b, m, rv);
+    }
+    sa_destroy_p2_histogram(p2h);
+  }
+  return NULL;
+}
+
+
 static char* test_serialize_quantile()
 {
   sa_p2_quantile *q1 = sa_create_p2_quantile(0.3);
@@ -236,6 +291,201 @@ static char* test_serialize_histogram()
 }
 
 
+static char* test_calculation_histogram_flt()
+{
+  sa_p2_histogram_flt *p2h = sa_create_p2_histogram_flt(4);
+  mu_assert(p2h, "creation failed");
+  mu_assert(!sa_create_p2_histogram_flt(3), "creation success");
+  mu_assert(isnan(sa_estimate_p2_histogram_flt(p2h, 2)), "expected: NaN");
+  mu_assert(sa_count_p2_histogram_flt(p2h, 2) == 0, "expected 0");
+
+  for (size_t i = 0; i < sizeof(obs) / sizeof(double); ++i) {
+    sa_add_p2_histogram_flt(p2h, obs[i]);
+  }
+  mu_assert(isnan(sa_estimate_p2_histogram_flt(p2h, 5)), "expected: NaN");
+
+  double eq[] = { 0.02, 0.493895, median, 17.2039, 38.62 };
+  unsigned long long ec[] = { 1, 6, 10, 16, 20 };
+  for (unsigned short i = 0; i < 5; ++i) {
+    double rpq = sa_estimate_p2_histogram_flt(p2h, i);
+    mu_assert(fabs(rpq - eq[i]) < .0001, "marker: %hu received: %g expected: "
+              "%g", i, rpq, eq[i]);
+    unsigned long long rv = sa_count_p2_histogram_flt(p2h, i);
+    mu_assert(rv == ec[i], "marker: %hu received: %llu expected: %llu", i, rv,
+              ec[i]);
+  }
+  sa_destroy_p2_histogram_flt(p2h);
+
+  // tracks the double precision histogram on a longer stream
+  sa_p2_histogram *d = sa_create_p2_histogram(25);
+  sa_p2_histogram_flt *f = sa_create_p2_histogram_flt(25);
+  unsigned x = 12345;
+  for (int i = 0; i < 100000; ++i) {
+    x = x * 1103515245 + 12345;
+    double v = (x >> 8) % 10000 / 10.0;
+    sa_add_p2_histogram(d, v);
+    sa_add_p2_histogram_flt(f, v);
+  }
+  for (unsigned short i = 0; i <= 25; ++i) {
+    double ed = sa_estimate_p2_histogram(d, i);
+    double ef = sa_estimate_p2_histogram_flt(f, i);
+    mu_assert(fabs(ed - ef) < 1, "marker: %hu double: %g float: %g", i, ed, ef);
+    unsigned long long cd = sa_count_p2_histogram(d, i);
+    unsigned long long cf = sa_count_p2_histogram_flt(f, i);
+    mu_assert(cd == cf, "marker: %hu double: %llu float: %llu", i, cd, cf);
+  }
+  sa_destroy_p2_histogram(d);
+  sa_destroy_p2_histogram_flt(f);
+  return NULL;
+}
+
+
+static char* test_serialize_histogram_flt()
+{
+  sa_p2_histogram_flt *h1 = sa_create_p2_histogram_flt(4);
+  sa_p2_histogram_flt *h2 = sa_create_p2_histogram_flt(4);
+  for (size_t i = 0; i < sizeof(obs) / sizeof(double); ++i) {
+    sa_add_p2_histogram_flt(h1, obs[i]);
+  }
+  size_t len;
+  char *s1 = sa_serialize_p2_histogram_flt(h1, &len);
+  mu_assert(s1, "serialize failed");
+  mu_assert(len == 2 + 5 * 8, "received: %" PRIuSIZE, len);
+  mu_assert_rv(1, sa_deserialize_p2_histogram_flt(h2, s1, len - 1));
+  s1[0] = 6;
+  mu_assert_rv(2, sa_deserialize_p2_histogram_flt(h2, s1, len));
+  s1[0] = 0;
+  mu_assert_rv(0, sa_deserialize_p2_histogram_flt(h2, s1, len));
+  for (unsigned short i = 0; i < 5; ++i) {
+    double e = sa_estimate_p2_histogram_flt(h1, i);
+    double rv = sa_estimate_p2_histogram_flt(h2, i);
+    mu_assert(rv == e, "received: %g expected: %g", rv, e);
+    mu_assert(sa_count_p2_histogram_flt(h1, i)
+              == sa_count_p2_histogram_flt(h2, i), "count mismatch %hu", i);
+  }
+  free(s1);
+  sa_destroy_p2_histogram_flt(h1);
+  sa_destroy_p2_histogram_flt(h2);
+  return NULL;
+}
+
+
+static char* test_create_window()
+{
+  sa_p2_window *p2w = sa_create_p2_window(10, 1, 20);
+  mu_assert(p2w, "creation failed");
+  sa_destroy_p2_window(p2w);
+
+  p2w = sa_create_p2_window(1, 1, 20);
+  mu_assert(!p2w, "creation success");
+  p2w = sa_create_p2_window(10, 0, 20);
+  mu_assert(!p2w, "creation success");
+  p2w = sa_create_p2_window(10, 1, 3);
+  mu_assert(!p2w, "creation success");
+  return NULL;
+}
+
+
+static char* test_calculation_window()
+{
+  sa_p2_window *p2w = sa_create_p2_window(10, 1, 20);
+  mu_assert(p2w, "creation failed");
+  mu_assert(isnan(sa_estimate_p2_window(p2w, 0, 10, 0.5)), "expected: NaN");
+  mu_assert(sa_count_p2_window(p2w, 0, 10) == 0, "expected 0");
+
+  // warm-up rows are exact
+  mu_assert_rv(0, sa_add_p2_window(p2w, 9, 3));
+  mu_assert_rv(0, sa_add_p2_window(p2w, 9, 1));
+  mu_assert_rv(0, sa_add_p2_window(p2w, 9, 2));
+  double rv = sa_estimate_p2_window(p2w, 9, 1, 0.5);
+  mu_assert(rv == 2, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 9, 1, 1);
+  mu_assert(rv == 3, "received: %g", rv);
+
+  sa_init_p2_window(p2w);
+  for (int r = 0; r < 10; ++r) {
+    for (int k = 0; k < 100; ++k) {
+      mu_assert_rv(0, sa_add_p2_window(p2w, r, r * 100 + (k * 37) % 100));
+    }
+  }
+  unsigned long long count = sa_count_p2_window(p2w, 0, 10);
+  mu_assert(count == 1000, "received: %llu", count);
+  rv = sa_estimate_p2_window(p2w, 0, 10, 0.5);
+  mu_assert(fabs(rv - 499.5) < 10, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 0, 10, 0.99);
+  mu_assert(fabs(rv - 989) < 10, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 0, 10, 0);
+  mu_assert(rv == 0, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 0, 10, 1);
+  mu_assert(rv == 999, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 5, 5, 0.5);
+  mu_assert(fabs(rv - 749.5) < 10, "received: %g", rv);
+  rv = sa_estimate_p2_window(p2w, 5, 10, 0.5); // truncated at the current row
+  mu_assert(fabs(rv - 749.5) < 10, "received: %g", rv);
+  mu_assert(isnan(sa_estimate_p2_window(p2w, 0, 10, 1.1)), "expected: NaN");
+  mu_assert(isnan(sa_estimate_p2_window(p2w, 10, 1, 0.5)), "expected: NaN");
+  mu_assert(isnan(sa_estimate_p2_window(p2w, 0, 11, 0.5)), "expected: NaN");
+
+  // slide the window forward, the expired rows are cleared
+  mu_assert_rv(0, sa_add_p2_window(p2w, 14, 5000));
+  uint64_t ns = sa_timestamp_p2_window(p2w);
+  mu_assert(ns == 14, "received: %llu", (unsigned long long)ns);
+  mu_assert_rv(1, sa_add_p2_window(p2w, 4, 1));
+  count = sa_count_p2_window(p2w, 5, 10);
+  mu_assert(count == 501, "received: %llu", count);
+  rv = sa_estimate_p2_window(p2w, 10, 5, 0.5);
+  mu_assert(rv == 5000, "received: %g", rv);
+
+  // a jump past the entire window
+  mu_assert_rv(0, sa_add_p2_window(p2w, 100, 1));
+  count = sa_count_p2_window(p2w, 91, 10);
+  mu_assert(count == 1, "received: %llu", count);
+  sa_destroy_p2_window(p2w);
+  return NULL;
+}
+
+
+static char* test_serialize_window()
+{
+  sa_p2_window *w1 = sa_create_p2_window(4, 10, 8);
+  sa_p2_window *w2 = sa_create_p2_window(4, 10, 8);
+  sa_p2_window *w3 = sa_create_p2_window(4, 10, 10);
+  sa_p2_window *w4 = sa_create_p2_window(4, 20, 8);
+  sa_p2_window *w5 = sa_create_p2_window(3, 10, 25);
+  sa_p2_window *w6 = sa_create_p2_window(11, 10, 6);
+  for (size_t i = 0; i < sizeof(obs) / sizeof(double); ++i) {
+    sa_add_p2_window(w1, i * 2, obs[i]);
+  }
+  size_t len;
+  char *buf = sa_serialize_p2_window(w1, &len);
+  mu_assert(buf, "serialize failed");
+  mu_assert_rv(1, sa_deserialize_p2_window(w2, buf, len - 1));
+  mu_assert_rv(1, sa_deserialize_p2_window(w3, buf, len));
+  mu_assert_rv(3, sa_deserialize_p2_window(w4, buf, len)); // ns_per_row
+  mu_assert_rv(0, sa_deserialize_p2_window(w2, buf, len));
+  uint64_t ns = sa_timestamp_p2_window(w2);
+  mu_assert(ns == 30, "received: %llu", (unsigned long long)ns);
+  double e = sa_estimate_p2_window(w1, 0, 4, 0.5);
+  double rv = sa_estimate_p2_window(w2, 0, 4, 0.5);
+  mu_assert(rv == e, "received: %g expected: %g", rv, e);
+  free(buf);
+
+  // same serialized size with the rows and buckets exchanged
+  buf = sa_serialize_p2_window(w5, &len);
+  mu_assert(buf, "serialize failed");
+  mu_assert_rv(3, sa_deserialize_p2_window(w6, buf, len));
+  free(buf);
+
+  sa_destroy_p2_window(w1);
+  sa_destroy_p2_window(w2);
+  sa_destroy_p2_window(w3);
+  sa_destroy_p2_window(w4);
+  sa_destroy_p2_window(w5);
+  sa_destroy_p2_window(w6);
+  return NULL;
+}
+
+
 static char* benchmark_add_quantile()
 {
   double iter = 200000;
@@ -274,6 +524,85 @@ static char* benchmark_add_histogram()
 }
 
 
+static char* benchmark_add_histogram_flt()
+{
+  double iter = 200000;
+
+  sa_p2_histogram_flt *p2h = sa_create_p2_histogram_flt(10);
+  mu_assert(p2h, "creation failed");
+
+  clock_t t = clock();
+  for (double x = 0; x < iter; ++x) {
+    sa_add_p2_histogram_flt(p2h, x);
+  }
+  t = clock() - t;
+  sa_destroy_p2_histogram_flt(p2h);
+  printf("benchmark histogram flt: %g\n", ((double)t) / CLOCKS_PER_SEC
+         / iter);
+  return NULL;
+}
+
+
+static char* benchmark_per_key()
+{
+  int iter = 200000;
+
+  clock_t t = clock();
+  double sum = 0;
+  for (int i = 0; i < iter; ++i) {
+    sa_p2_quantile *p2q = sa_create_p2_quantile(0.95);
+    sa_p2_histogram *p2h = sa_create_p2_histogram(10);
+    for (int j = 0; j < 11; ++j) {
+      double x = obs[(i + j) % (sizeof(obs) / sizeof(double))];
+      sa_add_p2_quantile(p2q, x);
+      sa_add_p2_histogram(p2h, x);
+    }
+    sum += sa_estimate_p2_quantile(p2q, 2) + sa_estimate_p2_histogram(p2h, 5);
+    sa_destroy_p2_histogram(p2h);
+    sa_destroy_p2_quantile(p2q);
+  }
+  t = clock() - t;
+  mu_assert(sum > 0, "received: %g", sum);
+  printf("benchmark per key: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
+static char* benchmark_window()
+{
+  int iter = 1000000;
+  int rows = 300;
+
+  // 1000 observations per row so the range estimate merges every row
+  sa_p2_window *p2w = sa_create_p2_window(rows, 1000000ULL, 100);
+  mu_assert(p2w, "creation failed");
+
+  clock_t t = clock();
+  for (int i = 0; i < iter; ++i) {
+    sa_add_p2_window(p2w, i * 1000ULL, obs[i % (sizeof(obs) / sizeof(double))]);
+  }
+  t = clock() - t;
+  printf("benchmark window add: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+
+  uint64_t start = sa_timestamp_p2_window(p2w) - (rows - 1) * 1000000ULL;
+  unsigned long long count = sa_count_p2_window(p2w, start, rows);
+  mu_assert(count == rows * 1000ULL, "received: %llu", count);
+
+  int queries = 100;
+  t = clock();
+  double sum = 0;
+  for (int i = 0; i < queries; ++i) {
+    sum += sa_estimate_p2_window(p2w, start, rows, 0.99);
+  }
+  t = clock() - t;
+  mu_assert(sum > 0, "received: %g", sum);
+  printf("benchmark window estimate (%d rows): %g\n", rows,
+         ((double)t) / CLOCKS_PER_SEC / queries);
+  sa_destroy_p2_window(p2w);
+  return NULL;
+}
+
+
 static char* all_tests()
 {
   mu_run_test(test_stub);
@@ -281,11 +610,21 @@ static char* all_tests()
   mu_run_test(test_create_histogram);
   mu_run_test(test_calculation_quantile);
   mu_run_test(test_calculation_histogram);
+  mu_run_test(test_warmup_sort_quantile);
+  mu_run_test(test_warmup_sort_histogram);
   mu_run_test(test_serialize_quantile);
   mu_run_test(test_serialize_histogram);
+  mu_run_test(test_calculation_histogram_flt);
+  mu_run_test(test_serialize_histogram_flt);
+  mu_run_test(test_create_window);
+  mu_run_test(test_calculation_window);
+  mu_run_test(test_serialize_window);
 
   mu_run_test(benchmark_add_quantile);
   mu_run_test(benchmark_add_histogram);
+  mu_run_test(benchmark_add_histogram_flt);
+  mu_run_test(benchmark_per_key);
+  mu_run_test(benchmark_window);
   return NULL;
 }
 
@@ -8,6 +8,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "mu_test.h"
@@ -75,6 +76,279 @@ static char* test_nan_inf()
 }
 
 
+static char* test_add_array()
+{
+  double d[203];
+  int i32[203];
+  float f[203];
+  sa_running_stats stats;
+  sa_init_running_stats(&stats);
+  for (int i = 0; i < 203; ++i) {
+    i32[i] = (i * 37) % 101 - 50;
+    d[i] = f[i] = (float)i32[i];
+    sa_add_running_stats(&stats, d[i]);
+  }
+
+  sa_running_stats sd, si, sf;
+  sa_init_running_stats(&sd);
+  sa_init_running_stats(&si);
+  sa_init_running_stats(&sf);
+  sa_add_running_stats_array(&sd, d, 203);
+  sa_add_running_stats_array_int(&si, i32, 203);
+  sa_add_running_stats_array_flt(&sf, f, 203);
+  sa_running_stats *results[] = { &sd, &si, &sf };
+  for (int i = 0; i < 3; ++i) {
+    sa_running_stats *r = results[i];
+    mu_assert(r->count == stats.count, "%d received: %g", i, r->count);
+    mu_assert(fabs(r->mean - stats.mean) < 1e-9, "%d received: %g expected: %g",
+              i, r->mean, stats.mean);
+    mu_assert(fabs(r->sum - stats.sum) < 1e-6, "%d received: %g expected: %g",
+              i, r->sum, stats.sum);
+  }
+
+  sa_init_running_stats(&sd);
+  sa_add_running_stats_array(&sd, d, 0);
+  mu_assert(sd.count == 0, "received: %g", sd.count);
+
+  double nf[] = { 1, NAN, 2, INFINITY, 3, -INFINITY };
+  sa_add_running_stats_array(&sd, nf, 6);
+  mu_assert(sd.count == 3, "received: %g", sd.count);
+  mu_assert(sd.mean == 2, "received: %g", sd.mean);
+  double v = sa_variance_running_stats(&sd);
+  mu_assert(v == 1, "received: %g", v);
+  return NULL;
+}
+
+
+static char* test_merge()
+{
+  sa_running_stats all, a, b, empty;
+  sa_init_running_stats(&all);
+  sa_init_running_stats(&a);
+  sa_init_running_stats(&b);
+  sa_init_running_stats(&empty);
+  for (int i = 0; i < 100; ++i) {
+    double d = 1e9 + (i * 37) % 101;
+    sa_add_running_stats(&all, d);
+    sa_add_running_stats(i < 30 ? &a : &b, d);
+  }
+  sa_merge_running_stats(&a, &empty);
+  mu_assert(a.count == 30, "received: %g", a.count);
+  sa_merge_running_stats(&empty, &b);
+  mu_assert(empty.count == 70, "received: %g", empty.count);
+  mu_assert(empty.mean == b.mean, "received: %g", empty.mean);
+
+  sa_merge_running_stats(&a, &b);
+  mu_assert(a.count == all.count, "received: %g", a.count);
+  mu_assert(fabs(a.mean - all.mean) < 1e-6, "received: %g expected: %g",
+            a.mean, all.mean);
+  double sd = sa_sd_running_stats(&a);
+  double esd = sa_sd_running_stats(&all);
+  mu_assert(fabs(sd - esd) < 1e-6, "received: %g expected: %g", sd, esd);
+  return NULL;
+}
+
+
+static char* test_reduce()
+{
+  sa_running_stats all, s, partials[7];
+  sa_init_running_stats(&all);
+  for (int i = 0; i < 7; ++i) {
+    sa_init_running_stats(&partials[i]);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    sa_add_running_stats(&all, i);
+    sa_add_running_stats(&partials[i % 7], i);
+  }
+  sa_reduce_running_stats(&s, partials, 7);
+  mu_assert(s.count == 1000, "received: %g", s.count);
+  mu_assert(fabs(s.mean - 499.5) < 1e-9, "received: %g", s.mean);
+  double v = sa_variance_running_stats(&s);
+  double ev = sa_variance_running_stats(&all);
+  mu_assert(fabs(v - ev) < 1e-6, "received: %g expected: %g", v, ev);
+
+  sa_reduce_running_stats(&s, partials, 0);
+  mu_assert(s.count == 0, "received: %g", s.count);
+  sa_reduce_running_stats(&s, partials, 1);
+  mu_assert(s.count == partials[0].count, "received: %g", s.count);
+  return NULL;
+}
+
+
+static char* test_moments()
+{
+  double v[250];
+  double mean = 0;
+  for (int i = 0; i < 250; ++i) {
+    v[i] = 1e6 + ((i * 37) % 101) * ((i * 37) % 101) / 10.0;
+    mean += v[i];
+  }
+  mean /= 250;
+  double m2 = 0, m3 = 0, m4 = 0;
+  for (int i = 0; i < 250; ++i) {
+    double d = v[i] - mean;
+    m2 += d * d;
+    m3 += d * d * d;
+    m4 += d * d * d * d;
+  }
+  double eskew = sqrt(250.0) * m3 / pow(m2, 1.5);
+  double ekurt = 250.0 * m4 / (m2 * m2) - 3;
+
+  sa_moment_stats s, a, b, arr;
+  sa_init_moment_stats(&s);
+  sa_init_moment_stats(&a);
+  sa_init_moment_stats(&b);
+  sa_init_moment_stats(&arr);
+  double skew = sa_skewness_moment_stats(&s);
+  mu_assert(skew == 0, "received: %g", skew);
+  sa_add_moment_stats(&s, NAN);
+  sa_add_moment_stats(&s, INFINITY);
+  mu_assert(s.count == 0, "received: %g", s.count);
+  for (int i = 0; i < 250; ++i) {
+    sa_add_moment_stats(&s, v[i]);
+    sa_add_moment_stats(i < 80 ? &a : &b, v[i]);
+  }
+  sa_merge_moment_stats(&a, &b);
+  sa_add_moment_stats_array(&arr, v, 250);
+
+  sa_moment_stats *results[] = { &s, &a, &arr };
+  for (int i = 0; i < 3; ++i) {
+    sa_moment_stats *r = results[i];
+    mu_assert(r->count == 250, "%d received: %g", i, r->count);
+    mu_assert(fabs(r->mean - mean) < 1e-6, "%d received: %g expected: %g", i,
+              r->mean, mean);
+    mu_assert(r->min == 1e6, "%d received: %g", i, r->min);
+    mu_assert(r->max == 1e6 + 1000, "%d received: %g", i, r->max);
+    double var = sa_variance_moment_stats(r);
+    mu_assert(fabs(var - m2 / 249) < 1e-6, "%d received: %g expected: %g", i,
+              var, m2 / 249);
+    skew = sa_skewness_moment_stats(r);
+    mu_assert(fabs(skew - eskew) < 1e-9, "%d received: %g expected: %g", i,
+              skew, eskew);
+    double kurt = sa_kurtosis_moment_stats(r);
+    mu_assert(fabs(kurt - ekurt) < 1e-9, "%d received: %g expected: %g", i,
+              kurt, ekurt);
+  }
+
+  size_t len;
+  char *buf = sa_serialize_moment_stats(&s, &len);
+  mu_assert(buf, "serialize successful");
+  int rv = sa_deserialize_moment_stats(&b, buf, len);
+  mu_assert(rv == 0, "received: %d", rv);
+  mu_assert(memcmp(&b, &s, sizeof(s)) == 0, "deserialization mismatch");
+  rv = sa_deserialize_moment_stats(&b, buf, len - 1);
+  free(buf);
+  mu_assert(rv == 1, "received: %d", rv);
+  mu_assert(b.count == 0, "received: %g", b.count);
+  return NULL;
+}
+
+
+static char* test_bivariate()
+{
+  sa_bivariate_stats s, a, b;
+  sa_init_bivariate_stats(&s);
+  sa_init_bivariate_stats(&a);
+  sa_init_bivariate_stats(&b);
+  double r = sa_correlation_bivariate_stats(&s);
+  mu_assert(r == 0, "received: %g", r);
+  sa_add_bivariate_stats(&s, 1, NAN);
+  sa_add_bivariate_stats(&s, INFINITY, 1);
+  mu_assert(s.count == 0, "received: %g", s.count);
+
+  double sx = 0, sy = 0, sxy = 0, sxx = 0, syy = 0;
+  for (int i = 0; i < 100; ++i) {
+    double x = i;
+    double y = 2 * i + (i * 37) % 11;
+    sx += x; sy += y; sxy += x * y; sxx += x * x; syy += y * y;
+    sa_add_bivariate_stats(&s, x, y);
+    sa_add_bivariate_stats(i % 3 ? &a : &b, x, y);
+  }
+  double ecov = (sxy - sx * sy / 100) / 99;
+  double er = (sxy - sx * sy / 100)
+      / sqrt((sxx - sx * sx / 100) * (syy - sy * sy / 100));
+
+  sa_merge_bivariate_stats(&a, &b);
+  sa_bivariate_stats *results[] = { &s, &a };
+  for (int i = 0; i < 2; ++i) {
+    sa_bivariate_stats *rs = results[i];
+    mu_assert(rs->count == 100, "%d received: %g", i, rs->count);
+    double cov = sa_covariance_bivariate_stats(rs);
+    mu_assert(fabs(cov - ecov) < 1e-9, "%d received: %g expected: %g", i, cov,
+              ecov);
+    r = sa_correlation_bivariate_stats(rs);
+    mu_assert(fabs(r - er) < 1e-12, "%d received: %g expected: %g", i, r, er);
+  }
+
+  sa_init_bivariate_stats(&a);
+  for (int i = 0; i < 10; ++i) {
+    sa_add_bivariate_stats(&a, i, -3 * i);
+  }
+  r = sa_correlation_bivariate_stats(&a);
+  mu_assert(r == -1, "received: %g", r);
+
+  size_t len;
+  char *buf = sa_serialize_bivariate_stats(&s, &len);
+  mu_assert(buf, "serialize successful");
+  int rv = sa_deserialize_bivariate_stats(&b, buf, len);
+  free(buf);
+  mu_assert(rv == 0, "received: %d", rv);
+  mu_assert(memcmp(&b, &s, sizeof(s)) == 0, "deserialization mismatch");
+  return NULL;
+}
+
+
+static char* test_ewma()
+{
+  sa_ewma_stats s, s1;
+  sa_init_ewma_stats(&s, 10);
+  double sd = sa_sd_ewma_stats(&s);
+  mu_assert(sd == 0, "received: %g", sd);
+  sa_add_ewma_stats(&s, 100, NAN);
+  mu_assert(s.weight == 0, "received: %g", s.weight);
+
+  sa_add_ewma_stats(&s, 100, 0);
+  sa_add_ewma_stats(&s, 110, 10);
+  mu_assert(s.weight == 1.5, "received: %g", s.weight);
+  mu_assert(fabs(s.mean - 20.0 / 3) < 1e-12, "received: %g", s.mean);
+  double v = sa_variance_ewma_stats(&s);
+  mu_assert(fabs(v - 200.0 / 9) < 1e-12, "received: %g", v);
+  double w = sa_weight_ewma_stats(&s, 120);
+  mu_assert(w == 0.75, "received: %g", w);
+  w = sa_weight_ewma_stats(&s, 50);
+  mu_assert(w == 1.5, "received: %g", w);
+
+  // late arrival is decayed relative to the current time
+  sa_add_ewma_stats(&s, 100, 10);
+  mu_assert(s.weight == 2, "received: %g", s.weight);
+  mu_assert(s.current_time == 110, "received: %llu",
+            (unsigned long long)s.current_time);
+  mu_assert(fabs(s.mean - 7.5) < 1e-12, "received: %g", s.mean);
+
+  size_t len;
+  char *buf = sa_serialize_ewma_stats(&s, &len);
+  mu_assert(buf, "serialize successful");
+  sa_init_ewma_stats(&s1, 10);
+  int rv = sa_deserialize_ewma_stats(&s1, buf, len);
+  mu_assert(rv == 0, "received: %d", rv);
+  mu_assert(memcmp(&s, &s1, sizeof(s)) == 0, "deserialization mismatch");
+  sa_init_ewma_stats(&s1, 20);
+  rv = sa_deserialize_ewma_stats(&s1, buf, len);
+  mu_assert(rv == 3, "received: %d", rv);
+  rv = sa_deserialize_ewma_stats(&s1, buf, len - 1);
+  free(buf);
+  mu_assert(rv == 1, "received: %d", rv);
+
+  sa_init_ewma_stats(&s, 1000000000);
+  for (uint64_t t = 0; t < 100; ++t) {
+    sa_add_ewma_stats(&s, t * 1000000000, 42);
+  }
+  mu_assert(fabs(s.mean - 42) < 1e-12, "received: %g", s.mean);
+  mu_assert(fabs(s.weight - 2) < 1e-12, "received: %g", s.weight);
+  return NULL;
+}
+
+
 static char* test_serialization()
 {
   sa_running_stats stats, stats1;
@@ -119,15 +393,80 @@ static char* benchmark_update()
 }
 
 
+static char* benchmark_update_array()
+{
+  size_t iter = 200000;
+  double *v = malloc(sizeof(double) * iter);
+  mu_assert(v, "malloc failed");
+  for (size_t i = 0; i < iter; ++i) {
+    v[i] = (double)i;
+  }
+
+  sa_running_stats stats;
+  sa_init_running_stats(&stats);
+
+  clock_t t = clock();
+  sa_add_running_stats_array(&stats, v, iter);
+  t = clock() - t;
+  free(v);
+  mu_assert(stats.count == iter, "received: %g", stats.count);
+  printf("benchmark update array: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
+static char* benchmark_update_moments()
+{
+  double iter = 200000;
+
+  sa_moment_stats stats;
+  sa_init_moment_stats(&stats);
+
+  clock_t t = clock();
+  for (double x = 0; x < iter; ++x) {
+    sa_add_moment_stats(&stats, x);
+  }
+  t = clock() - t;
+  printf("benchmark update moments: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
+static char* benchmark_update_ewma()
+{
+  double iter = 200000;
+
+  sa_ewma_stats stats;
+  sa_init_ewma_stats(&stats, 60000000000ULL);
+
+  clock_t t = clock();
+  for (double x = 0; x < iter; ++x) {
+    sa_add_ewma_stats(&stats, (uint64_t)x * 1000000, x);
+  }
+  t = clock() - t;
+  printf("benchmark update ewma: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
 static char* all_tests()
 {
   mu_run_test(test_stub);
   mu_run_test(test_init);
   mu_run_test(test_calculation);
   mu_run_test(test_nan_inf);
+  mu_run_test(test_add_array);
+  mu_run_test(test_merge);
+  mu_run_test(test_reduce);
+  mu_run_test(test_moments);
+  mu_run_test(test_bivariate);
+  mu_run_test(test_ewma);
   mu_run_test(test_serialization);
 
   mu_run_test(benchmark_update);
+  mu_run_test(benchmark_update_array);
+  mu_run_test(benchmark_update_moments);
+  mu_run_test(benchmark_update_ewma);
   return NULL;
 }
 
@@ -6,13 +6,18 @@
 
 /** @brief time_series unit tests @file */
 
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
 #include <inttypes.h>
 #include <limits.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "mu_test.h"
+#include "p2.h"
 #include "time_series.h"
 const double benchmark[] = {
   32, 61, 44, 45, 31, 44, 47, 26, 32, 36, 54, 62, 39, 60, 53, 40, 45, 41,
@@ -734,6 +739,640 @@ static char* test_time_series_int()
 }
 
 
+static char* check_window(sa_time_series_int *ts, int window)
+{
+  sa_running_stats rs, ers;
+  sa_init_running_stats(&ers);
+  int min, max, emin = INT_MAX, emax = INT_MIN;
+  uint64_t ct = sa_timestamp_time_series_int(ts);
+  for (int i = 0; i < window; ++i) {
+    int v = sa_get_time_series_int(ts, ct - i);
+    sa_add_running_stats(&ers, v);
+    if (v < emin) {emin = v;}
+    if (v > emax) {emax = v;}
+  }
+  mu_assert_rv(0, sa_window_stats_time_series_int(ts, &rs, &min, &max));
+  mu_assert(rs.count == window, "received: %g", rs.count);
+  mu_assert(fabs(rs.mean - ers.mean) < 1e-9, "received: %g expected: %g",
+            rs.mean, ers.mean);
+  mu_assert(fabs(rs.sum - ers.sum) < 1e-6, "received: %g expected: %g",
+            rs.sum, ers.sum);
+  mu_assert(min == emin, "received: %d expected: %d", min, emin);
+  mu_assert(max == emax, "received: %d expected: %d", max, emax);
+  return NULL;
+}
+
+
+static char* test_ring_time_series_int()
+{
+  const int rows[] = { 8, 7 }; // masked and modulo ring indexing
+  const uint64_t ns_per_row = 3;
+  for (size_t c = 0; c < sizeof(rows) / sizeof(rows[0]); ++c) {
+    int n = rows[c];
+    sa_time_series_int *ts = sa_create_time_series_int(n, ns_per_row);
+    mu_assert(ts, "creation failed");
+    sa_time_series_int *ts1 = sa_create_time_series_int(n, ns_per_row);
+    mu_assert(ts1, "creation failed");
+    uint64_t mrow[8];
+    int mval[8] = { 0 };
+    for (int i = 0; i < n; ++i) {mrow[i] = i;}
+    uint64_t current_row = n - 1;
+
+    srand(1);
+    for (int i = 0; i < 10000; ++i) {
+      int r = rand() % 100;
+      uint64_t row = current_row;
+      if (r < 5) {
+        row += rand() % (3 * n); // sometimes past the whole ring
+      } else if (r < 30) {
+        ++row;
+      } else if (r < 60 && row > (uint64_t)n) {
+        row -= rand() % (n + 2);
+      }
+      uint64_t ns = row * ns_per_row + rand() % ns_per_row;
+      int expected = INT_MIN;
+      if (row > current_row) {current_row = row;}
+      if (current_row - row < (uint64_t)n) {
+        int slot = row % n;
+        if (mrow[slot] != row) {
+          mrow[slot] = row;
+          mval[slot] = 0;
+        }
+        expected = ++mval[slot];
+      }
+      mu_assert_rv(expected, sa_add_time_series_int(ts, ns, 1));
+      mu_assert(sa_timestamp_time_series_int(ts) == current_row * ns_per_row,
+                "rows: %d iteration: %d", n, i);
+
+      row = current_row - rand() % n;
+      expected = mrow[row % n] == row ? mval[row % n] : 0;
+      mu_assert_rv(expected, sa_get_time_series_int(ts, row * ns_per_row));
+
+      if (i % 100 == 0) { // the serialized ring is stored by absolute row
+        size_t len;
+        char *buf = sa_serialize_time_series_int(ts, &len);
+        mu_assert_rv(0, sa_deserialize_time_series_int(ts1, buf, len));
+        free(buf);
+        for (row = current_row - n + 1; row <= current_row; ++row) {
+          uint64_t ns = row * ns_per_row;
+          mu_assert_rv(sa_get_time_series_int(ts, ns),
+                       sa_get_time_series_int(ts1, ns));
+        }
+      }
+    }
+    sa_destroy_time_series_int(ts1);
+    sa_destroy_time_series_int(ts);
+  }
+  return NULL;
+}
+
+
+static char* test_batch_time_series_int()
+{
+  sa_time_series_int *ts = sa_create_time_series_int(10, 1);
+  mu_assert(ts, "creation failed");
+  mu_assert(sa_add_time_series_int_batch(ts, NULL, NULL, 0) == 0, "empty");
+
+  const uint64_t sns[] = { 9, 20, 10, 9, 20, 25 };
+  const int sv[] = { 1, 2, 3, 4, INT_MAX, -5 };
+  mu_assert(sa_add_time_series_int_batch(ts, sns, sv, 6) == 3, "added");
+  mu_assert_rv(25, (int)sa_timestamp_time_series_int(ts));
+  mu_assert_rv(INT_MAX, sa_get_time_series_int(ts, 20));
+  mu_assert_rv(-5, sa_get_time_series_int(ts, 25));
+  mu_assert_rv(0, sa_get_time_series_int(ts, 16)); // 9 and 10 out of range
+  sa_destroy_time_series_int(ts);
+
+  enum { n = 2000 };
+  uint64_t ns[n];
+  int v[n];
+  sa_time_series_int *seq = sa_create_indexed_time_series_int(50, 1, 10);
+  sa_time_series_int *bat = sa_create_indexed_time_series_int(50, 1, 10);
+  srand(1);
+  uint64_t ct = 200;
+  for (int b = 0; b < 20; ++b) {
+    int len = rand() % n;
+    for (int i = 0; i < len; ++i) {
+      int r = rand() % 100;
+      if (r < 2) {
+        ct += rand() % 75;
+      } else if (r < 20) {
+        ++ct;
+      }
+      ns[i] = ct - rand() % (r < 80 ? 1 : 60);
+      v[i] = rand() % 201 - 100;
+      sa_add_time_series_int(seq, ns[i], v[i]);
+    }
+    sa_add_time_series_int_batch(bat, ns, v, len);
+
+    size_t slen, blen;
+    char *sbuf = sa_serialize_time_series_int(seq, &slen);
+    char *bbuf = sa_serialize_time_series_int(bat, &blen);
+    mu_assert(slen == blen && memcmp(sbuf, bbuf, slen) == 0, "batch: %d", b);
+    free(sbuf);
+    free(bbuf);
+    char *err = check_window(bat, 10);
+    if (err) {return err;}
+    sa_range_stats_int srs, brs;
+    uint64_t start = sa_timestamp_time_series_int(bat) - 49;
+    mu_assert_rv(0, sa_range_stats_time_series_int(seq, start, 50, &srs));
+    mu_assert_rv(0, sa_range_stats_time_series_int(bat, start, 50, &brs));
+    mu_assert(srs.sum == brs.sum && srs.min == brs.min && srs.max == brs.max,
+              "batch: %d", b);
+  }
+  sa_destroy_time_series_int(seq);
+  sa_destroy_time_series_int(bat);
+
+  // interleaved out of order rows: a few rows (per row table), more rows than
+  // the table holds with a batch larger than the ring (row scratch) and a
+  // batch smaller than the ring (sorted)
+  const int rows[] = { 50, 50, 1000 };
+  const int spread[] = { 4, 50, 400 };
+  const int lens[] = { 2000, 2000, 300 };
+  for (int c = 0; c < 3; ++c) {
+    seq = sa_create_indexed_time_series_int(rows[c], 1, 10);
+    bat = sa_create_indexed_time_series_int(rows[c], 1, 10);
+    mu_assert(seq && bat, "creation failed");
+    ct = 1000;
+    for (int b = 0; b < 10; ++b) {
+      ct += rand() % 20;
+      for (int i = 0; i < lens[c]; ++i) {
+        ns[i] = ct - (i * 7 + rand() % 3) % spread[c];
+        v[i] = rand() % 201 - 100;
+        sa_add_time_series_int(seq, ns[i], v[i]);
+      }
+      mu_assert(sa_add_time_series_int_batch(bat, ns, v, lens[c])
+                == (size_t)lens[c], "case: %d batch: %d", c, b);
+
+      size_t slen, blen;
+      char *sbuf = sa_serialize_time_series_int(seq, &slen);
+      char *bbuf = sa_serialize_time_series_int(bat, &blen);
+      mu_assert(slen == blen && memcmp(sbuf, bbuf, slen) == 0,
+                "case: %d batch: %d", c, b);
+      free(sbuf);
+      free(bbuf);
+      char *err = check_window(bat, 10);
+      if (err) {return err;}
+    }
+    sa_destroy_time_series_int(seq);
+    sa_destroy_time_series_int(bat);
+  }
+  return NULL;
+}
+
+
+static char* test_rollup_time_series_int()
+{
+  const int rows[] = { 10, 6, 4 };
+  const uint64_t ns_per_row[] = { 1, 5, 30 };
+  mu_assert(!sa_create_rollup_time_series_int(0, rows, ns_per_row,
+                                              SA_ROLLUP_SUM), "levels");
+  const uint64_t bad_ns[] = { 2, 5, 30 };
+  mu_assert(!sa_create_rollup_time_series_int(3, rows, bad_ns, SA_ROLLUP_SUM),
+            "not a multiple");
+  const int bad_rows[] = { 10, 1, 4 };
+  mu_assert(!sa_create_rollup_time_series_int(3, bad_rows, ns_per_row,
+                                              SA_ROLLUP_SUM), "rows");
+
+  const sa_rollup_cf cfs[] = { SA_ROLLUP_SUM, SA_ROLLUP_MIN, SA_ROLLUP_MAX,
+    SA_ROLLUP_AVG };
+  for (size_t c = 0; c < sizeof(cfs) / sizeof(cfs[0]); ++c) {
+    sa_rollup_cf cf = cfs[c];
+    bool fold = cf == SA_ROLLUP_MIN || cf == SA_ROLLUP_MAX;
+    sa_rollup_time_series_int *rts = sa_create_rollup_time_series_int(
+        3, rows, ns_per_row, cf);
+    mu_assert(rts, "creation failed");
+    // reference at the finest resolution covering the coarsest level
+    sa_time_series_int *ref = sa_create_time_series_int(200, 1);
+
+    srand(1);
+    uint64_t ct = 200;
+    sa_add_rollup_time_series_int(rts, ct, 0);
+    sa_add_time_series_int(ref, ct, 0);
+    for (int i = 0; i < 3000; ++i) {
+      int r = rand() % 100;
+      if (r < 3) {
+        ct += rand() % 100;
+      } else if (r < 40) {
+        ++ct;
+      }
+      // min/max reject late updates once a coarser bucket lost finer rows
+      uint64_t ns = ct - (r < 70 ? 0 : rand() % 10);
+      int v = rand() % 21 - 10;
+      if (sa_add_rollup_time_series_int(rts, ns, v) != INT_MIN) {
+        sa_add_time_series_int(ref, ns, v);
+      } else {
+        mu_assert(fold && ns < ct, "iteration: %d rejected", i);
+      }
+      mu_assert(sa_timestamp_rollup_time_series_int(rts)
+                == sa_timestamp_time_series_int(ref), "iteration: %d", i);
+
+      for (int l = 0; l < 3; ++l) {
+        uint64_t bucket = ct - ct % ns_per_row[l];
+        for (int k = 0; k < rows[l]; ++k, bucket -= ns_per_row[l]) {
+          sa_range_stats_int rs;
+          int n = k ? (int)ns_per_row[l] : (int)(ct - bucket + 1);
+          mu_assert_rv(0, sa_range_stats_time_series_int(ref, bucket, n, &rs));
+          double e = (double)rs.sum;
+          if (cf == SA_ROLLUP_MIN) {
+            e = rs.nonzero ? rs.min : 0;
+          } else if (cf == SA_ROLLUP_MAX) {
+            e = rs.nonzero ? rs.max : 0;
+          } else if (cf == SA_ROLLUP_AVG) {
+            e /= ns_per_row[l];
+          }
+          double v = sa_get_rollup_time_series_int(rts, l, bucket);
+          mu_assert(fabs(e - v) < 1e-9, "cf: %d iteration: %d level: %d "
+                    "bucket: %" PRIu64 " expected: %g received: %g", (int)cf, i,
+                    l, bucket, e, v);
+        }
+      }
+    }
+    mu_assert(isnan(sa_get_rollup_time_series_int(rts, 3, ct)), "level");
+    mu_assert(isnan(sa_get_rollup_time_series_int(rts, 0, ct + 1)), "future");
+    mu_assert(isnan(sa_get_rollup_time_series_int(rts, 0, ct - 10)), "past");
+
+    size_t len;
+    char *buf = sa_serialize_rollup_time_series_int(rts, &len);
+    sa_rollup_time_series_int *rts1 = sa_create_rollup_time_series_int(
+        3, rows, ns_per_row, cf);
+    mu_assert_rv(0, sa_deserialize_rollup_time_series_int(rts1, buf, len));
+    for (int l = 0; l < 3; ++l) {
+      mu_assert(sa_get_rollup_time_series_int(rts, l, ct)
+                == sa_get_rollup_time_series_int(rts1, l, ct), "level: %d", l);
+    }
+    mu_assert_rv(1, sa_deserialize_rollup_time_series_int(rts1, buf,
+                                                          len - 1));
+    sa_rollup_time_series_int *rts2 = sa_create_rollup_time_series_int(
+        3, rows, ns_per_row, cf == SA_ROLLUP_SUM ? SA_ROLLUP_AVG
+        : SA_ROLLUP_SUM);
+    mu_assert_rv(3, sa_deserialize_rollup_time_series_int(rts2, buf, len));
+    free(buf);
+    sa_destroy_rollup_time_series_int(rts2);
+    sa_destroy_rollup_time_series_int(rts1);
+    sa_destroy_rollup_time_series_int(rts);
+    sa_destroy_time_series_int(ref);
+  }
+
+  // a late update to a completed row cascades to the coarser levels
+  sa_rollup_time_series_int *rts = sa_create_rollup_time_series_int(
+      3, rows, ns_per_row, SA_ROLLUP_MAX);
+  sa_add_rollup_time_series_int(rts, 300, 5);
+  sa_add_rollup_time_series_int(rts, 306, 1);
+  sa_add_rollup_time_series_int(rts, 307, 1);
+  mu_assert(sa_get_rollup_time_series_int(rts, 2, 300) == 5, "max");
+  mu_assert_rv(15, sa_add_rollup_time_series_int(rts, 300, 10));
+  mu_assert(sa_get_rollup_time_series_int(rts, 1, 300) == 15, "max");
+  mu_assert(sa_get_rollup_time_series_int(rts, 2, 300) == 15, "max");
+  mu_assert_rv(-5, sa_add_rollup_time_series_int(rts, 300, -20));
+  mu_assert(sa_get_rollup_time_series_int(rts, 1, 300) == -5, "max");
+  mu_assert(sa_get_rollup_time_series_int(rts, 2, 300) == 1, "max");
+  sa_destroy_rollup_time_series_int(rts);
+
+  // a late update that raises the bucket minimum is recomputed from its rows
+  rts = sa_create_rollup_time_series_int(3, rows, ns_per_row, SA_ROLLUP_MIN);
+  sa_add_rollup_time_series_int(rts, 300, 5);
+  sa_add_rollup_time_series_int(rts, 301, 3);
+  sa_add_rollup_time_series_int(rts, 306, 7);
+  mu_assert(sa_get_rollup_time_series_int(rts, 1, 300) == 3, "min");
+  mu_assert_rv(13, sa_add_rollup_time_series_int(rts, 301, 10));
+  mu_assert(sa_get_rollup_time_series_int(rts, 1, 300) == 5, "min");
+  mu_assert(sa_get_rollup_time_series_int(rts, 2, 300) == 5, "min");
+  // the bucket starting at 300 lost its first finer rows
+  sa_add_rollup_time_series_int(rts, 310, 1);
+  mu_assert_rv(INT_MIN, sa_add_rollup_time_series_int(rts, 301, 1));
+  mu_assert(sa_get_rollup_time_series_int(rts, 1, 305) == 7, "min");
+  sa_destroy_rollup_time_series_int(rts);
+  return NULL;
+}
+
+
+static void merge_reference(sa_time_series_int *ts, sa_time_series_int *ts1,
+                            sa_merge_op op)
+{
+  uint64_t ns_per_row, ct = sa_timestamp_time_series_int(ts1);
+  size_t len;
+  char *buf = sa_serialize_time_series_int(ts1, &len);
+  memcpy(&ns_per_row, buf + sizeof(uint64_t), sizeof(uint64_t));
+  free(buf);
+  int rows = (int)(len - sizeof(uint64_t) * 2 - sizeof(int) * 2)
+      / sizeof(int);
+  uint64_t ns = ct - ns_per_row * (rows - 1);
+  for (int i = 0; i < rows; ++i, ns += ns_per_row) {
+    int v = sa_get_time_series_int(ts1, ns);
+    if (op == SA_MERGE_SET) {
+      sa_set_time_series_int(ts, ns, v);
+    } else {
+      sa_add_time_series_int(ts, ns, v);
+    }
+  }
+}
+
+
+static char* test_merge_time_series_int()
+{
+  // destination 40 x 4ns with a window and index; sources of finer, equal
+  // and coarser resolution
+  const int cfg[][2] = { { 30, 1 }, { 50, 2 }, { 7, 3 }, { 25, 4 },
+    { 60, 4 }, { 10, 12 }, { 9, 10 } };
+  for (size_t c = 0; c < sizeof(cfg) / sizeof(cfg[0]); ++c) {
+    for (int op = SA_MERGE_ADD; op <= SA_MERGE_SET; ++op) {
+      sa_time_series_int *ts = sa_create_indexed_time_series_int(40, 4, 10);
+      sa_time_series_int *ref = sa_create_indexed_time_series_int(40, 4, 10);
+      sa_time_series_int *ts1 = sa_create_time_series_int(cfg[c][0],
+                                                          cfg[c][1]);
+      srand(1);
+      uint64_t ct = 400;
+      for (int i = 0; i < 200; ++i) {
+        int r = rand() % 100;
+        ct += r < 5 ? rand() % 200 : (r < 30 ? 1 : 0);
+        int v = rand() % 201 - 100;
+        if (r < 4 && cfg[c][1] == 4) { // saturation is exact row by row
+          v = INT_MAX - abs(v);
+        }
+        if (r % 2) {
+          sa_add_time_series_int(ts1, ct * 4 - rand() % 20, v);
+        } else {
+          uint64_t ns = ct * 4 - rand() % 20;
+          sa_add_time_series_int(ts, ns, v);
+          sa_add_time_series_int(ref, ns, v);
+        }
+        if (i % 10 == 0) {
+          sa_merge_time_series_int(ts, ts1, (sa_merge_op)op);
+          merge_reference(ref, ts1, (sa_merge_op)op);
+
+          size_t len, rlen;
+          char *buf = sa_serialize_time_series_int(ts, &len);
+          char *rbuf = sa_serialize_time_series_int(ref, &rlen);
+          mu_assert(len == rlen && memcmp(buf, rbuf, len) == 0,
+                    "cfg: %d op: %d iteration: %d", (int)c, op, i);
+          free(buf);
+          free(rbuf);
+        }
+      }
+      sa_range_stats_int rs, rrs;
+      uint64_t start = sa_timestamp_time_series_int(ts) - 4 * 39;
+      mu_assert_rv(0, sa_range_stats_time_series_int(ts, start, 40, &rs));
+      mu_assert_rv(0, sa_range_stats_time_series_int(ref, start, 40, &rrs));
+      mu_assert(rs.sum == rrs.sum && rs.min == rrs.min && rs.max == rrs.max,
+                "cfg: %d op: %d", (int)c, op);
+      sa_running_stats ws, rws;
+      int min, max, rmin, rmax;
+      mu_assert_rv(0, sa_window_stats_time_series_int(ts, &ws, &min, &max));
+      mu_assert_rv(0, sa_window_stats_time_series_int(ref, &rws, &rmin,
+                                                      &rmax));
+      mu_assert(ws.mean == rws.mean && min == rmin && max == rmax,
+                "cfg: %d op: %d", (int)c, op);
+      sa_destroy_time_series_int(ts);
+      sa_destroy_time_series_int(ref);
+      sa_destroy_time_series_int(ts1);
+    }
+  }
+  return NULL;
+}
+
+
+static char* test_window_time_series_int()
+{
+  mu_assert(!sa_create_windowed_time_series_int(10, 1, 11), "creation success");
+  mu_assert(!sa_create_windowed_time_series_int(10, 1, -1), "creation success");
+  sa_time_series_int *ts = sa_create_time_series_int(10, 1);
+  sa_running_stats rs;
+  int min, max;
+  mu_assert_rv(1, sa_window_stats_time_series_int(ts, &rs, &min, &max));
+  sa_destroy_time_series_int(ts);
+
+  const int cfg[][2] = { { 50, 20 }, { 50, 50 }, { 7, 1 }, { 7, 2 } };
+  for (size_t c = 0; c < sizeof(cfg) / sizeof(cfg[0]); ++c) {
+    int rows = cfg[c][0];
+    int window = cfg[c][1];
+    ts = sa_create_windowed_time_series_int(rows, 1, window);
+    mu_assert(ts, "creation failed");
+    char *err = check_window(ts, window);
+    if (err) {return err;}
+
+    srand(1);
+    uint64_t ct = sa_timestamp_time_series_int(ts);
+    for (int i = 0; i < 5000; ++i) {
+      int r = rand() % 100;
+      if (r < 10) {
+        ct += rand() % (rows + 5); // advance, sometimes past the whole ring
+      } else if (r < 40) {
+        ++ct;
+      }
+      uint64_t ns = ct - rand() % (r < 90 ? 1 : rows);
+      int v = rand() % 201 - 100;
+      if (r % 3) {
+        sa_add_time_series_int(ts, ns, v);
+      } else {
+        sa_set_time_series_int(ts, ns, v);
+      }
+      err = check_window(ts, window);
+      if (err) {return err;}
+    }
+
+    size_t len;
+    char *buf = sa_serialize_time_series_int(ts, &len);
+    sa_time_series_int *ts1 = sa_create_windowed_time_series_int(rows, 1,
+                                                                 window);
+    mu_assert_rv(0, sa_deserialize_time_series_int(ts1, buf, len));
+    free(buf);
+    err = check_window(ts1, window);
+    if (err) {return err;}
+    sa_destroy_time_series_int(ts1);
+    sa_destroy_time_series_int(ts);
+  }
+  return NULL;
+}
+
+
+static char* test_window_precision_time_series_int()
+{
+  sa_running_stats rs;
+  int min, max;
+
+  // a large value rolls out of the window leaving only small ones
+  sa_time_series_int *ts = sa_create_windowed_time_series_int(16, 1, 16);
+  mu_assert(ts, "creation failed");
+  sa_set_time_series_int(ts, 0, 2000000000);
+  for (int i = 1; i <= 16; ++i) {
+    sa_add_time_series_int(ts, i, (i - 1) % 4 + 1);
+  }
+  mu_assert_rv(0, sa_window_stats_time_series_int(ts, &rs, &min, &max));
+  double usd = sa_usd_running_stats(&rs);
+  mu_assert(fabs(usd - sqrt(1.25)) < 1e-12, "received: %g", usd);
+  sa_destroy_time_series_int(ts);
+
+  // small deviations around a large offset
+  ts = sa_create_windowed_time_series_int(64, 1, 64);
+  mu_assert(ts, "creation failed");
+  for (int i = 0; i < 64; ++i) {
+    sa_add_time_series_int(ts, i, 1000000000 + i % 2);
+  }
+  mu_assert_rv(0, sa_window_stats_time_series_int(ts, &rs, &min, &max));
+  usd = sa_usd_running_stats(&rs);
+  mu_assert(fabs(usd - 0.5) < 1e-12, "received: %g", usd);
+
+  // the extremes of the value range, checked against a two pass calculation
+  sa_set_time_series_int(ts, 63, INT_MIN);
+  sa_set_time_series_int(ts, 62, INT_MAX);
+  mu_assert_rv(0, sa_window_stats_time_series_int(ts, &rs, &min, &max));
+  int64_t sum = 0;
+  for (int i = 0; i < 64; ++i) {sum += sa_get_time_series_int(ts, i);}
+  double mean = (double)sum / 64, m2 = 0;
+  for (int i = 0; i < 64; ++i) {
+    double d = sa_get_time_series_int(ts, i) - mean;
+    m2 += d * d;
+  }
+  mu_assert(fabs(rs.sum - m2) < m2 * 1e-12, "received: %g expected: %g",
+            rs.sum, m2);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_range_time_series_int()
+{
+  const int rows = 37;
+  sa_time_series_int *ts = sa_create_time_series_int(rows, 1);
+  sa_time_series_int *its = sa_create_indexed_time_series_int(rows, 1, 5);
+  mu_assert(ts && its, "creation failed");
+
+  sa_range_stats_int r, ir;
+  uint64_t ct = sa_timestamp_time_series_int(ts);
+  mu_assert_rv(1, sa_range_stats_time_series_int(its, ct + 1, 1, &ir));
+  mu_assert_rv(1, sa_range_stats_time_series_int(its, ct, 0, &ir));
+  mu_assert_rv(1, sa_range_stats_time_series_int(its, ct, rows + 1, &ir));
+
+  srand(2);
+  for (int i = 0; i < 5000; ++i) {
+    int op = rand() % 100;
+    if (op < 5) {
+      ct += rand() % (rows + 5);
+    } else if (op < 30) {
+      ++ct;
+    }
+    uint64_t ns = ct - rand() % rows;
+    int v = rand() % 3 ? rand() % 201 - 100 : 0;
+    if (op % 2) {
+      sa_add_time_series_int(ts, ns, v);
+      sa_add_time_series_int(its, ns, v);
+    } else {
+      sa_set_time_series_int(ts, ns, v);
+      sa_set_time_series_int(its, ns, v);
+    }
+
+    int n = rand() % rows + 1;
+    ns = sa_timestamp_time_series_int(ts) - rand() % rows;
+    mu_assert_rv(0, sa_range_stats_time_series_int(ts, ns, n, &r));
+    mu_assert_rv(0, sa_range_stats_time_series_int(its, ns, n, &ir));
+    mu_assert(r.sum == ir.sum, "%d received: %lld expected: %lld", i,
+              (long long)ir.sum, (long long)r.sum);
+    mu_assert(fabs(r.m2 - ir.m2) <= 1e-9 * (1 + r.m2),
+              "%d received: %g expected: %g", i, ir.m2, r.m2);
+    mu_assert(r.min == ir.min, "%d received: %d expected: %d", i, ir.min,
+              r.min);
+    mu_assert(r.max == ir.max, "%d received: %d expected: %d", i, ir.max,
+              r.max);
+    mu_assert(r.nonzero == ir.nonzero, "%d received: %d expected: %d", i,
+              ir.nonzero, r.nonzero);
+  }
+
+  size_t len;
+  char *buf = sa_serialize_time_series_int(ts, &len);
+  sa_init_time_series_int(its);
+  mu_assert_rv(0, sa_deserialize_time_series_int(its, buf, len));
+  free(buf);
+  ct = sa_timestamp_time_series_int(ts);
+  mu_assert_rv(0, sa_range_stats_time_series_int(ts, ct - rows + 1, rows, &r));
+  mu_assert_rv(0, sa_range_stats_time_series_int(its, ct - rows + 1, rows,
+                                                 &ir));
+  mu_assert(r.sum == ir.sum && r.min == ir.min && r.max == ir.max
+            && r.nonzero == ir.nonzero, "deserialized index mismatch");
+  sa_destroy_time_series_int(its);
+  sa_destroy_time_series_int(ts);
+
+  // small deviations around a large offset
+  ts = sa_create_time_series_int(64, 1);
+  its = sa_create_indexed_time_series_int(64, 1, 0);
+  mu_assert(ts && its, "creation failed");
+  sa_running_stats ers;
+  sa_init_running_stats(&ers);
+  for (int i = 0; i < 64; ++i) {
+    int v = 1000000000 + i % 2;
+    sa_add_time_series_int(ts, i, v);
+    sa_add_time_series_int(its, i, v);
+    sa_add_running_stats(&ers, v);
+  }
+  mu_assert_rv(0, sa_range_stats_time_series_int(ts, 0, 64, &r));
+  mu_assert_rv(0, sa_range_stats_time_series_int(its, 0, 64, &ir));
+  mu_assert(fabs(r.m2 - 16) < 1e-6 && fabs(ir.m2 - 16) < 1e-6
+            && fabs(ers.sum - 16) < 1e-6, "received: %g/%g expected: %g",
+            r.m2, ir.m2, ers.sum);
+  sa_destroy_time_series_int(its);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_typed_time_series()
+{
+  sa_time_series_int64 *ts = sa_create_time_series_int64(3, 10);
+  sa_time_series_flt *tsf = sa_create_time_series_flt(3, 10);
+  sa_time_series_dbl *tsd = sa_create_time_series_dbl(3, 10);
+  mu_assert(ts && tsf && tsd, "creation failed");
+  mu_assert(!sa_create_time_series_dbl(1, 10), "creation success");
+  uint64_t ct = sa_timestamp_time_series_int64(ts);
+  mu_assert(ct == 20, "received: %" PRIu64, ct);
+
+  int64_t big = INT64_MAX - 1;
+  mu_assert(sa_add_time_series_int64(ts, 25, big) == big, "add failed");
+  mu_assert(sa_add_time_series_int64(ts, 25, 5) == INT64_MAX, "no saturation");
+  mu_assert(sa_add_time_series_int64(ts, 10, INT64_MIN + 1) == INT64_MIN + 1,
+            "add failed");
+  mu_assert(sa_add_time_series_int64(ts, 10, -2) == INT64_MIN, "no saturation");
+  mu_assert(sa_get_time_series_int64(ts, 30) == INT64_MIN, "future row");
+  mu_assert(sa_set_time_series_int64(ts, 30, 7) == 7, "set failed");
+  mu_assert(sa_get_time_series_int64(ts, 20) == INT64_MAX, "advance cleared");
+  mu_assert(sa_get_time_series_int64(ts, 0) == INT64_MIN, "expired row");
+
+  mu_assert(sa_add_time_series_flt(tsf, 20, 1.5f) == 1.5f, "add failed");
+  mu_assert(sa_add_time_series_flt(tsf, 20, 1.25f) == 2.75f, "add failed");
+  mu_assert(isnan(sa_get_time_series_flt(tsf, 30)), "future row");
+  mu_assert(sa_set_time_series_flt(tsf, 50, 4) == 4, "set failed");
+  mu_assert(sa_get_time_series_flt(tsf, 30) == 0, "advance not cleared");
+  mu_assert(isnan(sa_get_time_series_flt(tsf, 20)), "expired row");
+
+  mu_assert(sa_add_time_series_dbl(tsd, 20, 1e300) == 1e300, "add failed");
+  mu_assert(sa_add_time_series_dbl(tsd, 21, 1e300) == 2e300, "add failed");
+  mu_assert(sa_get_time_series_dbl(tsd, 0) == 0, "initial row");
+
+  size_t len;
+  char *buf = sa_serialize_time_series_int64(ts, &len);
+  mu_assert(buf, "serialize failed");
+  sa_time_series_int64 *ts1 = sa_create_time_series_int64(3, 10);
+  mu_assert_rv(0, sa_deserialize_time_series_int64(ts1, buf, len));
+  mu_assert(sa_get_time_series_int64(ts1, 20) == INT64_MAX, "restore failed");
+  mu_assert(sa_get_time_series_int64(ts1, 30) == 7, "restore failed");
+  mu_assert_rv(3, sa_deserialize_time_series_dbl(tsd, buf, len));
+  mu_assert_rv(1, sa_deserialize_time_series_int64(ts1, buf, len - 1));
+  free(buf);
+
+  buf = sa_serialize_time_series_flt(tsf, &len);
+  mu_assert(buf, "serialize failed");
+  sa_time_series_flt *tsf1 = sa_create_time_series_flt(3, 10);
+  mu_assert_rv(0, sa_deserialize_time_series_flt(tsf1, buf, len));
+  mu_assert(sa_get_time_series_flt(tsf1, 50) == 4, "restore failed");
+  free(buf);
+
+  sa_destroy_time_series_flt(tsf1);
+  sa_destroy_time_series_int64(ts1);
+  sa_destroy_time_series_dbl(tsd);
+  sa_destroy_time_series_flt(tsf);
+  sa_destroy_time_series_int64(ts);
+  return NULL;
+}
+
+
 static char* test_serialize_time_series_int()
 {
   sa_time_series_int *t1 = sa_create_time_series_int(2, 1);
@@ -810,6 +1449,638 @@ static char* test_mp_time_series_int()
 
 
 
+static double znorm_distance(const double *a, const double *b, int m)
+{
+  double ma = 0, mb = 0, sa = 0, sb = 0, d = 0;
+  for (int i = 0; i < m; ++i) {
+    ma += a[i];
+    mb += b[i];
+  }
+  ma /= m;
+  mb /= m;
+  for (int i = 0; i < m; ++i) {
+    sa += (a[i] - ma) * (a[i] - ma);
+    sb += (b[i] - mb) * (b[i] - mb);
+  }
+  sa = sqrt(sa / m);
+  sb = sqrt(sb / m);
+  for (int i = 0; i < m; ++i) {
+    double x = (a[i] - ma) / sa - (b[i] - mb) / sb;
+    d += x * x;
+  }
+  return sqrt(d);
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+
+static char* test_mp_reference_time_series_int()
+{
+  const int rows = 256, n = 250, m = 16;
+  sa_time_series_int *ts = sa_create_time_series_int(rows, 1);
+  mu_assert(ts, "creation failed");
+
+  srand(7);
+  double v[400];
+  for (int i = 0; i < 400; ++i) {
+    v[i] = rand() % 100;
+    sa_add_time_series_int(ts, i, (int)v[i]);
+  }
+
+  // the window wraps the ring buffer
+  int start = 400 - rows + 3;
+  double *mp;
+  int *mpi;
+  int mp_len = n - m + 1;
+  mu_assert_rv(mp_len, sa_mp_time_series_int(ts, start, n, m, 100, &mp,
+                                             &mpi));
+  const double *w = v + start;
+  for (int i = 0; i < mp_len; ++i) {
+    double ev = INFINITY;
+    for (int j = 0; j < mp_len; ++j) {
+      if (abs(i - j) <= m / 4) {continue;}
+      double d = znorm_distance(w + i, w + j, m);
+      if (d < ev) {ev = d;}
+    }
+    mu_assert(fabs(ev - mp[i]) < 1e-6, "idx: %d expected %g received: %g", i,
+              ev, mp[i]);
+    mu_assert(abs(i - mpi[i]) > m / 4, "idx: %d mpi: %d", i, mpi[i]);
+    double d = znorm_distance(w + i, w + mpi[i], m);
+    mu_assert(fabs(d - mp[i]) < 1e-6, "idx: %d mpi: %d distance %g", i,
+              mpi[i], d);
+  }
+  free(mp);
+  free(mpi);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_mp_stream_time_series_int()
+{
+  const int rows = 200, n = 120, m = 12, len = n - m + 1;
+  mu_assert(!sa_create_mp_stream_int(NULL, n, m), "created");
+  sa_time_series_int *ts = sa_create_time_series_int(rows, 1);
+  mu_assert(ts, "creation failed");
+  mu_assert(!sa_create_mp_stream_int(ts, rows, m), "created");
+  mu_assert(!sa_create_mp_stream_int(ts, n, 3), "created");
+  mu_assert(!sa_create_mp_stream_int(ts, n, n / 4 + 1), "created");
+
+  sa_mp_stream_int *mps = sa_create_mp_stream_int(ts, n, m);
+  sa_mp_stream_int *lag = sa_create_mp_stream_int(ts, n, m);
+  sa_mp_stream_int *fresh = sa_create_mp_stream_int(ts, n, m);
+  mu_assert(mps && lag && fresh, "creation failed");
+
+  srand(11);
+  double v[1000];
+  double smp[len], emp[len], lmp[len];
+  int smpi[len], lmpi[len];
+  for (int r = 0; r < 1000; ++r) {
+    v[r] = rand() % 50 + (r % 37 == 0 ? 200 : 0);
+    sa_add_time_series_int(ts, r, (int)v[r]);
+    if (r < rows) {continue;}
+
+    uint64_t start = r - n; // the current row r is still open
+    double d = sa_update_mp_stream_int(mps);
+    if (r == rows) {sa_update_mp_stream_int(lag);}
+    mu_assert(sa_timestamp_mp_stream_int(mps) == start + len - 1, "row: %d",
+              r);
+    // the most recent sub-sequence only has neighbors in the window
+    double ev = INFINITY;
+    for (int j = 0; j < len - m / 4 - 1; ++j) {
+      double e = znorm_distance(v + start + len - 1, v + start + j, m);
+      if (e < ev) {ev = e;}
+    }
+    mu_assert(fabs(ev - d) < 1e-6, "row: %d expected %g received: %g", r, ev,
+              d);
+
+    if (r % 97 == 0) {
+      mu_assert_rv(len, sa_get_mp_stream_int(mps, smp, smpi));
+      for (int i = 0; i < len; ++i) {
+        ev = INFINITY;
+        for (int j = 0; j < len; ++j) {
+          if (abs(i - j) <= m / 4) {continue;}
+          double e = znorm_distance(v + start + i, v + start + j, m);
+          if (e < ev) {ev = e;}
+        }
+        emp[i] = ev;
+        // expired neighbors can only lower the value
+        mu_assert(smp[i] < ev + 1e-6, "row: %d idx: %d expected <= %g"
+                  " received: %g", r, i, ev, smp[i]);
+        if (smpi[i] >= 0) {
+          mu_assert(fabs(smp[i] - znorm_distance(v + start + i,
+                                                 v + start + smpi[i], m))
+                    < 1e-6, "row: %d idx: %d", r, i);
+        }
+      }
+      // rebuilding from the time series produces the exact profile
+      sa_init_mp_stream_int(fresh);
+      sa_update_mp_stream_int(fresh);
+      mu_assert_rv(len, sa_get_mp_stream_int(fresh, lmp, lmpi));
+      for (int i = 0; i < len; ++i) {
+        mu_assert(fabs(emp[i] - lmp[i]) < 1e-6, "row: %d idx: %d expected %g"
+                  " received: %g", r, i, emp[i], lmp[i]);
+        mu_assert(fabs(lmp[i] - znorm_distance(v + start + i,
+                                               v + start + lmpi[i], m))
+                  < 1e-6, "row: %d idx: %d", r, i);
+      }
+    } else if (r % 13 == 0) {
+      // catching up several rows matches updating on every row
+      sa_update_mp_stream_int(lag);
+      mu_assert_rv(len, sa_get_mp_stream_int(lag, lmp, lmpi));
+      mu_assert_rv(len, sa_get_mp_stream_int(mps, smp, smpi));
+      for (int i = 0; i < len; ++i) {
+        mu_assert(fabs(smp[i] - lmp[i]) < 1e-9 && smpi[i] == lmpi[i],
+                  "row: %d idx: %d expected %g/%d received: %g/%d", r, i,
+                  smp[i], smpi[i], lmp[i], lmpi[i]);
+      }
+    }
+  }
+
+  // advancing past the retained rows rebuilds the profile
+  sa_add_time_series_int(ts, 5000, 1);
+  double d = sa_update_mp_stream_int(mps);
+  mu_assert(isinf(d), "received: %g", d);
+  mu_assert(sa_timestamp_mp_stream_int(mps) == (uint64_t)(5000 - m),
+            "received: %"
+            PRIu64, sa_timestamp_mp_stream_int(mps));
+
+  sa_destroy_mp_stream_int(fresh);
+  sa_destroy_mp_stream_int(lag);
+  sa_destroy_mp_stream_int(mps);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_mp_threads_time_series_int()
+{
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  sa_time_series_int *ts = sa_create_time_series_int(len, 1);
+  mu_assert(ts, "creation failed");
+
+  for (size_t i = 0; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  const double percent[] = { 100, 10 };
+  const int threads[] = { 2, 3, 4, 7 };
+  double *mp, *tmp;
+  int *mpi, *tmpi;
+  for (int p = 0; p < 2; ++p) {
+    srand(1);
+    int mp_len = sa_mp_time_series_int(ts, 0, len, 60, percent[p], &mp, &mpi);
+    mu_assert(mp_len == (int)len - 60 + 1, "received %d", mp_len);
+    for (int t = 0; t < 4; ++t) {
+      srand(1);
+      mu_assert_rv(mp_len, sa_mp_threads_time_series_int(ts, 0, len, 60,
+                                                         percent[p],
+                                                         threads[t], &tmp,
+                                                         &tmpi));
+      for (int i = 0; i < mp_len; ++i) {
+        mu_assert(mp[i] == tmp[i] && mpi[i] == tmpi[i],
+                  "percent: %g threads: %d idx: %d expected %g/%d received"
+                  " %g/%d", percent[p], threads[t], i, mp[i], mpi[i], tmp[i],
+                  tmpi[i]);
+      }
+      free(tmp);
+      free(tmpi);
+    }
+    free(mp);
+    free(mpi);
+  }
+  mu_assert_rv(0, sa_mp_threads_time_series_int(ts, 0, len, 60, 100, 0, &mp,
+                                                &mpi));
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_mp_workspace_time_series_int()
+{
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  sa_time_series_int *ts = sa_create_time_series_int(len, 1);
+  mu_assert(ts, "creation failed");
+
+  for (size_t i = 0; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  mu_assert(!sa_create_mp_workspace(16, 3, 1), "created m < 4");
+  mu_assert(!sa_create_mp_workspace(16, 5, 1), "created n / 4 < m");
+  sa_mp_workspace *ws = sa_create_mp_workspace(len + 1, 60, 1);
+  mu_assert(ws, "creation failed");
+  const double *wmp;
+  const int *wmpi;
+  mu_assert_rv(0, sa_mp_workspace_time_series_int(ts, ws, 0, 100, 1, &wmp,
+                                                  &wmpi));
+  sa_destroy_mp_workspace(ws);
+  sa_destroy_mp_workspace(NULL);
+
+  int n = 1440, m = 60;
+  sa_mp_workspace *ws1 = sa_create_mp_workspace(n, m, 42);
+  sa_mp_workspace *ws2 = sa_create_mp_workspace(n, m, 42);
+  sa_mp_workspace *ws3 = sa_create_mp_workspace(n, m, 7);
+  mu_assert(ws1 && ws2 && ws3, "creation failed");
+  mu_assert_rv(0, sa_mp_workspace_time_series_int(ts, ws1, 0, 0, 1, &wmp,
+                                                  &wmpi));
+  mu_assert_rv(0, sa_mp_workspace_time_series_int(ts, ws1, 0, 100, 0, &wmp,
+                                                  &wmpi));
+
+  // same seed, same result irrespective of the thread count or rand() state
+  const double *tmp;
+  const int *tmpi;
+  int mp_len = n - m + 1;
+  for (int r = 0; r < 2; ++r) {
+    srand(r);
+    mu_assert_rv(mp_len, sa_mp_workspace_time_series_int(ts, ws1, 0, 10, 1,
+                                                         &wmp, &wmpi));
+    mu_assert_rv(mp_len, sa_mp_workspace_time_series_int(ts, ws2, 0, 10, 3,
+                                                         &tmp, &tmpi));
+    for (int i = 0; i < mp_len; ++i) {
+      mu_assert(wmp[i] == tmp[i] && wmpi[i] == tmpi[i],
+                "run: %d idx: %d expected %g/%d received %g/%d", r, i, wmp[i],
+                wmpi[i], tmp[i], tmpi[i]);
+    }
+    sa_seed_mp_workspace(ws1, 42);
+    sa_seed_mp_workspace(ws2, 42);
+  }
+
+  // a different seed visits a different set of diagonals
+  mu_assert_rv(mp_len, sa_mp_workspace_time_series_int(ts, ws3, 0, 10, 1,
+                                                       &tmp, &tmpi));
+  int diff = 0;
+  for (int i = 0; i < mp_len; ++i) {
+    if (wmp[i] != tmp[i]) {++diff;}
+  }
+  mu_assert(diff > 0, "seeds 42 and 7 produced the same profile");
+
+  // complete profiles match the allocating API and the workspace is reusable
+  // across intervals
+  const uint64_t ns[] = { 0, 1000, 37 };
+  for (int j = 0; j < 3; ++j) {
+    double *mp;
+    int *mpi;
+    mu_assert_rv(mp_len, sa_mp_time_series_int(ts, ns[j], n, m, 100, &mp,
+                                               &mpi));
+    mu_assert_rv(mp_len, sa_mp_workspace_time_series_int(ts, ws3, ns[j], 100,
+                                                         2, &tmp, &tmpi));
+    for (int i = 0; i < mp_len; ++i) {
+      mu_assert(fabs(mp[i] - tmp[i]) < 1e-9 && mpi[i] == tmpi[i],
+                "ns: %" PRIu64 " idx: %d expected %g/%d received %g/%d",
+                ns[j], i, mp[i], mpi[i], tmp[i], tmpi[i]);
+    }
+    free(mp);
+    free(mpi);
+  }
+
+  sa_destroy_mp_workspace(ws1);
+  sa_destroy_mp_workspace(ws2);
+  sa_destroy_mp_workspace(ws3);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static void anomaly_data(sa_time_series_int *ts, double *v, int n, int m)
+{
+  srand(3);
+  for (int i = 0; i < n; ++i) {
+    v[i] = 1000 * sin(2 * acos(-1.0) * i / 97) + rand() % 100;
+    if (i >= n / 3 && i < n / 3 + m / 2) {
+      v[i] = 200 + rand() % 100;
+    }
+    v[i] = (int)v[i];
+    sa_add_time_series_int(ts, i, (int)v[i]);
+  }
+}
+
+
+static char* test_mp_prescrimp_time_series_int()
+{
+  enum { n = 4096, m = 64 };
+  sa_time_series_int *ts = sa_create_time_series_int(n, 1);
+  mu_assert(ts, "creation failed");
+  double v[n];
+  anomaly_data(ts, v, n, m);
+
+  double *emp, *mp;
+  int *empi, *mpi;
+  int mp_len = n - m + 1;
+  mu_assert_rv(mp_len, sa_mp_time_series_int(ts, 0, n, m, 100, &emp, &empi));
+  srand(1);
+  mu_assert_rv(mp_len, sa_mp_time_series_int(ts, 0, n, m, 1, &mp, &mpi));
+  int ed = 0, d = 0;
+  double err = 0;
+  for (int i = 0; i < mp_len; ++i) {
+    // every entry is seeded with a real neighbor distance
+    double ev = znorm_distance(v + i, v + mpi[i], m);
+    mu_assert(fabs(mp[i] - ev) < 1e-6, "idx: %d expected %g received %g", i,
+              ev, mp[i]);
+    mu_assert(mp[i] >= emp[i] - 1e-6, "idx: %d exact %g received %g", i,
+              emp[i], mp[i]);
+    if (emp[i] > emp[ed]) {ed = i;}
+    if (mp[i] > mp[d]) {d = i;}
+    err += mp[i] - emp[i];
+  }
+  // random diagonals alone are ~0.07 at this budget
+  mu_assert(err / mp_len < 0.03, "mean error %g", err / mp_len);
+  mu_assert(abs(d - ed) <= m / 4 && mp[d] - emp[ed] < emp[ed] * 0.05,
+            "expected %d/%g received %d/%g", ed, emp[ed], d, mp[d]);
+  free(mp);
+  free(mpi);
+  free(emp);
+  free(empi);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_dp_time_series_int()
+{
+  const int rows = 256, n = 250, m = 16;
+  sa_time_series_int *ts = sa_create_time_series_int(rows, 1);
+  mu_assert(ts, "creation failed");
+
+  srand(5);
+  double v[400];
+  for (int i = 0; i < 400; ++i) {
+    v[i] = rand() % 100;
+    sa_add_time_series_int(ts, i, (int)v[i]);
+  }
+
+  // the window wraps the ring buffer, the queries are inside, before and at
+  // the end of it
+  int start = 400 - rows + 3;
+  int dp_len = n - m + 1;
+  sa_mp_workspace *ws = sa_create_mp_workspace(n, m, 0);
+  mu_assert(ws, "creation failed");
+  const int query[] = { 200, 145, 400 - m };
+  for (int q = 0; q < 3; ++q) {
+    double *dp;
+    const double *wdp;
+    mu_assert_rv(dp_len, sa_dp_time_series_int(ts, query[q], start, n, m,
+                                               &dp));
+    mu_assert_rv(dp_len, sa_dp_workspace_time_series_int(ts, ws, query[q],
+                                                         start, &wdp));
+    for (int i = 0; i < dp_len; ++i) {
+      double ev = znorm_distance(v + query[q], v + start + i, m);
+      mu_assert(fabs(dp[i] - ev) < 1e-6 && dp[i] == wdp[i],
+                "query: %d idx: %d expected %g received %g/%g", query[q], i,
+                ev, dp[i], wdp[i]);
+    }
+    free(dp);
+  }
+
+  const double *wdp;
+  mu_assert_rv(0, sa_dp_workspace_time_series_int(ts, ws, 400 - m + 1, start,
+                                                  &wdp));
+  mu_assert_rv(0, sa_dp_workspace_time_series_int(ts, ws, 143, start, &wdp));
+  mu_assert_rv(0, sa_dp_workspace_time_series_int(ts, ws, 200, 143, &wdp));
+  sa_destroy_mp_workspace(ws);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* test_mp_discords()
+{
+  const double mp[] = { 1, 2, 9, 3, 8.8, 1, 8.5, 1, 1, 1, 7, 1, 1, 1, 1, 1, 1,
+    1, 1, 6 };
+  int len = sizeof(mp) / sizeof(double);
+  sa_mp_discord d[10];
+  double p50, p95;
+  mu_assert_rv(3, sa_mp_discords(mp, len, 3, 3, d, &p50, &p95));
+  // 8.8 overlaps the top discord
+  const int eidx[] = { 2, 6, 10 };
+  for (int i = 0; i < 3; ++i) {
+    mu_assert(d[i].idx == eidx[i] && d[i].distance == mp[eidx[i]],
+              "discord: %d expected %d received %d/%g", i, eidx[i], d[i].idx,
+              d[i].distance);
+  }
+
+  sa_p2_quantile *q50 = sa_create_p2_quantile(0.50);
+  sa_p2_quantile *q95 = sa_create_p2_quantile(0.95);
+  double e50 = 0, e95 = 0;
+  for (int i = 0; i < len; ++i) {
+    e50 = sa_add_p2_quantile(q50, mp[i]);
+    e95 = sa_add_p2_quantile(q95, mp[i]);
+  }
+  sa_destroy_p2_quantile(q50);
+  sa_destroy_p2_quantile(q95);
+  mu_assert(p50 == e50 && p95 == e95, "expected %g/%g received %g/%g", e50,
+            e95, p50, p95);
+
+  int found = sa_mp_discords(mp, len, 3, 10, d, NULL, NULL);
+  mu_assert(found > 3 && found < 10, "received %d", found);
+  for (int i = 1; i < found; ++i) {
+    mu_assert(d[i].distance <= d[i - 1].distance, "discord: %d", i);
+    for (int j = 0; j < i; ++j) {
+      mu_assert(abs(d[i].idx - d[j].idx) >= 3, "discords: %d/%d", i, j);
+    }
+  }
+  mu_assert_rv(0, sa_mp_discords(mp, len, 3, 0, NULL, &p50, &p95));
+  mu_assert(p50 == e50 && p95 == e95, "expected %g/%g received %g/%g", e50,
+            e95, p50, p95);
+  return NULL;
+}
+
+
+static char* test_mmp_time_series_int()
+{
+  enum { d = 3, rows = 128, n = 120, m = 8 };
+  sa_time_series_int *ts[d];
+  sa_matrix_int *mat = sa_create_matrix_int(d, n);
+  mu_assert(mat, "creation failed");
+  double v[d][rows + 20];
+  srand(11);
+  for (int k = 0; k < d; ++k) {
+    ts[k] = sa_create_time_series_int(rows, 1);
+    mu_assert(ts[k], "creation failed");
+    for (int i = 0; i < rows + 20; ++i) {
+      v[k][i] = rand() % 100;
+      sa_add_time_series_int(ts[k], i, (int)v[k][i]);
+    }
+  }
+
+  // the window wraps the ring buffer
+  int start = 20 + 5;
+  for (int k = 0; k < d; ++k) {
+    for (int x = 0; x < n; ++x) {
+      sa_set_matrix_int(mat, k, x, (int)v[k][start + x]);
+    }
+  }
+
+  double *mp, *tmp;
+  int *mpi, *tmpi;
+  int mp_len = n - m + 1;
+  mu_assert_rv(mp_len, sa_mmp_time_series_int(ts, d, start, n, m, 1, &mp,
+                                              &mpi));
+  for (int i = 0; i < mp_len; ++i) {
+    double ev[d] = { INFINITY, INFINITY, INFINITY };
+    for (int j = 0; j < mp_len; ++j) {
+      if (abs(i - j) <= m / 4) {continue;}
+      double dist[d];
+      for (int k = 0; k < d; ++k) {
+        dist[k] = znorm_distance(v[k] + start + i, v[k] + start + j, m);
+      }
+      qsort(dist, d, sizeof(double), cmp_double);
+      double sum = 0;
+      for (int k = 0; k < d; ++k) {
+        sum += dist[k];
+        if (sum / (k + 1) < ev[k]) {ev[k] = sum / (k + 1);}
+      }
+    }
+    for (int k = 0; k < d; ++k) {
+      mu_assert(fabs(mp[k * mp_len + i] - ev[k]) < 1e-6,
+                "dimensions: %d idx: %d expected %g received %g", k + 1, i,
+                ev[k], mp[k * mp_len + i]);
+    }
+  }
+
+  const int threads[] = { 2, 3, 5 };
+  for (int t = 0; t < 3; ++t) {
+    mu_assert_rv(mp_len, sa_mmp_time_series_int(ts, d, start, n, m,
+                                                threads[t], &tmp, &tmpi));
+    for (int i = 0; i < mp_len * d; ++i) {
+      mu_assert(mp[i] == tmp[i] && mpi[i] == tmpi[i],
+                "threads: %d idx: %d expected %g/%d received %g/%d",
+                threads[t], i, mp[i], mpi[i], tmp[i], tmpi[i]);
+    }
+    free(tmp);
+    free(tmpi);
+  }
+
+  mu_assert_rv(mp_len, sa_mmp_matrix_int(mat, m, 2, &tmp, &tmpi));
+  for (int i = 0; i < mp_len * d; ++i) {
+    mu_assert(mp[i] == tmp[i] && mpi[i] == tmpi[i],
+              "matrix idx: %d expected %g/%d received %g/%d", i, mp[i], mpi[i],
+              tmp[i], tmpi[i]);
+  }
+  free(tmp);
+  free(tmpi);
+
+  // a single dimension is the matrix profile
+  mu_assert_rv(mp_len, sa_mp_time_series_int(ts[1], start, n, m, 100, &tmp,
+                                             &tmpi));
+  free(mp);
+  free(mpi);
+  mu_assert_rv(mp_len, sa_mmp_time_series_int(ts + 1, 1, start, n, m, 1, &mp,
+                                              &mpi));
+  for (int i = 0; i < mp_len; ++i) {
+    mu_assert(fabs(mp[i] - tmp[i]) < 1e-9, "idx: %d expected %g received %g",
+              i, tmp[i], mp[i]);
+  }
+  free(tmp);
+  free(tmpi);
+  free(mp);
+  free(mpi);
+
+  mu_assert_rv(0, sa_mmp_time_series_int(ts, 0, start, n, m, 1, &mp, &mpi));
+  mu_assert_rv(0, sa_mmp_time_series_int(ts, d, 19, n, m, 1, &mp,
+                                         &mpi));
+  mu_assert_rv(0, sa_mmp_matrix_int(mat, n / 4 + 1, 1, &mp, &mpi));
+  sa_time_series_int *other = sa_create_time_series_int(rows, 2);
+  sa_time_series_int *mixed[] = { ts[0], other };
+  mu_assert_rv(0, sa_mmp_time_series_int(mixed, 2, 0, n, m, 1, &mp, &mpi));
+  sa_destroy_time_series_int(other);
+  for (int k = 0; k < d; ++k) {
+    sa_destroy_time_series_int(ts[k]);
+  }
+  sa_destroy_matrix_int(mat);
+  return NULL;
+}
+
+
+static char* test_mp_join_time_series_int()
+{
+  enum { arows = 128, brows = 100, na = 100, nb = 80, m = 8 };
+  sa_time_series_int *a = sa_create_time_series_int(arows, 1);
+  sa_time_series_int *b = sa_create_time_series_int(brows, 1);
+  mu_assert(a && b, "creation failed");
+  double va[arows + 40], vb[brows];
+  srand(13);
+  for (int i = 0; i < arows + 40; ++i) {
+    va[i] = rand() % 100;
+    sa_add_time_series_int(a, i, (int)va[i]);
+  }
+  for (int i = 0; i < brows; ++i) {
+    vb[i] = rand() % 100;
+    sa_add_time_series_int(b, i, (int)vb[i]);
+  }
+
+  // the a window wraps the ring buffer
+  int astart = 60, bstart = 10, la = na - m + 1, lb = nb - m + 1;
+  double *mp, *tmp;
+  int *mpi, *tmpi;
+  mu_assert_rv(la, sa_mp_join_time_series_int(a, astart, na, b, bstart, nb, m,
+                                               1, &mp, &mpi));
+  for (int i = 0; i < la; ++i) {
+    double ev = INFINITY;
+    for (int j = 0; j < lb; ++j) {
+      double d = znorm_distance(va + astart + i, vb + bstart + j, m);
+      if (d < ev) {ev = d;}
+    }
+    mu_assert(fabs(mp[i] - ev) < 1e-6, "idx: %d expected %g received %g", i,
+              ev, mp[i]);
+    double d = znorm_distance(va + astart + i, vb + bstart + mpi[i], m);
+    mu_assert(fabs(mp[i] - d) < 1e-6, "idx: %d mpi: %d expected %g received %g",
+              i, mpi[i], d, mp[i]);
+  }
+
+  const int threads[] = { 2, 3, 7 };
+  for (int t = 0; t < 3; ++t) {
+    mu_assert_rv(la, sa_mp_join_time_series_int(a, astart, na, b, bstart, nb,
+                                                 m, threads[t], &tmp, &tmpi));
+    for (int i = 0; i < la; ++i) {
+      mu_assert(mp[i] == tmp[i] && mpi[i] == tmpi[i],
+                "threads: %d idx: %d expected %g/%d received %g/%d",
+                threads[t], i, mp[i], mpi[i], tmp[i], tmpi[i]);
+    }
+    free(tmp);
+    free(tmpi);
+  }
+  free(mp);
+  free(mpi);
+
+  // a range joined with itself finds the trivial matches
+  mu_assert_rv(la, sa_mp_join_time_series_int(a, astart, na, a, astart, na, m,
+                                               2, &mp, &mpi));
+  for (int i = 0; i < la; ++i) {
+    mu_assert(mp[i] < 1e-6 && mpi[i] == i, "idx: %d received %g/%d", i, mp[i],
+              mpi[i]);
+  }
+  free(mp);
+  free(mpi);
+
+  // a single b sub-sequence is a distance profile lookup
+  mu_assert_rv(la, sa_mp_join_time_series_int(a, astart, na, b, bstart, m, m,
+                                               1, &mp, &mpi));
+  mu_assert(mpi[0] == 0, "received %d", mpi[0]);
+  free(mp);
+  free(mpi);
+
+  mu_assert_rv(0, sa_mp_join_time_series_int(a, astart, na, b, bstart, nb, 3,
+                                              1, &mp, &mpi));
+  mu_assert_rv(0, sa_mp_join_time_series_int(a, astart, na, b, bstart, m - 1,
+                                              m, 1, &mp, &mpi));
+  mu_assert_rv(0, sa_mp_join_time_series_int(a, astart, arows + 1, b, bstart,
+                                              nb, m, 1, &mp, &mpi));
+  mu_assert_rv(0, sa_mp_join_time_series_int(a, 39, na, b, bstart, nb, m, 1,
+                                              &mp, &mpi));
+  mu_assert_rv(0, sa_mp_join_time_series_int(a, astart, na, b, bstart, nb, m,
+                                              0, &mp, &mpi));
+  sa_destroy_time_series_int(a);
+  sa_destroy_time_series_int(b);
+  return NULL;
+}
+
+
 static char* benchmark_add_time_series_int()
 {
   int iter = 1000000;
@@ -829,6 +2100,154 @@ static char* benchmark_add_time_series_int()
 }
 
 
+static char* benchmark_add_batch_time_series_int()
+{
+  enum { batch = 1000 };
+  int iter = 1000000;
+  uint64_t ns[batch];
+  int v[batch];
+
+  sa_time_series_int *ts = sa_create_time_series_int(2, 1000);
+  mu_assert(ts, "creation failed");
+
+  clock_t t = clock();
+  for (int x = 0; x < iter; x += batch) {
+    for (int i = 0; i < batch; ++i) {
+      ns[i] = x + i;
+      v[i] = x + i;
+    }
+    sa_add_time_series_int_batch(ts, ns, v, batch);
+  }
+  t = clock() - t;
+  sa_destroy_time_series_int(ts);
+  printf("benchmark add_time_series_int_batch: %g\n",
+         ((double)t) / CLOCKS_PER_SEC / iter);
+
+  // out of order events interleaved round robin over a few rows
+  ts = sa_create_time_series_int(60, 1000);
+  mu_assert(ts, "creation failed");
+  for (int i = 0; i < batch; ++i) {
+    ns[i] = 100000 + (3 - i % 4) * 1000 + i % 7;
+    v[i] = i % 3;
+  }
+  t = clock();
+  for (int x = 0; x < iter; x += batch) {
+    sa_add_time_series_int_batch(ts, ns, v, batch);
+  }
+  t = clock() - t;
+  printf("benchmark add_time_series_int_batch interleaved: %g\n",
+         ((double)t) / CLOCKS_PER_SEC / iter);
+
+  t = clock();
+  for (int x = 0; x < iter; x += batch) {
+    for (int i = 0; i < batch; ++i) {
+      sa_add_time_series_int(ts, ns[i], v[i]);
+    }
+  }
+  t = clock() - t;
+  sa_destroy_time_series_int(ts);
+  printf("benchmark add_time_series_int interleaved: %g\n",
+         ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
+static char* benchmark_rollup_time_series_int()
+{
+  int iter = 1000000;
+  const int rows[] = { 60, 60, 24 };
+  const uint64_t ns_per_row[] = { 1000, 60000, 3600000 };
+
+  sa_rollup_time_series_int *rts = sa_create_rollup_time_series_int(
+      3, rows, ns_per_row, SA_ROLLUP_MAX);
+  mu_assert(rts, "creation failed");
+
+  clock_t t = clock();
+  for (int x = 0; x < iter; ++x) {
+    sa_add_rollup_time_series_int(rts, x, x % 1000);
+  }
+  t = clock() - t;
+  sa_destroy_rollup_time_series_int(rts);
+  printf("benchmark rollup_time_series: %g\n", ((double)t) / CLOCKS_PER_SEC
+         / iter);
+  return NULL;
+}
+
+
+static char* benchmark_merge_time_series_int()
+{
+  int iter = 10000;
+  int rows = 1440;
+
+  sa_time_series_int *ts = sa_create_time_series_int(rows, 1);
+  sa_time_series_int *ts1 = sa_create_time_series_int(rows, 1);
+  mu_assert(ts && ts1, "creation failed");
+  for (int i = 0; i < rows; ++i) {
+    sa_add_time_series_int(ts1, i + rows / 2, i);
+  }
+
+  clock_t t = clock();
+  for (int x = 0; x < iter; ++x) {
+    sa_merge_time_series_int(ts, ts1, SA_MERGE_ADD);
+  }
+  t = clock() - t;
+  sa_destroy_time_series_int(ts);
+  sa_destroy_time_series_int(ts1);
+  printf("benchmark merge_time_series: %g\n", ((double)t) / CLOCKS_PER_SEC
+         / iter);
+  return NULL;
+}
+
+
+static char* benchmark_window_time_series_int()
+{
+  int iter = 1000000;
+
+  sa_time_series_int *ts = sa_create_windowed_time_series_int(86400, 1, 3600);
+  mu_assert(ts, "creation failed");
+
+  sa_running_stats rs;
+  int min, max;
+  clock_t t = clock();
+  for (int x = 0; x < iter; ++x) {
+    sa_add_time_series_int(ts, 86400 + x / 4, x % 1000);
+    sa_window_stats_time_series_int(ts, &rs, &min, &max);
+  }
+  t = clock() - t;
+  sa_destroy_time_series_int(ts);
+  printf("benchmark window add/stats: %g\n", ((double)t) / CLOCKS_PER_SEC
+         / iter);
+  return NULL;
+}
+
+
+static char* benchmark_range_time_series_int()
+{
+  int iter = 1000;
+  sa_time_series_int *ts[2] = {
+    sa_create_time_series_int(86400, 1),
+    sa_create_indexed_time_series_int(86400, 1, 0)
+  };
+  mu_assert(ts[0] && ts[1], "creation failed");
+
+  for (int i = 0; i < 2; ++i) {
+    for (int x = 0; x < 86400; ++x) {
+      sa_set_time_series_int(ts[i], 86400 + x, x % 1000);
+    }
+    sa_range_stats_int r;
+    clock_t t = clock();
+    for (int x = 0; x < iter; ++x) {
+      sa_range_stats_time_series_int(ts[i], 86400 + x, 86400 - x, &r);
+    }
+    t = clock() - t;
+    printf("benchmark range_stats %s: %g\n", i ? "indexed" : "scan",
+           ((double)t) / CLOCKS_PER_SEC / iter);
+    sa_destroy_time_series_int(ts[i]);
+  }
+  return NULL;
+}
+
+
 static char* benchmark_mp_int()
 {
   size_t len =  sizeof(benchmark) / sizeof(double);
@@ -859,16 +2278,315 @@ static char* benchmark_mp_int()
 }
 
 
+static char* benchmark_mp_threads_int()
+{
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  sa_time_series_int *ts = sa_create_time_series_int(len + 1, 1);
+  mu_assert(ts, "creation failed");
+
+  for (size_t i = 0; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  double *mp;
+  int *mpi;
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    struct timespec b, e;
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    int mp_len = sa_mp_threads_time_series_int(ts, 0, len, 60, 100, threads,
+                                               &mp, &mpi);
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    printf("benchmark mp_int threads %d: %g\n", threads,
+           (e.tv_sec - b.tv_sec) + (e.tv_nsec - b.tv_nsec) / 1e9);
+    mu_assert(mp_len == (int)len - 60 + 1, "received %d", mp_len);
+    free(mp);
+    free(mpi);
+  }
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* benchmark_mp_workspace_int()
+{
+  int iter = 1000, n = 256, m = 16;
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  sa_time_series_int *ts = sa_create_time_series_int(len, 1);
+  mu_assert(ts, "creation failed");
+
+  for (size_t i = 0; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  double *mp;
+  int *mpi;
+  clock_t t = clock();
+  for (int x = 0; x < iter; ++x) {
+    mu_assert_rv(n - m + 1, sa_mp_time_series_int(ts, x * 8, n, m, 100, &mp,
+                                                  &mpi));
+    free(mp);
+    free(mpi);
+  }
+  t = clock() - t;
+  printf("benchmark mp_int small: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+
+  sa_mp_workspace *ws = sa_create_mp_workspace(n, m, 1);
+  mu_assert(ws, "creation failed");
+  const double *wmp;
+  const int *wmpi;
+  t = clock();
+  for (int x = 0; x < iter; ++x) {
+    mu_assert_rv(n - m + 1, sa_mp_workspace_time_series_int(ts, ws, x * 8, 100,
+                                                            1, &wmp, &wmpi));
+  }
+  t = clock() - t;
+  printf("benchmark mp_workspace_int small: %g\n",
+         ((double)t) / CLOCKS_PER_SEC / iter);
+  sa_destroy_mp_workspace(ws);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* benchmark_mp_convergence_int()
+{
+  enum { n = 16384, m = 256 };
+  sa_time_series_int *ts = sa_create_time_series_int(n, 1);
+  mu_assert(ts, "creation failed");
+  static double v[n];
+  anomaly_data(ts, v, n, m);
+
+  double *emp, *mp;
+  int *empi, *mpi;
+  int mp_len = n - m + 1;
+  clock_t t = clock();
+  mu_assert_rv(mp_len, sa_mp_time_series_int(ts, 0, n, m, 100, &emp, &empi));
+  t = clock() - t;
+  int ed = 0;
+  for (int i = 0; i < mp_len; ++i) {
+    if (emp[i] > emp[ed]) {ed = i;}
+  }
+  printf("benchmark mp_int convergence exact: %g discord: %d/%g\n",
+         ((double)t) / CLOCKS_PER_SEC, ed, emp[ed]);
+
+  const double percent[] = { 0.5, 1, 2, 5, 10, 25 };
+  for (int p = 0; p < 6; ++p) {
+    t = clock();
+    mu_assert_rv(mp_len, sa_mp_time_series_int(ts, 0, n, m, percent[p], &mp,
+                                               &mpi));
+    t = clock() - t;
+    double err = 0;
+    int d = 0;
+    for (int i = 0; i < mp_len; ++i) {
+      err += mp[i] - emp[i];
+      if (mp[i] > mp[d]) {d = i;}
+    }
+    printf("benchmark mp_int convergence percent %g: %g mean error: %g "
+           "discord: %d/%g\n", percent[p], ((double)t) / CLOCKS_PER_SEC,
+           err / mp_len, d, mp[d]);
+    free(mp);
+    free(mpi);
+  }
+  free(emp);
+  free(empi);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* benchmark_dp_int()
+{
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  sa_time_series_int *ts = sa_create_time_series_int(len, 1);
+  mu_assert(ts, "creation failed");
+
+  for (size_t i = 0; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  double *dp;
+  clock_t t = clock();
+  int dp_len = sa_dp_time_series_int(ts, len - 60, 0, len, 60, &dp);
+  t = clock() - t;
+  printf("benchmark dp_int: %g\n", ((double)t) / CLOCKS_PER_SEC);
+  mu_assert(dp_len == (int)len - 60 + 1, "received %d", dp_len);
+  free(dp);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* benchmark_mp_discords()
+{
+  enum { len = 100000 };
+  static double mp[len];
+  srand(1);
+  for (int i = 0; i < len; ++i) {
+    mp[i] = rand() % 1000 / 100.0;
+  }
+
+  int iter = 100;
+  sa_mp_discord d[5];
+  double p50, p95;
+  clock_t t = clock();
+  for (int x = 0; x < iter; ++x) {
+    mu_assert_rv(5, sa_mp_discords(mp, len, 60, 5, d, &p50, &p95));
+  }
+  t = clock() - t;
+  printf("benchmark mp_discords: %g\n", ((double)t) / CLOCKS_PER_SEC / iter);
+  return NULL;
+}
+
+
+static char* benchmark_mmp_int()
+{
+  enum { d = 8, n = 1440, m = 60 };
+  sa_time_series_int *ts[d];
+  for (int k = 0; k < d; ++k) {
+    ts[k] = sa_create_time_series_int(n, 1);
+    mu_assert(ts[k], "creation failed");
+    for (int i = 0; i < n; ++i) {
+      sa_add_time_series_int(ts[k], i, benchmark[k * n + i]);
+    }
+  }
+
+  double *mp;
+  int *mpi;
+  clock_t t = clock();
+  for (int k = 0; k < d; ++k) {
+    mu_assert_rv(n - m + 1, sa_mp_time_series_int(ts[k], 0, n, m, 100, &mp,
+                                                  &mpi));
+    free(mp);
+    free(mpi);
+  }
+  t = clock() - t;
+  printf("benchmark mp_int %d dimensions separately: %g\n", d,
+         ((double)t) / CLOCKS_PER_SEC);
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    struct timespec b, e;
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    mu_assert_rv(n - m + 1, sa_mmp_time_series_int(ts, d, 0, n, m, threads,
+                                                   &mp, &mpi));
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    printf("benchmark mmp_int %d dimensions threads %d: %g\n", d, threads,
+           (e.tv_sec - b.tv_sec) + (e.tv_nsec - b.tv_nsec) / 1e9);
+    free(mp);
+    free(mpi);
+  }
+  for (int k = 0; k < d; ++k) {
+    sa_destroy_time_series_int(ts[k]);
+  }
+  return NULL;
+}
+
+
+static char* benchmark_mp_join_int()
+{
+  enum { n = 1440, m = 60 };
+  sa_time_series_int *ts = sa_create_time_series_int(2 * n, 1);
+  mu_assert(ts, "creation failed");
+  for (int i = 0; i < 2 * n; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+
+  // yesterday against today
+  double *mp;
+  int *mpi;
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    struct timespec b, e;
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    mu_assert_rv(n - m + 1, sa_mp_join_time_series_int(ts, 0, n, ts, n, n, m,
+                                                       threads, &mp, &mpi));
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    printf("benchmark mp_join_int threads %d: %g\n", threads,
+           (e.tv_sec - b.tv_sec) + (e.tv_nsec - b.tv_nsec) / 1e9);
+    free(mp);
+    free(mpi);
+  }
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
+static char* benchmark_mp_stream_int()
+{
+  size_t len =  sizeof(benchmark) / sizeof(double);
+  int n = 1440, m = 60;
+  sa_time_series_int *ts = sa_create_time_series_int(2048, 1);
+  mu_assert(ts, "creation failed");
+  sa_mp_stream_int *mps = sa_create_mp_stream_int(ts, n, m);
+  mu_assert(mps, "creation failed");
+
+  for (int i = 0; i < 2048; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+  }
+  sa_update_mp_stream_int(mps);
+
+  clock_t t = clock();
+  for (size_t i = 2048; i < len; ++i) {
+    sa_add_time_series_int(ts, i, benchmark[i]);
+    sa_update_mp_stream_int(mps);
+  }
+  t = clock() - t;
+  printf("benchmark mp_stream_int update: %g\n",
+         ((double)t) / CLOCKS_PER_SEC / (len - 2048));
+
+  double *mp;
+  int *mpi;
+  t = clock();
+  int mp_len = sa_mp_time_series_int(ts, len - 1 - n, n, m, 100, &mp, &mpi);
+  t = clock() - t;
+  printf("benchmark mp_int recompute: %g\n", ((double)t) / CLOCKS_PER_SEC);
+  mu_assert(mp_len == n - m + 1, "received %d", mp_len);
+  free(mp);
+  free(mpi);
+  sa_destroy_mp_stream_int(mps);
+  sa_destroy_time_series_int(ts);
+  return NULL;
+}
+
+
 static char* all_tests()
 {
   mu_run_test(test_stub);
   mu_run_test(test_create_time_series_int);
   mu_run_test(test_time_series_int);
+  mu_run_test(test_ring_time_series_int);
+  mu_run_test(test_batch_time_series_int);
+  mu_run_test(test_rollup_time_series_int);
+  mu_run_test(test_merge_time_series_int);
   mu_run_test(test_mp_time_series_int);
+  mu_run_test(test_mp_reference_time_series_int);
+  mu_run_test(test_mp_threads_time_series_int);
+  mu_run_test(test_mp_workspace_time_series_int);
+  mu_run_test(test_mp_prescrimp_time_series_int);
+  mu_run_test(test_dp_time_series_int);
+  mu_run_test(test_mp_discords);
+  mu_run_test(test_mmp_time_series_int);
+  mu_run_test(test_mp_join_time_series_int);
+  mu_run_test(test_mp_stream_time_series_int);
+  mu_run_test(test_window_time_series_int);
+  mu_run_test(test_window_precision_time_series_int);
+  mu_run_test(test_range_time_series_int);
+  mu_run_test(test_typed_time_series);
   mu_run_test(test_serialize_time_series_int);
 
   mu_run_test(benchmark_add_time_series_int);
+  mu_run_test(benchmark_add_batch_time_series_int);
+  mu_run_test(benchmark_rollup_time_series_int);
+  mu_run_test(benchmark_merge_time_series_int);
+  mu_run_test(benchmark_window_time_series_int);
+  mu_run_test(benchmark_range_time_series_int);
   mu_run_test(benchmark_mp_int);
+  mu_run_test(benchmark_mp_threads_int);
+  mu_run_test(benchmark_mp_workspace_int);
+  mu_run_test(benchmark_mp_convergence_int);
+  mu_run_test(benchmark_dp_int);
+  mu_run_test(benchmark_mp_discords);
+  mu_run_test(benchmark_mmp_int);
+  mu_run_test(benchmark_mp_join_int);
+  mu_run_test(benchmark_mp_stream_int);
   return NULL;
 }
 
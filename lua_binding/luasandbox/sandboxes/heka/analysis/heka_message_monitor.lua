@@ -496,7 +496,7 @@ local function process_entry(ns, f, value, entry)
                     -- just one histogram for data collection
                     -- (i.e. old data will go into the current interval)
                     entry.subtype = "range"
-                    entry.p2 = p2.histogram(histogram_buckets)
+                    entry.p2 = p2.histogram(histogram_buckets, "float")
                     entry.data = matrix.new(samples, histogram_buckets, "float")
                     entry.counts = matrix.new(samples, 1)
                 else
@@ -541,7 +541,7 @@ local function process_entry(ns, f, value, entry)
             else
                 if entry.type == 2 or entry.type == 3 then
                     entry.subtype = "range"
-                    entry.p2 = p2.histogram(histogram_buckets)
+                    entry.p2 = p2.histogram(histogram_buckets, "float")
                     entry.data = matrix.new(samples, histogram_buckets, "float")
                     entry.counts = matrix.new(samples, 1)
                     for k,v in pairs(entry.values) do
@@ -25,7 +25,6 @@ static const char *g_flt_env  = "flt_env";
 #endif
 
 #include "p2.h"
-#include "running_stats.h"
 #include "matrix_impl.h"
 
 static const char *g_int_mt  = "trink.streaming_algorithms.matrix_int";
@@ -61,8 +60,7 @@ static int matrix_new(lua_State *lua)
   switch (luaL_checkoption(lua, 3, types[0], types)) {
   case 0:
     {
-      sa_matrix_int *m = lua_newuserdata(lua, sizeof(*m) +
-                                         sizeof(int) * rows * cols);
+      sa_matrix_int *m = lua_newuserdata(lua, MATRIX_INT_SIZE(rows, cols));
       m->rows = rows;
       m->cols = cols;
       sa_init_matrix_int(m);
@@ -71,8 +69,7 @@ static int matrix_new(lua_State *lua)
     break;
   case 1:
     {
-      sa_matrix_flt *m = lua_newuserdata(lua, sizeof(*m) +
-                                         sizeof(int) * rows * cols);
+      sa_matrix_flt *m = lua_newuserdata(lua, MATRIX_FLT_SIZE(rows, cols));
       m->rows = rows;
       m->cols = cols;
       sa_init_matrix_flt(m);
@@ -399,75 +396,6 @@ static int matrix_fromstring_flt(lua_State *lua)
 }
 
 
-static double pcc_int(sa_matrix_int *m, int r, int r1,
-                      sa_running_stats *rs1,
-                      sa_running_stats *rs2)
-{
-  double sd1 = sa_usd_running_stats(rs1);
-  double sd2 = sa_usd_running_stats(rs2);
-
-  if (sd1 == 0 || sd2 == 0) {return -INFINITY;}
-
-  double d = 0;
-  for (int i = 0; i < m->cols; ++i) {
-    int64_t ridx = (int64_t)r * m->cols;
-    int64_t r1idx = (int64_t)r1 * m->cols;
-    d += (double)m->v[ridx + i] * m->v[r1idx + i];
-  }
-  d = (d - m->cols * rs1->mean * rs2->mean) / (m->cols * sd1 * sd2);
-  return d;
-}
-
-
-static double pcc_flt(sa_matrix_flt *m, int r, int r1,
-                      sa_running_stats *rs1,
-                      sa_running_stats *rs2)
-{
-  double sd1 = sa_usd_running_stats(rs1);
-  double sd2 = sa_usd_running_stats(rs2);
-
-  if (sd1 == 0 || sd2 == 0) {return -INFINITY;}
-
-  double d = 0;
-  for (int i = 0; i < m->cols; ++i) {
-    int64_t ridx = (int64_t)r * m->cols;
-    int64_t r1idx = (int64_t)r1 * m->cols;
-    double tmp = (double)m->v[ridx + i] * m->v[r1idx + i];
-    if (!isnan(tmp)) {
-      d += tmp;
-    }
-  }
-  d = (d - m->cols * rs1->mean * rs2->mean) / (m->cols * sd1 * sd2);
-  return d;
-}
-
-
-static sa_running_stats getrs_int(sa_matrix_int *m, int row)
-{
-  sa_running_stats rs;
-  sa_init_running_stats(&rs);
-  for (int i = 0; i < m->cols; ++i) {
-    int64_t idx = (int64_t)row * m->cols;
-    sa_add_running_stats(&rs, m->v[idx + i]);
-  }
-  return rs;
-}
-
-
-static sa_running_stats getrs_flt(sa_matrix_flt *m, int row)
-{
-  sa_running_stats rs;
-  sa_init_running_stats(&rs);
-  for (int i = 0; i < m->cols; ++i) {
-    int64_t idx = (int64_t)row * m->cols;
-    float f = m->v[idx + i];
-    if (isnan(f)) {f = 0;}
-    sa_add_running_stats(&rs, f);
-  }
-  return rs;
-}
-
-
 static int matrix_pcc_int(lua_State *lua)
 {
   static const char *match_opts[] = { "max", "min", NULL };
@@ -477,35 +405,10 @@ static int matrix_pcc_int(lua_State *lua)
   --row;
   int match = luaL_checkoption(lua, 3, match_opts[0], match_opts);
 
-  double d = -INFINITY;
-  int idx = -1;
-  sa_running_stats rs = getrs_int(m, row);
-  switch (match) {
-  case 1:
-    d = INFINITY;
-    for (int i = 0; i < m->rows; ++i) {
-      if (i == row) {continue;}
-      sa_running_stats rs1 = getrs_int(m, i);
-      double tmp = pcc_int(m, row, i, &rs, &rs1);
-      if (tmp < d) {
-        d = tmp;
-        idx = i;
-      }
-    }
-    break;
-  default:
-    for (int i = 0; i < m->rows; ++i) {
-      if (i == row) {continue;}
-      sa_running_stats rs1 = getrs_int(m, i);
-      double tmp = pcc_int(m, row, i, &rs, &rs1);
-      if (tmp > d) {
-        d = tmp;
-        idx = i;
-      }
-    }
-    break;
-  }
-  if (!isfinite(d)) {return 0;}
+  double d;
+  int idx = sa_pcc_matrix_int(m, row, match == 1 ? SA_PCC_MIN : SA_PCC_MAX,
+                              &d);
+  if (idx == -1) {return 0;}
 
   lua_pushnumber(lua, d);
   lua_pushinteger(lua, idx + 1);
@@ -522,35 +425,10 @@ static int matrix_pcc_flt(lua_State *lua)
   --row;
   int match = luaL_checkoption(lua, 3, match_opts[0], match_opts);
 
-  double d = -INFINITY;
-  int idx = -1;
-  sa_running_stats rs = getrs_flt(m, row);
-  switch (match) {
-  case 1:
-    d = INFINITY;
-    for (int i = 0; i < m->rows; ++i) {
-      if (i == row) {continue;}
-      sa_running_stats rs1 = getrs_flt(m, i);
-      double tmp = pcc_flt(m, row, i, &rs, &rs1);
-      if (tmp < d) {
-        d = tmp;
-        idx = i;
-      }
-    }
-    break;
-  default:
-    for (int i = 0; i < m->rows; ++i) {
-      if (i == row) {continue;}
-      sa_running_stats rs1 = getrs_flt(m, i);
-      double tmp = pcc_flt(m, row, i, &rs, &rs1);
-      if (tmp > d) {
-        d = tmp;
-        idx = i;
-      }
-    }
-    break;
-  }
-  if (!isfinite(d)) {return 0;}
+  double d;
+  int idx = sa_pcc_matrix_flt(m, row, match == 1 ? SA_PCC_MIN : SA_PCC_MAX,
+                              &d);
+  if (idx == -1) {return 0;}
 
   lua_pushnumber(lua, d);
   lua_pushinteger(lua, idx + 1);
@@ -6,6 +6,8 @@
 
 /** @brief Lua streaming algorithms P2 binding @file */
 
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,13 +18,18 @@
 #include <luasandbox_output.h>
 #include <luasandbox_serialize.h>
 
-static const char *g_histogram_env  = "trink.histogram_env";
+static const char *g_histogram_env      = "trink.histogram_env";
+static const char *g_histogram_flt_env  = "trink.histogram_flt_env";
+static const char *g_window_env         = "trink.window_env";
 #endif
 
 #include "p2_impl.h"
 
 static const char *g_quantile_mt  = "trink.streaming_algorithms.p2.quantile";
 static const char *g_histogram_mt = "trink.streaming_algorithms.p2.histogram";
+static const char *g_histogram_flt_mt =
+    "trink.streaming_algorithms.p2.histogram_flt";
+static const char *g_window_mt    = "trink.streaming_algorithms.p2.window";
 
 static sa_p2_quantile* check_quantile(lua_State *lua, int args)
 {
@@ -125,25 +132,44 @@ static sa_p2_histogram* check_histogram(lua_State *lua, int args)
 
 static int histogram_new(lua_State *lua)
 {
+  static const char *types[] = { "double", "float", NULL };
   int n = lua_gettop(lua);
-  luaL_argcheck(lua, n == 1, 0, "incorrect number of arguments");
+  luaL_argcheck(lua, n >= 1 && n <= 2, 0, "incorrect number of arguments");
   double b = luaL_checknumber(lua, 1);
   luaL_argcheck(lua, 4 <= b && b < USHRT_MAX, 1, "4 <= buckets < 65535");
   unsigned short buckets = (unsigned short)b;
 
-  size_t nbytes = sizeof(sa_p2_histogram) + sizeof(double) * (buckets + 1) * 2;
-  sa_p2_histogram *p2h = lua_newuserdata(lua, nbytes);
-  p2h->b = (unsigned short)buckets;
-  sa_init_p2_histogram(p2h);
-
+  switch (luaL_checkoption(lua, 2, types[0], types)) {
+  case 0:
+    {
+      sa_p2_histogram *p2h = lua_newuserdata(lua, P2_HISTOGRAM_SIZE(buckets));
+      p2h->b = buckets;
+      sa_init_p2_histogram(p2h);
 #ifdef LUA_SANDBOX
-  lua_getfield(lua, LUA_ENVIRONINDEX, g_histogram_env);
-  if (!lua_setfenv(lua, -2)) {
-    luaL_error(lua, "failed to set the histogram environment");
-  }
+      lua_getfield(lua, LUA_ENVIRONINDEX, g_histogram_env);
+      if (!lua_setfenv(lua, -2)) {
+        luaL_error(lua, "failed to set the histogram environment");
+      }
 #endif
-
-  luaL_getmetatable(lua, g_histogram_mt);
+      luaL_getmetatable(lua, g_histogram_mt);
+    }
+    break;
+  case 1:
+    {
+      size_t size = P2_HISTOGRAM_FLT_SIZE(buckets);
+      sa_p2_histogram_flt *p2h = lua_newuserdata(lua, size);
+      p2h->b = buckets;
+      sa_init_p2_histogram_flt(p2h);
+#ifdef LUA_SANDBOX
+      lua_getfield(lua, LUA_ENVIRONINDEX, g_histogram_flt_env);
+      if (!lua_setfenv(lua, -2)) {
+        luaL_error(lua, "failed to set the histogram environment");
+      }
+#endif
+      luaL_getmetatable(lua, g_histogram_flt_mt);
+    }
+    break;
+  }
   lua_setmetatable(lua, -2);
   return 1;
 }
@@ -213,6 +239,212 @@ static int histogram_estimate(lua_State *lua)
 }
 
 
+static sa_p2_histogram_flt* check_histogram_flt(lua_State *lua, int args)
+{
+  sa_p2_histogram_flt *p2h = luaL_checkudata(lua, 1, g_histogram_flt_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return p2h;
+}
+
+
+static int histogram_tostring_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_p2_histogram_flt(p2h, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int histogram_fromstring_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_p2_histogram_flt(p2h, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+static int histogram_add_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 2);
+  double sample = luaL_checknumber(lua, 2);
+  sa_add_p2_histogram_flt(p2h, sample);
+  return 0;
+}
+
+
+static int histogram_clear_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 1);
+  sa_init_p2_histogram_flt(p2h);
+  return 0;
+}
+
+
+static int histogram_count_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 2);
+  double marker = luaL_checknumber(lua, 2);
+  luaL_argcheck(lua, marker >= 0 && marker <= p2h->b, 2,
+                "marker out of range");
+  unsigned long long cnt = sa_count_p2_histogram_flt(p2h,
+                                                     (unsigned short)marker);
+  lua_pushnumber(lua, (lua_Number)cnt);
+  return 1;
+}
+
+
+static int histogram_estimate_flt(lua_State *lua)
+{
+  sa_p2_histogram_flt *p2h = check_histogram_flt(lua, 2);
+  double marker = luaL_checknumber(lua, 2);
+  luaL_argcheck(lua, marker >= 0 && marker <= p2h->b, 2,
+                "marker out of range");
+  double e = sa_estimate_p2_histogram_flt(p2h, (unsigned short)marker);
+  lua_pushnumber(lua, e);
+  return 1;
+}
+
+
+static sa_p2_window* check_window(lua_State *lua, int args)
+{
+  sa_p2_window *p2w = luaL_checkudata(lua, 1, g_window_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return p2w;
+}
+
+
+static uint64_t check_ns(lua_State *lua, int idx)
+{
+  double d = luaL_checknumber(lua, idx);
+  luaL_argcheck(lua, d >= 0 && d <= UINT64_MAX, idx, "must be 0 - UINT64_MAX");
+  return (uint64_t)d;
+}
+
+
+static uint64_t check_start_ns(lua_State *lua, sa_p2_window *p2w, int idx)
+{
+  if (lua_isnil(lua, idx)) {
+    return p2w->current_time - p2w->ns_per_row * (p2w->rows - 1);
+  }
+  return check_ns(lua, idx);
+}
+
+
+static int window_new(lua_State *lua)
+{
+  int n = lua_gettop(lua);
+  luaL_argcheck(lua, n == 3, 0, "incorrect number of arguments");
+  int rows = luaL_checkint(lua, 1);
+  luaL_argcheck(lua, rows > 1, 1, "must be > 1");
+  double ns = luaL_checknumber(lua, 2);
+  luaL_argcheck(lua, ns > 0 && ns <= UINT64_MAX, 2, "must be 1 - UINT64_MAX");
+  double b = luaL_checknumber(lua, 3);
+  luaL_argcheck(lua, 4 <= b && b < USHRT_MAX, 3, "4 <= buckets < 65535");
+  unsigned short buckets = (unsigned short)b;
+
+  size_t nbytes = sizeof(sa_p2_window) + P2_HISTOGRAM_SIZE(buckets) * rows;
+  sa_p2_window *p2w = lua_newuserdata(lua, nbytes);
+  p2w->ns_per_row = (uint64_t)ns;
+  p2w->rows = rows;
+  p2w->b = buckets;
+  sa_init_p2_window(p2w);
+
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, g_window_env);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the window environment");
+  }
+#endif
+
+  luaL_getmetatable(lua, g_window_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int window_tostring(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_p2_window(p2w, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int window_fromstring(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_p2_window(p2w, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+static int window_add(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 3);
+  uint64_t ns = check_ns(lua, 2);
+  double sample = luaL_checknumber(lua, 3);
+  lua_pushboolean(lua, sa_add_p2_window(p2w, ns, sample) == 0);
+  return 1;
+}
+
+
+static int window_clear(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 1);
+  sa_init_p2_window(p2w);
+  return 0;
+}
+
+
+static int window_count(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 3);
+  uint64_t ns = check_start_ns(lua, p2w, 2);
+  int n = luaL_checkint(lua, 3);
+  luaL_argcheck(lua, n > 0 && n <= p2w->rows, 3, "invalid sequence length");
+  unsigned long long cnt = sa_count_p2_window(p2w, ns, n);
+  lua_pushnumber(lua, (lua_Number)cnt);
+  return 1;
+}
+
+
+static int window_estimate(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 4);
+  uint64_t ns = check_start_ns(lua, p2w, 2);
+  int n = luaL_checkint(lua, 3);
+  luaL_argcheck(lua, n > 0 && n <= p2w->rows, 3, "invalid sequence length");
+  double p = luaL_checknumber(lua, 4);
+  luaL_argcheck(lua, 0 <= p && p <= 1, 4, "0 <= quantile <= 1");
+  lua_pushnumber(lua, sa_estimate_p2_window(p2w, ns, n, p));
+  return 1;
+}
+
+
+static int window_current_time(lua_State *lua)
+{
+  sa_p2_window *p2w = check_window(lua, 1);
+  lua_pushnumber(lua, (lua_Number)sa_timestamp_p2_window(p2w));
+  return 1;
+}
+
+
 #ifdef LUA_SANDBOX
 static int serialize_quantile(lua_State *lua)
 {
@@ -280,6 +512,77 @@ static int serialize_histogram(lua_State *lua)
   }
   return 0;
 }
+
+
+static int serialize_histogram_flt(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_p2_histogram_flt *p2h = lua_touserdata(lua, -3);
+  if (!(ob && key && p2h)) {
+    return 1;
+  }
+  if (lsb_outputf(ob,
+                  "if %s == nil then %s ="
+                  " streaming_algorithms.p2.histogram(%hu, \"float\") end\n",
+                  key,
+                  key,
+                  p2h->b)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_p2_histogram_flt(p2h, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
+
+
+static int serialize_window(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_p2_window *p2w = lua_touserdata(lua, -3);
+  if (!(ob && key && p2w)) {
+    return 1;
+  }
+  if (lsb_outputf(ob,
+                  "if %s == nil then %s ="
+                  " streaming_algorithms.p2.window(%d, %" PRIu64 ", %hu)"
+                  " end\n",
+                  key,
+                  key,
+                  p2w->rows,
+                  p2w->ns_per_row,
+                  p2w->b)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_p2_window(p2w, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
 #endif
 
 
@@ -287,6 +590,7 @@ static const struct luaL_reg p2_f[] =
 {
   { "histogram", histogram_new },
   { "quantile", quantile_new },
+  { "window", window_new },
   { NULL, NULL }
 };
 
@@ -315,6 +619,31 @@ static const struct luaL_reg histogram_m[] =
 };
 
 
+static const struct luaL_reg histogram_flt_m[] =
+{
+  { "__tostring", histogram_tostring_flt },
+  { "add", histogram_add_flt },
+  { "clear", histogram_clear_flt },
+  { "count", histogram_count_flt },
+  { "estimate", histogram_estimate_flt },
+  { "fromstring", histogram_fromstring_flt },
+  { NULL, NULL }
+};
+
+
+static const struct luaL_reg window_m[] =
+{
+  { "__tostring", window_tostring },
+  { "add", window_add },
+  { "clear", window_clear },
+  { "count", window_count },
+  { "current_time", window_current_time },
+  { "estimate", window_estimate },
+  { "fromstring", window_fromstring },
+  { NULL, NULL }
+};
+
+
 int luaopen_streaming_algorithms_p2(lua_State *lua)
 {
 #ifdef LUA_SANDBOX
@@ -325,6 +654,14 @@ int luaopen_streaming_algorithms_p2(lua_State *lua)
   lsb_add_serialize_function(lua, serialize_histogram);
   lua_setfield(lua, -2, g_histogram_env);
 
+  lua_newtable(lua); // create a table for the float histogram environment
+  lsb_add_serialize_function(lua, serialize_histogram_flt);
+  lua_setfield(lua, -2, g_histogram_flt_env);
+
+  lua_newtable(lua); // create a table for the window userdata environment
+  lsb_add_serialize_function(lua, serialize_window);
+  lua_setfield(lua, -2, g_window_env);
+
   lua_replace(lua, LUA_ENVIRONINDEX);
 #endif
   luaL_newmetatable(lua, g_quantile_mt);
@@ -339,6 +676,18 @@ int luaopen_streaming_algorithms_p2(lua_State *lua)
   luaL_register(lua, NULL, histogram_m);
   lua_pop(lua, 1);
 
+  luaL_newmetatable(lua, g_histogram_flt_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, histogram_flt_m);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_window_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, window_m);
+  lua_pop(lua, 1);
+
   luaL_register(lua, "streaming_algorithms.p2", p2_f);
 
   // if necessary flag the parent table as non-data for preservation
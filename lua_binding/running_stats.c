@@ -6,6 +6,8 @@
 
 /** @brief Lua streaming algorithms running_stats binding @file */
 
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "lauxlib.h"
@@ -19,7 +21,18 @@
 #include "common.h"
 #include "running_stats.h"
 
+#ifdef LUA_SANDBOX
+static const char *g_moments_env = "trink.moments_env";
+static const char *g_bivariate_env = "trink.bivariate_env";
+static const char *g_ewma_env = "trink.ewma_env";
+#endif
+
 static const char *g_mt  = "trink.streaming_algorithms.running_stats";
+static const char *g_moments_mt =
+    "trink.streaming_algorithms.running_stats.moments";
+static const char *g_bivariate_mt =
+    "trink.streaming_algorithms.running_stats.bivariate";
+static const char *g_ewma_mt = "trink.streaming_algorithms.running_stats.ewma";
 
 static sa_running_stats* check_rs(lua_State *lua, int args)
 {
@@ -101,6 +114,15 @@ static int rs_count(lua_State *lua)
 }
 
 
+static int rs_merge(lua_State *lua)
+{
+  sa_running_stats *rs = check_rs(lua, 2);
+  sa_running_stats *rs1 = luaL_checkudata(lua, 2, g_mt);
+  sa_merge_running_stats(rs, rs1);
+  return 0;
+}
+
+
 static int rs_sd(lua_State *lua)
 {
   sa_running_stats *rs = check_rs(lua, 1);
@@ -125,6 +147,384 @@ static int rs_variance(lua_State *lua)
 }
 
 
+static sa_moment_stats* check_moments(lua_State *lua, int args)
+{
+  sa_moment_stats *ms = luaL_checkudata(lua, 1, g_moments_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return ms;
+}
+
+
+static int moments_new(lua_State *lua)
+{
+  int n = lua_gettop(lua);
+  luaL_argcheck(lua, n == 0, 0, "this function takes no arguments");
+
+  sa_moment_stats *ms = lua_newuserdata(lua, sizeof(sa_moment_stats));
+  sa_init_moment_stats(ms);
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, g_moments_env);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the moments environment");
+  }
+#endif
+
+  luaL_getmetatable(lua, g_moments_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int moments_tostring(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_moment_stats(ms, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int moments_fromstring(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_moment_stats(ms, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+static int moments_add(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 2);
+  double sample = luaL_checknumber(lua, 2);
+  sa_add_moment_stats(ms, sample);
+  lua_pushnumber(lua, ms->mean);
+  return 1;
+}
+
+
+static int moments_avg(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, ms->mean);
+  return 1;
+}
+
+
+static int moments_clear(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  sa_init_moment_stats(ms);
+  return 0;
+}
+
+
+static int moments_count(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, ms->count);
+  return 1;
+}
+
+
+static int moments_kurtosis(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, sa_kurtosis_moment_stats(ms));
+  return 1;
+}
+
+
+static int moments_max(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, ms->max);
+  return 1;
+}
+
+
+static int moments_merge(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 2);
+  sa_moment_stats *ms1 = luaL_checkudata(lua, 2, g_moments_mt);
+  sa_merge_moment_stats(ms, ms1);
+  return 0;
+}
+
+
+static int moments_min(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, ms->min);
+  return 1;
+}
+
+
+static int moments_sd(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, sa_sd_moment_stats(ms));
+  return 1;
+}
+
+
+static int moments_skewness(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, sa_skewness_moment_stats(ms));
+  return 1;
+}
+
+
+static int moments_usd(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, sa_usd_moment_stats(ms));
+  return 1;
+}
+
+
+static int moments_variance(lua_State *lua)
+{
+  sa_moment_stats *ms = check_moments(lua, 1);
+  lua_pushnumber(lua, sa_variance_moment_stats(ms));
+  return 1;
+}
+
+
+static sa_bivariate_stats* check_bivariate(lua_State *lua, int args)
+{
+  sa_bivariate_stats *bs = luaL_checkudata(lua, 1, g_bivariate_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return bs;
+}
+
+
+static int bivariate_new(lua_State *lua)
+{
+  int n = lua_gettop(lua);
+  luaL_argcheck(lua, n == 0, 0, "this function takes no arguments");
+
+  sa_bivariate_stats *bs = lua_newuserdata(lua, sizeof(sa_bivariate_stats));
+  sa_init_bivariate_stats(bs);
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, g_bivariate_env);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the bivariate environment");
+  }
+#endif
+
+  luaL_getmetatable(lua, g_bivariate_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int bivariate_tostring(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_bivariate_stats(bs, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int bivariate_fromstring(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_bivariate_stats(bs, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+static int bivariate_add(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 3);
+  double x = luaL_checknumber(lua, 2);
+  double y = luaL_checknumber(lua, 3);
+  sa_add_bivariate_stats(bs, x, y);
+  return 0;
+}
+
+
+static int bivariate_clear(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 1);
+  sa_init_bivariate_stats(bs);
+  return 0;
+}
+
+
+static int bivariate_correlation(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 1);
+  lua_pushnumber(lua, sa_correlation_bivariate_stats(bs));
+  return 1;
+}
+
+
+static int bivariate_count(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 1);
+  lua_pushnumber(lua, bs->count);
+  return 1;
+}
+
+
+static int bivariate_covariance(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 1);
+  lua_pushnumber(lua, sa_covariance_bivariate_stats(bs));
+  return 1;
+}
+
+
+static int bivariate_merge(lua_State *lua)
+{
+  sa_bivariate_stats *bs = check_bivariate(lua, 2);
+  sa_bivariate_stats *bs1 = luaL_checkudata(lua, 2, g_bivariate_mt);
+  sa_merge_bivariate_stats(bs, bs1);
+  return 0;
+}
+
+
+static sa_ewma_stats* check_ewma(lua_State *lua, int args)
+{
+  sa_ewma_stats *es = luaL_checkudata(lua, 1, g_ewma_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return es;
+}
+
+
+static uint64_t check_ns(lua_State *lua, int idx)
+{
+  double d = luaL_checknumber(lua, idx);
+  luaL_argcheck(lua, d >= 0 && d <= UINT64_MAX, idx, "must be 0 - UINT64_MAX");
+  return (uint64_t)d;
+}
+
+
+static int ewma_new(lua_State *lua)
+{
+  int n = lua_gettop(lua);
+  luaL_argcheck(lua, n == 1, 0, "incorrect number of arguments");
+  double hl = luaL_checknumber(lua, 1);
+  luaL_argcheck(lua, hl >= 1 && hl <= UINT64_MAX, 1, "must be 1 - UINT64_MAX");
+
+  sa_ewma_stats *es = lua_newuserdata(lua, sizeof(sa_ewma_stats));
+  sa_init_ewma_stats(es, (uint64_t)hl);
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, g_ewma_env);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the ewma environment");
+  }
+#endif
+
+  luaL_getmetatable(lua, g_ewma_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int ewma_tostring(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_ewma_stats(es, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int ewma_fromstring(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_ewma_stats(es, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+static int ewma_add(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 3);
+  uint64_t ns = check_ns(lua, 2);
+  double sample = luaL_checknumber(lua, 3);
+  sa_add_ewma_stats(es, ns, sample);
+  lua_pushnumber(lua, es->mean);
+  return 1;
+}
+
+
+static int ewma_avg(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  lua_pushnumber(lua, es->mean);
+  return 1;
+}
+
+
+static int ewma_clear(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  sa_init_ewma_stats(es, es->half_life);
+  return 0;
+}
+
+
+static int ewma_current_time(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  lua_pushnumber(lua, (lua_Number)es->current_time);
+  return 1;
+}
+
+
+static int ewma_sd(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  lua_pushnumber(lua, sa_sd_ewma_stats(es));
+  return 1;
+}
+
+
+static int ewma_variance(lua_State *lua)
+{
+  sa_ewma_stats *es = check_ewma(lua, 1);
+  lua_pushnumber(lua, sa_variance_ewma_stats(es));
+  return 1;
+}
+
+
+static int ewma_weight(lua_State *lua)
+{
+  sa_ewma_stats *es = luaL_checkudata(lua, 1, g_ewma_mt);
+  int n = lua_gettop(lua);
+  luaL_argcheck(lua, n >= 1 && n <= 2, 0, "incorrect number of arguments");
+  uint64_t ns = n == 2 ? check_ns(lua, 2) : es->current_time;
+  lua_pushnumber(lua, sa_weight_ewma_stats(es, ns));
+  return 1;
+}
+
+
 #ifdef LUA_SANDBOX
 static int serialize_rs(lua_State *lua)
 {
@@ -154,11 +554,107 @@ static int serialize_rs(lua_State *lua)
   }
   return 0;
 }
+
+
+static int serialize_moments(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_moment_stats *ms = lua_touserdata(lua, -3);
+  if (!(ob && key && ms)) {
+    return 1;
+  }
+  if (lsb_outputf(ob, "if %s == nil then %s = "
+                  "streaming_algorithms.running_stats.moments() end\n",
+                  key, key)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_moment_stats(ms, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
+
+
+static int serialize_bivariate(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_bivariate_stats *bs = lua_touserdata(lua, -3);
+  if (!(ob && key && bs)) {
+    return 1;
+  }
+  if (lsb_outputf(ob, "if %s == nil then %s = "
+                  "streaming_algorithms.running_stats.bivariate() end\n",
+                  key, key)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_bivariate_stats(bs, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
+
+
+static int serialize_ewma(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_ewma_stats *es = lua_touserdata(lua, -3);
+  if (!(ob && key && es)) {
+    return 1;
+  }
+  if (lsb_outputf(ob, "if %s == nil then %s = "
+                  "streaming_algorithms.running_stats.ewma(%" PRIu64 ") end\n",
+                  key, key, es->half_life)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_ewma_stats(es, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
 #endif
 
 
 static const struct luaL_reg rs_f[] =
 {
+  { "bivariate", bivariate_new },
+  { "ewma", ewma_new },
+  { "moments", moments_new },
   { "new", rs_new },
   { NULL, NULL }
 };
@@ -172,6 +668,7 @@ static const struct luaL_reg rs_m[] =
   { "clear", rs_clear },
   { "count", rs_count },
   { "fromstring", rs_fromstring },
+  { "merge", rs_merge },
   { "sd", rs_sd },
   { "usd", rs_usd },
   { "variance", rs_variance },
@@ -179,14 +676,94 @@ static const struct luaL_reg rs_m[] =
 };
 
 
+static const struct luaL_reg moments_m[] =
+{
+  { "__tostring", moments_tostring },
+  { "add", moments_add },
+  { "avg", moments_avg },
+  { "clear", moments_clear },
+  { "count", moments_count },
+  { "fromstring", moments_fromstring },
+  { "kurtosis", moments_kurtosis },
+  { "max", moments_max },
+  { "merge", moments_merge },
+  { "min", moments_min },
+  { "sd", moments_sd },
+  { "skewness", moments_skewness },
+  { "usd", moments_usd },
+  { "variance", moments_variance },
+  { NULL, NULL }
+};
+
+
+static const struct luaL_reg bivariate_m[] =
+{
+  { "__tostring", bivariate_tostring },
+  { "add", bivariate_add },
+  { "clear", bivariate_clear },
+  { "correlation", bivariate_correlation },
+  { "count", bivariate_count },
+  { "covariance", bivariate_covariance },
+  { "fromstring", bivariate_fromstring },
+  { "merge", bivariate_merge },
+  { NULL, NULL }
+};
+
+
+static const struct luaL_reg ewma_m[] =
+{
+  { "__tostring", ewma_tostring },
+  { "add", ewma_add },
+  { "avg", ewma_avg },
+  { "clear", ewma_clear },
+  { "current_time", ewma_current_time },
+  { "fromstring", ewma_fromstring },
+  { "sd", ewma_sd },
+  { "variance", ewma_variance },
+  { "weight", ewma_weight },
+  { NULL, NULL }
+};
+
+
 int luaopen_streaming_algorithms_running_stats(lua_State *lua)
 {
 #ifdef LUA_SANDBOX
   lua_newtable(lua);
   lsb_add_serialize_function(lua, serialize_rs);
+
+  lua_newtable(lua); // create a table for the moments userdata environment
+  lsb_add_serialize_function(lua, serialize_moments);
+  lua_setfield(lua, -2, g_moments_env);
+
+  lua_newtable(lua); // create a table for the bivariate userdata environment
+  lsb_add_serialize_function(lua, serialize_bivariate);
+  lua_setfield(lua, -2, g_bivariate_env);
+
+  lua_newtable(lua); // create a table for the ewma userdata environment
+  lsb_add_serialize_function(lua, serialize_ewma);
+  lua_setfield(lua, -2, g_ewma_env);
+
   lua_replace(lua, LUA_ENVIRONINDEX);
 #endif
 
+  luaL_newmetatable(lua, g_moments_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, moments_m);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_bivariate_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, bivariate_m);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_ewma_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, ewma_m);
+  lua_pop(lua, 1);
+
   luaL_newmetatable(lua, g_mt);
   lua_pushvalue(lua, -1);
   lua_setfield(lua, -2, "__index");
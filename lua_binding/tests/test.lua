@@ -15,6 +15,11 @@ local rs_errors = {
     {function() local s = rs.new(); s:sd(nil) end           , "test.lua:15: bad argument #-1 to 'sd' (incorrect number of arguments)"},
     {function() local s = rs.new(); s:variance(nil) end     , "test.lua:16: bad argument #-1 to 'variance' (incorrect number of arguments)"},
     {function() local s = rs.new(); s:fromstring("foo") end , "test.lua:17: invalid serialization"},
+    {function() local s = rs.new(); s:merge(1) end          , "test.lua:18: bad argument #1 to 'merge' (trink.streaming_algorithms.running_stats expected, got number)"},
+    {function() local s = rs.moments(); s:merge(rs.new()) end, "test.lua:19: bad argument #1 to 'merge' (trink.streaming_algorithms.running_stats.moments expected, got userdata)"},
+    {function() local s = rs.bivariate(); s:add(1) end     , "test.lua:20: bad argument #-1 to 'add' (incorrect number of arguments)"},
+    {function() local s = rs.ewma(0) end                   , "test.lua:21: bad argument #1 to 'ewma' (must be 1 - UINT64_MAX)"},
+    {function() local s = rs.ewma(20); s:fromstring(tostring(rs.ewma(10))) end, "test.lua:22: invalid serialization"},
 }
 
 for i, v in ipairs(rs_errors) do
@@ -50,6 +55,61 @@ rv = stat:count()
 assert(rv == 0, string.format("received %d", rv))
 verify_stat(stat1)
 
+local s1 = rs.new()
+local s2 = rs.new()
+for i = 1, 10 do
+    if i <= 3 then s1:add(i) else s2:add(i) end
+end
+s1:merge(s2)
+verify_stat(s1)
+
+local ms = rs.moments()
+local ms1 = rs.moments()
+for i = 1, 10 do
+    ms:add(i)
+    ms1:add(i * i)
+end
+verify_stat(ms)
+assert(ms:min() == 1 and ms:max() == 10)
+assert(ms:skewness() == 0, ms:skewness())
+assert(math.abs(ms:kurtosis() + 1.2242424) < 1e-6, ms:kurtosis())
+assert(math.abs(ms1:skewness() - 0.568676) < 1e-6, ms1:skewness())
+local ms2 = rs.moments()
+ms2:fromstring(tostring(ms))
+ms2:merge(ms1)
+assert(ms2:count() == 20 and ms2:max() == 100)
+ms2:clear()
+assert(ms2:count() == 0)
+
+local bs = rs.bivariate()
+local bs1 = rs.bivariate()
+for i = 1, 10 do
+    bs:add(i, 3 * i + 1)
+    bs1:add(i, -i)
+end
+assert(bs:count() == 10)
+assert(math.abs(bs:covariance() - 27.5) < 1e-9, bs:covariance())
+assert(bs:correlation() == 1, bs:correlation())
+assert(bs1:correlation() == -1, bs1:correlation())
+local bs2 = rs.bivariate()
+bs2:fromstring(tostring(bs))
+bs2:merge(bs1)
+assert(bs2:count() == 20)
+assert(math.abs(bs2:correlation() - 0.218061) < 1e-6, bs2:correlation())
+
+local es = rs.ewma(10)
+assert(es:add(100, 0) == 0)
+assert(math.abs(es:add(110, 10) - 20 / 3) < 1e-12)
+assert(math.abs(es:variance() - 200 / 9) < 1e-12, es:variance())
+assert(es:weight() == 1.5)
+assert(es:weight(120) == 0.75)
+assert(es:current_time() == 110)
+local es1 = rs.ewma(10)
+es1:fromstring(tostring(es))
+assert(es1:avg() == es:avg())
+es1:clear()
+assert(es1:weight() == 0)
+
 
 
 
@@ -57,12 +117,19 @@ verify_stat(stat1)
 local p2 = require "streaming_algorithms.p2"
 
 local p2_errors = {
-    {function() local s = p2.quantile("string") end     , "test.lua:60: bad argument #1 to 'quantile' (number expected, got string)"},
-    {function() local s = p2.quantile(-1) end           , "test.lua:61: bad argument #1 to 'quantile' (0 < quantile < 1)"},
-    {function() local s = p2.quantile(1.1) end          , "test.lua:62: bad argument #1 to 'quantile' (0 < quantile < 1)"},
-    {function() local s = p2.histogram("string") end    , "test.lua:63: bad argument #1 to 'histogram' (number expected, got string)"},
-    {function() local s = p2.histogram(3) end           , "test.lua:64: bad argument #1 to 'histogram' (4 <= buckets < 65535)"},
-    {function() local s = p2.histogram(65535) end       , "test.lua:65: bad argument #1 to 'histogram' (4 <= buckets < 65535)"},
+    {function() local s = p2.quantile("string") end     , "test.lua:120: bad argument #1 to 'quantile' (number expected, got string)"},
+    {function() local s = p2.quantile(-1) end           , "test.lua:121: bad argument #1 to 'quantile' (0 < quantile < 1)"},
+    {function() local s = p2.quantile(1.1) end          , "test.lua:122: bad argument #1 to 'quantile' (0 < quantile < 1)"},
+    {function() local s = p2.histogram("string") end    , "test.lua:123: bad argument #1 to 'histogram' (number expected, got string)"},
+    {function() local s = p2.histogram(3) end           , "test.lua:124: bad argument #1 to 'histogram' (4 <= buckets < 65535)"},
+    {function() local s = p2.histogram(65535) end       , "test.lua:125: bad argument #1 to 'histogram' (4 <= buckets < 65535)"},
+    {function() local s = p2.histogram(4, "int") end    , "test.lua:126: bad argument #2 to 'histogram' (invalid option 'int')"},
+    {function() local s = p2.window(1, 1, 4) end        , "test.lua:127: bad argument #1 to 'window' (must be > 1)"},
+    {function() local s = p2.window(2, 0, 4) end        , "test.lua:128: bad argument #2 to 'window' (must be 1 - UINT64_MAX)"},
+    {function() local s = p2.window(2, 1, 3) end        , "test.lua:129: bad argument #3 to 'window' (4 <= buckets < 65535)"},
+    {function() local s = p2.window(2, 1, 4); s:estimate(nil, 3, 0.5) end, "test.lua:130: bad argument #2 to 'estimate' (invalid sequence length)"},
+    {function() local s = p2.window(2, 1, 4); s:estimate(nil, 2, 2) end  , "test.lua:131: bad argument #3 to 'estimate' (0 <= quantile <= 1)"},
+    {function() local s = p2.window(2, 1, 4); s:add(-1, 1) end           , "test.lua:132: bad argument #1 to 'add' (must be 0 - UINT64_MAX)"},
 }
 
 for i, v in ipairs(p2_errors) do
@@ -74,19 +141,19 @@ end
 
 
 local p2_method_errors = {
-    {function(ud) local rv = ud:add(nil) end        , "test.lua:77: bad argument #1 to 'add' (number expected, got nil)"},
-    {function(ud) ud:clear(nil) end                 , "test.lua:78: bad argument #-1 to 'clear' (incorrect number of arguments)"},
-    {function(ud) local rv = ud:count(-1) end       , "test.lua:79: bad argument #1 to 'count' (marker out of range)"},
-    {function(ud) local rv = ud:count(5) end        , "test.lua:80: bad argument #1 to 'count' (marker out of range)"},
-    {function(ud) local rv = ud:estimate(-1) end    , "test.lua:81: bad argument #1 to 'estimate' (marker out of range)"},
-    {function(ud) local rv = ud:estimate(5) end     , "test.lua:82: bad argument #1 to 'estimate' (marker out of range)"},
-    {function(ud) local rv = ud:__tostring(nil) end , "test.lua:83: bad argument #-1 to '__tostring' (incorrect number of arguments)"},
-    {function(ud) ud:fromstring(nil) end      , "test.lua:84: bad argument #1 to 'fromstring' (string expected, got nil)"},
-    {function(ud) ud:fromstring("foo") end    , "test.lua:85: invalid serialization"},
+    {function(ud) local rv = ud:add(nil) end        , "test.lua:144: bad argument #1 to 'add' (number expected, got nil)"},
+    {function(ud) ud:clear(nil) end                 , "test.lua:145: bad argument #-1 to 'clear' (incorrect number of arguments)"},
+    {function(ud) local rv = ud:count(-1) end       , "test.lua:146: bad argument #1 to 'count' (marker out of range)"},
+    {function(ud) local rv = ud:count(5) end        , "test.lua:147: bad argument #1 to 'count' (marker out of range)"},
+    {function(ud) local rv = ud:estimate(-1) end    , "test.lua:148: bad argument #1 to 'estimate' (marker out of range)"},
+    {function(ud) local rv = ud:estimate(5) end     , "test.lua:149: bad argument #1 to 'estimate' (marker out of range)"},
+    {function(ud) local rv = ud:__tostring(nil) end , "test.lua:150: bad argument #-1 to '__tostring' (incorrect number of arguments)"},
+    {function(ud) ud:fromstring(nil) end      , "test.lua:151: bad argument #1 to 'fromstring' (string expected, got nil)"},
+    {function(ud) ud:fromstring("foo") end    , "test.lua:152: invalid serialization"},
 }
 
 for i, v in ipairs(p2_method_errors) do
-    local objects = {p2.quantile(0.5), p2.histogram(4)}
+    local objects = {p2.quantile(0.5), p2.histogram(4), p2.histogram(4, "float")}
     for i,obj in ipairs(objects) do
         local ok, err = pcall(v[1], obj)
         if ok or err ~= v[2]then
@@ -124,6 +191,34 @@ end
 verify_results(q)
 verify_results(h)
 
+local hf = p2.histogram(4, "float")
+for i,v in ipairs(data) do
+    hf:add(v)
+end
+verify_results(hf)
+local hf1 = p2.histogram(4, "float")
+hf1:fromstring(tostring(hf))
+verify_results(hf1)
+
+local w = p2.window(10, 1, 20)
+for r = 0, 9 do
+    for k = 0, 99 do
+        assert(w:add(r, r * 100 + (k * 37) % 100))
+    end
+end
+assert(w:count(nil, 10) == 1000)
+local e = w:estimate(nil, 10, 0.5)
+assert(math.abs(e - 499.5) < 10, e)
+e = w:estimate(5, 5, 0.5)
+assert(math.abs(e - 749.5) < 10, e)
+assert(w:add(14, 5000))
+assert(not w:add(4, 1))
+assert(w:current_time() == 14)
+assert(w:estimate(10, 5, 0.5) == 5000)
+local w1 = p2.window(10, 1, 20)
+w1:fromstring(tostring(w))
+assert(w1:count(nil, 10) == 501)
+
 
 
 
@@ -132,11 +227,11 @@ verify_results(h)
 local cm_sketch = require "streaming_algorithms.cm_sketch"
 
 local cms_errors = {
-    {function() local s = cm_sketch.new() end, "test.lua:135: bad argument #0 to 'new' (incorrect number of arguments)"},
-    {function() local s = cm_sketch.new(0.1, "string") end, "test.lua:136: bad argument #2 to 'new' (number expected, got string)"},
-    {function() local s = cm_sketch.new(-1, 0.1) end, "test.lua:137: bad argument #1 to 'new' (0 < epsilon < 1)"},
-    {function() local s = cm_sketch.new(0.1, -1) end, "test.lua:138: bad argument #2 to 'new' (0 < delta < 1)"},
-    {function() local s = cm_sketch.new("string", -1) end, "test.lua:139: bad argument #1 to 'new' (number expected, got string)"},
+    {function() local s = cm_sketch.new() end, "test.lua:230: bad argument #0 to 'new' (incorrect number of arguments)"},
+    {function() local s = cm_sketch.new(0.1, "string") end, "test.lua:231: bad argument #2 to 'new' (number expected, got string)"},
+    {function() local s = cm_sketch.new(-1, 0.1) end, "test.lua:232: bad argument #1 to 'new' (0 < epsilon < 1)"},
+    {function() local s = cm_sketch.new(0.1, -1) end, "test.lua:233: bad argument #2 to 'new' (0 < delta < 1)"},
+    {function() local s = cm_sketch.new("string", -1) end, "test.lua:234: bad argument #1 to 'new' (number expected, got string)"},
 }
 
 for i, v in ipairs(cms_errors) do
@@ -148,16 +243,16 @@ end
 
 
 local cms_method_errors = {
-    {function(ud) local rv = ud:update() end, "test.lua:151: bad argument #-1 to 'update' (incorrect number of arguments)"},
-    {function(ud) local rv = ud:update(true) end, "test.lua:152: bad argument #1 to 'update' (must be a string or number)"},
-    {function(ud) local rv = ud:update("a", "a") end, "test.lua:153: bad argument #2 to 'update' (number expected, got string)"},
-    {function(ud) local rv = ud:item_count(6) end, "test.lua:154: bad argument #-1 to 'item_count' (incorrect number of arguments)"},
-    {function(ud) local rv = ud:unique_count(6) end, "test.lua:155: bad argument #-1 to 'unique_count' (incorrect number of arguments)"},
-    {function(ud) local rv = ud:clear(6) end, "test.lua:156: bad argument #-1 to 'clear' (incorrect number of arguments)"},
-    {function(ud) ud:fromstring(nil) end, "test.lua:157: bad argument #1 to 'fromstring' (string expected, got nil)"},
-    {function(ud) ud:fromstring("foo") end, "test.lua:158: invalid serialization"},
-    {function(ud) ud:point_query() end, "test.lua:159: bad argument #-1 to 'point_query' (incorrect number of arguments)"},
-    {function(ud) ud:point_query(true) end, "test.lua:160: bad argument #1 to 'point_query' (must be a string or number)"},
+    {function(ud) local rv = ud:update() end, "test.lua:246: bad argument #-1 to 'update' (incorrect number of arguments)"},
+    {function(ud) local rv = ud:update(true) end, "test.lua:247: bad argument #1 to 'update' (must be a string or number)"},
+    {function(ud) local rv = ud:update("a", "a") end, "test.lua:248: bad argument #2 to 'update' (number expected, got string)"},
+    {function(ud) local rv = ud:item_count(6) end, "test.lua:249: bad argument #-1 to 'item_count' (incorrect number of arguments)"},
+    {function(ud) local rv = ud:unique_count(6) end, "test.lua:250: bad argument #-1 to 'unique_count' (incorrect number of arguments)"},
+    {function(ud) local rv = ud:clear(6) end, "test.lua:251: bad argument #-1 to 'clear' (incorrect number of arguments)"},
+    {function(ud) ud:fromstring(nil) end, "test.lua:252: bad argument #1 to 'fromstring' (string expected, got nil)"},
+    {function(ud) ud:fromstring("foo") end, "test.lua:253: invalid serialization"},
+    {function(ud) ud:point_query() end, "test.lua:254: bad argument #-1 to 'point_query' (incorrect number of arguments)"},
+    {function(ud) ud:point_query(true) end, "test.lua:255: bad argument #1 to 'point_query' (must be a string or number)"},
 }
 
 for i, v in ipairs(cms_method_errors) do
@@ -243,6 +338,47 @@ local errors = {
     cb:stats(nil, 3) end,
     function() local cb = time_series.new(2, 1) -- stats() invalid length
     cb:stats(nil, 2, "foo") end,                -- stats() invalid type
+    function() local cb = time_series.new(10, 1) -- window_stats() no window
+    cb:window_stats() end,
+    function() local cb = time_series.new(10, 1, "int", 11) end, -- window larger than rows
+    function() local cb = time_series.new(10, 1, "float", 2) end, -- window on a float series
+    function() local cb = time_series.new(10, 1, "int16") end, -- invalid type
+    function() local cb = time_series.new(10, 1, "double") -- fromstring() type mismatch
+    cb:fromstring(tostring(time_series.new(10, 1, "float"))) end,
+    function() local cb = time_series.new(17, 1, "float") -- matrix_profile() int only
+    cb:matrix_profile(nil, 16, 4, 100) end,
+    function() local cb = time_series.new(10, 1) -- add_many() mismatched lengths
+    cb:add_many({1, 2}, {1}) end,
+    function() local cb = time_series.new(10, 1) -- add_many() non numeric ns
+    cb:add_many({1, "a"}, {1, 2}) end,
+    function() local cb = time_series.new(10, 1) -- add_many() invalid ns
+    cb:add_many({-1}, {1}) end,
+    function() local cb = time_series.rollup("max", {10, 6}, {2, 5}) end, -- rollup() indivisible resolutions
+    function() local cb = time_series.rollup("mode", {10}, {1}) end, -- rollup() invalid aggregation
+    function() local cb = time_series.rollup("max", {10, 6, 4}, {1, 5, 30}) -- rollup get() invalid level
+    cb:get(4, 300) end,
+    function() local cb = time_series.rollup("sum", {10, 6, 4}, {1, 5, 30}) -- rollup fromstring() aggregation mismatch
+    cb:fromstring(tostring(time_series.rollup("max", {10, 6, 4}, {1, 5, 30}))) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_stream() invalid sequence len
+    cb:matrix_profile_stream(40, 8) end,
+    function() local cb = time_series.new(40, 1) -- distance_profile() invalid sequence len
+    cb:distance_profile(92, 41, 8) end,
+    function() local cb = time_series.new(40, 1) -- distance_profile() invalid sub sequence len
+    cb:distance_profile(92, 32, 3) end,
+    function() local cb = time_series.new(40, 1) -- distance_profile() incorrect # args
+    cb:distance_profile(92, 32) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid sequence len
+    cb:matrix_profile_join(0, 41, cb, 0, 20, 8) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid join len
+    cb:matrix_profile_join(0, 40, cb, 0, 7, 8) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid sub sequence len
+    cb:matrix_profile_join(0, 40, cb, 0, 20, 3) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid ts
+    cb:matrix_profile_join(0, 40, nil, 0, 20, 8) end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid result
+    cb:matrix_profile_join(0, 40, cb, 0, 20, 8, "foo") end,
+    function() local cb = time_series.new(40, 1) -- matrix_profile_join() invalid threads
+    cb:matrix_profile_join(0, 40, cb, 0, 20, 8, nil, 0) end,
 }
 
 for i, v in ipairs(errors) do
@@ -252,6 +388,7 @@ end
 
 local data = { 132, 161, 144, 145, 31, 44, 47, 26, 232, 236, 254, 262, 339, 360,
     313, 340, 1 }
+local pattern = {3, 1, 4, 1, 5, 9, 2, 6, 5, 8}
 
 local tests = {
     function()
@@ -412,6 +549,177 @@ local tests = {
         assert(math.abs(2.11476 - stat) < .00001, stat)
         assert(rows == 6, rows)
         end,
+    function()
+        local cb = time_series.new(10, 1, "int", 4)
+        for i = 0, 13 do
+            cb:add(i, i % 5)
+        end
+        -- window covers rows 10 - 13 (0, 1, 2, 3)
+        local v, cnt = cb:window_stats()
+        assert(v == 6 and cnt == 4, v)
+        assert(cb:window_stats("min") == 0)
+        assert(cb:window_stats("max") == 3)
+        assert(cb:window_stats("avg") == 1.5)
+        assert(math.abs(cb:window_stats("sd") - 1.2909944) < 1e-6)
+        cb:set(11, 10)
+        assert(cb:window_stats("max") == 10)
+        cb:add(20, -1)
+        assert(cb:window_stats("sum") == -1)
+        assert(cb:window_stats("min") == -1)
+        assert(cb:window_stats("max") == 0)
+        local cb1 = time_series.new(10, 1, "int", 4)
+        cb1:fromstring(tostring(cb))
+        assert(cb1:window_stats("min") == -1)
+        end,
+    function()
+        local cb = time_series.new(50, 1, "int", 0, true)
+        local cb1 = time_series.new(50, 1)
+        for i = 0, 120 do
+            local v = (i * 37) % 11 - 5
+            cb:add(i, v)
+            cb1:add(i, v)
+        end
+        for _, t in ipairs({"sum", "min", "max", "avg", "sd", "usd"}) do
+            for _, iz in ipairs({false, true}) do
+                local e, ecnt = cb1:stats(80, 30, t, iz)
+                local r, cnt = cb:stats(80, 30, t, iz)
+                assert(math.abs(e - r) < 1e-9 and ecnt == cnt, string.format("%s %g %g", t, e, r))
+            end
+        end
+        local cb2 = time_series.new(50, 1, "int", 0, true)
+        cb2:fromstring(tostring(cb))
+        assert(cb2:stats(nil, 50, "sum") == cb1:stats(nil, 50, "sum"))
+        local cb3 = time_series.new(64, 1, "int", 0, true)
+        local cb4 = time_series.new(64, 1)
+        for i = 0, 63 do
+            cb3:add(i, 1e9 + i % 2)
+            cb4:add(i, 1e9 + i % 2)
+        end
+        assert(cb3:stats(nil, 64, "usd") == 0.5, cb3:stats(nil, 64, "usd"))
+        assert(math.abs(cb4:stats(nil, 64, "usd") - 0.5) < 1e-6)
+        end,
+    function()
+        local cb = time_series.new(10, 1, "int64")
+        assert(cb:add(0, 2^40) == 2^40)
+        assert(cb:add(0, 2^40) == 2^41)
+        assert(cb:get(0) == 2^41)
+        assert(not cb:get(-1 + 2^53))
+        assert(cb:stats(nil, 10, "sum") == 2^41)
+        end,
+    function()
+        local cb = time_series.new(10, 1, "double")
+        cb:add(0, 0.5)
+        cb:add(1, 0.25)
+        assert(cb:get(0) == 0.5)
+        assert(cb:stats(0, 2, "sum") == 0.75)
+        assert(cb:stats(0, 2, "min") == 0.25)
+        assert(cb:get_range(0, 2)[2] == 0.25)
+        cb:set(2, 0/0)
+        local v, cnt = cb:stats(0, 3, "avg")
+        assert(v == 0.375 and cnt == 2, v)
+        assert(cb:add(20, 1) == 1)
+        assert(not cb:get(0))
+        end,
+    function()
+        local cb = time_series.new(10, 1, "float")
+        assert(cb:add(5, 1.5) == 1.5)
+        local cb1 = time_series.new(10, 1, "float")
+        cb1:fromstring(tostring(cb))
+        assert(cb1:get(5) == 1.5 and cb1:current_time() == 9)
+        end,
+    function()
+        local cb = time_series.new(10, 1)
+        local cb1 = time_series.new(10, 1)
+        local ns, v, cnt = {}, {}, 0
+        for i = 1, 600 do
+            ns[i] = 20 + math.floor(i / 3) - (i % 7 == 0 and 12 or 0)
+            v[i] = i % 11 - 5
+            cb1:add(ns[i], v[i])
+            if ns[i] > 210 then cnt = cnt + 1 end
+        end
+        assert(cb:add_many(ns, v) == cnt)
+        assert(tostring(cb) == tostring(cb1))
+        assert(cb:add_many({}, {}) == 0)
+        end,
+    function()
+        local cb = time_series.rollup("max", {10, 6, 4}, {1, 5, 30})
+        local cb1 = time_series.rollup("sum", {10, 6, 4}, {1, 5, 30})
+        for i = 300, 330 do
+            cb:add(i, i % 7)
+            cb1:add(i, i % 7)
+        end
+        assert(cb:current_time() == 330)
+        assert(cb:get(1, 329) == 329 % 7)
+        assert(cb:get(2, 325) == 6, cb:get(2, 325)) -- 325 - 329
+        assert(cb:get(3, 300) == 6)
+        assert(cb:get(3, 330) == 1) -- only the in progress row
+        assert(not cb:get(1, 331))
+        assert(not cb:get(1, 300))
+        assert(cb1:get(2, 325) == 3 + 4 + 5 + 6 + 0)
+        assert(time_series.rollup("avg", {10, 6}, {1, 5}):get(2, 0) == 0)
+        local cb2 = time_series.rollup("max", {10, 6, 4}, {1, 5, 30})
+        cb2:fromstring(tostring(cb))
+        assert(cb2:get(3, 300) == 6)
+        end,
+    function()
+        local cb = time_series.new(12, 1)
+        for i = 0, 11 do cb:add(i, i) end
+        local cb1 = time_series.new(4, 3)
+        cb1:merge(cb)
+        assert(cb1:get(9) == 9 + 10 + 11)
+        assert(cb1:get(0) == 0 + 1 + 2)
+        cb1:merge(cb, "set")
+        assert(cb1:get(9) == 11)
+        end,
+    function()
+        local cb = time_series.new(40, 1)
+        local mps = cb:matrix_profile_stream(32, 8)
+        cb = nil
+        collectgarbage() -- the stream keeps the time series alive
+        local ns, dist = mps:update()
+        assert(ns == 39 - 8, ns)
+        assert(dist == math.huge) -- all zero sub-sequences have no neighbor
+        assert(#mps:get() == 32 - 8 + 1)
+        assert(mps:get("mpi")[1] == -1)
+        assert(not pcall(mps.get, mps, "anomaly"))
+
+        local cb1 = time_series.new(40, 1)
+        local mps1 = cb1:matrix_profile_stream(32, 8)
+        for i = 0, 99 do cb1:add(i, pattern[i % 10 + 1]) end
+        ns, dist = mps1:update()
+        assert(ns == 99 - 8, ns)
+        assert(dist < 1e-6, dist) -- the sequence repeats every 10 rows
+        local mpi = mps1:get("mpi")
+        assert(mpi[#mpi] % 10 == (#mpi - 1) % 10, mpi[#mpi])
+        end,
+    function()
+        local cb = time_series.new(40, 1)
+        for i = 0, 99 do cb:add(i, pattern[i % 10 + 1]) end
+        local dp = cb:distance_profile(99 - 7, 32, 8)
+        assert(#dp == 32 - 8 + 1)
+        assert(dp[#dp] < 1e-6, dp[#dp]) -- trivial match
+        assert(dp[#dp - 10] < 1e-6, dp[#dp - 10]) -- the sequence repeats every 10 rows
+        assert(dp[#dp - 1] > 0.1, dp[#dp - 1])
+        assert(not cb:distance_profile(99 - 6, 32, 8)) -- incomplete query
+        assert(not cb:distance_profile(59, 32, 8)) -- out of range
+        end,
+    function()
+        local cb = time_series.new(40, 1)
+        for i = 0, 99 do cb:add(i, pattern[i % 10 + 1]) end
+        local cb1 = time_series.new(20, 1)
+        for i = 0, 19 do cb1:add(i, pattern[(i + 3) % 10 + 1]) end
+        local mp = cb:matrix_profile_join(60, 40, cb1, 0, 20, 8)
+        assert(#mp == 40 - 8 + 1)
+        for i = 1, #mp do assert(mp[i] < 1e-6, mp[i]) end
+        local mpi = cb:matrix_profile_join(60, 40, cb1, 0, 20, 8, "mpi")
+        assert(mpi[1] == 7, mpi[1])
+        assert(mpi[2] == 8, mpi[2])
+        local mpt = cb:matrix_profile_join(60, 40, cb1, 0, 20, 8, "mpi", 3)
+        for i = 1, #mpi do assert(mpt[i] == mpi[i], i) end
+        mp = cb:matrix_profile_join(60, 16, cb, 76, 16, 8) -- two ranges of one series
+        assert(mp[1] < 1e-6, mp[1])
+        assert(not cb:matrix_profile_join(59, 40, cb1, 0, 20, 8)) -- out of range
+        end,
 }
 
 for i, v in ipairs(tests) do
@@ -557,6 +865,23 @@ local tests = {
         local rv = m:sum(1)
         assert(rv == 10, rv)
         end,
+    function()
+        local m = matrix.new(3, 4)
+        for c = 1, 4 do
+            m:set(1, c, c)
+            m:set(3, c, 5 - c)
+        end
+        m:set(2, 1, 0) -- constant row
+        local pcc, idx = m:pcc(1, "min")
+        assert(idx == 3, idx)
+        assert(math.abs(pcc + 1) < 1e-9, pcc)
+        pcc, idx = m:pcc(1)
+        assert(idx == 3, idx)
+        assert(not m:pcc(2))
+        m:add(3, 1, -4) -- row 3 becomes 0, 3, 2, 1
+        pcc, idx = m:pcc(1)
+        assert(math.abs(pcc - 0.2) < 1e-9, pcc)
+        end,
 }
 
 for i, v in ipairs(tests) do
@@ -733,6 +1058,23 @@ local tests = {
         local rv = m:sum(1)
         assert(rv == 10, rv)
         end,
+    function()
+        local m = matrix.new(3, 4, "float")
+        for c = 1, 4 do
+            m:set(1, c, c)
+            m:set(3, c, 5 - c)
+        end
+        m:set(2, 1, 0) -- constant row
+        local pcc, idx = m:pcc(1, "min")
+        assert(idx == 3, idx)
+        assert(math.abs(pcc + 1) < 1e-9, pcc)
+        pcc, idx = m:pcc(1)
+        assert(idx == 3, idx)
+        assert(not m:pcc(2))
+        m:add(3, 1, -4) -- row 3 becomes 0, 3, 2, 1
+        pcc, idx = m:pcc(1)
+        assert(math.abs(pcc - 0.2) < 1e-9, pcc)
+        end,
 }
 
 for i, v in ipairs(tests) do
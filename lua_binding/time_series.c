@@ -21,11 +21,25 @@
 #include <luasandbox_serialize.h>
 #endif
 
-#include "p2.h"
 #include "running_stats.h"
 #include "time_series_impl.h"
 
 static const char *g_int_mt  = "trink.streaming_algorithms.time_series_int";
+static const char *g_int64_mt =
+    "trink.streaming_algorithms.time_series_int64";
+static const char *g_flt_mt = "trink.streaming_algorithms.time_series_float";
+static const char *g_dbl_mt = "trink.streaming_algorithms.time_series_double";
+static const char *g_rollup_mt =
+    "trink.streaming_algorithms.time_series_rollup";
+static const char *g_rollup_cfs[] = { "sum", "min", "max", "avg", NULL };
+static const char *g_mps_mt =
+    "trink.streaming_algorithms.time_series_mp_stream";
+#ifdef LUA_SANDBOX
+static const char *g_int64_env = "trink.time_series_int64_env";
+static const char *g_flt_env = "trink.time_series_float_env";
+static const char *g_dbl_env = "trink.time_series_double_env";
+static const char *g_rollup_env = "trink.time_series_rollup_env";
+#endif
 
 static sa_time_series_int* check_ts_int(lua_State *lua, int args)
 {
@@ -55,21 +69,67 @@ static int get_idx(sa_time_series_int *ts, uint64_t ns)
   return requested_row % ts->rows;
 }
 
+#define TS_SUFFIX int64
+#define TS_TYPE int64_t
+#define TS_TYPE_NAME "int64"
+#define TS_MT g_int64_mt
+#define TS_ENV g_int64_env
+#define TS_IS_INVALID(v) ((v) == INT64_MIN)
+#include "time_series_lua_tmpl.h"
+
+#define TS_SUFFIX flt
+#define TS_TYPE float
+#define TS_TYPE_NAME "float"
+#define TS_MT g_flt_mt
+#define TS_ENV g_flt_env
+#define TS_IS_INVALID(v) isnan(v)
+#include "time_series_lua_tmpl.h"
+
+#define TS_SUFFIX dbl
+#define TS_TYPE double
+#define TS_TYPE_NAME "double"
+#define TS_MT g_dbl_mt
+#define TS_ENV g_dbl_env
+#define TS_IS_INVALID(v) isnan(v)
+#include "time_series_lua_tmpl.h"
+
 
 static int ts_new(lua_State *lua)
 {
+  static const char *types[] = { "int", "int64", "float", "double", NULL };
+
   int n = lua_gettop(lua);
-  luaL_argcheck(lua, n == 2, 0, "incorrect number of arguments");
+  luaL_argcheck(lua, n >= 2 && n <= 5, 0, "incorrect number of arguments");
   int rows = luaL_checkint(lua, 1);
   luaL_argcheck(lua, rows > 1, 1, "must be > 1");
   double ns = luaL_checknumber(lua, 2);
   luaL_argcheck(lua, ns > 0 && ns <= UINT64_MAX, 2, "must be 1 - UINT64_MAX");
-  // the third argument will be the optional type currently just int
+  int type = luaL_checkoption(lua, 3, types[0], types);
+  int window = luaL_optint(lua, 4, 0);
+  luaL_argcheck(lua, window >= 0 && window <= rows, 4, "must be 0 - rows");
+  int index = lua_toboolean(lua, 5);
+  luaL_argcheck(lua, type == 0 || (window == 0 && !index), 4,
+                "window and index require the int type");
 
-  sa_time_series_int *ts = lua_newuserdata(lua, sizeof(*ts) +
-                                           sizeof(int) * rows);
+  switch (type) {
+  case 1:
+    ts_new_int64(lua, rows, (uint64_t)ns);
+    return 1;
+  case 2:
+    ts_new_flt(lua, rows, (uint64_t)ns);
+    return 1;
+  case 3:
+    ts_new_dbl(lua, rows, (uint64_t)ns);
+    return 1;
+  }
+
+  sa_time_series_int *ts = lua_newuserdata(lua, TIME_SERIES_INT_SIZE(rows,
+                                                                     window,
+                                                                     index));
   ts->ns_per_row = (uint64_t)ns;
   ts->rows = rows;
+  ts->window = window;
+  ts->index = index;
   sa_init_time_series_int(ts);
 
   luaL_getmetatable(lua, g_int_mt);
@@ -102,6 +162,36 @@ static int ts_add_int(lua_State *lua)
 }
 
 
+static int ts_add_many_int(lua_State *lua)
+{
+  sa_time_series_int *ts = check_ts_int(lua, 3);
+  luaL_checktype(lua, 2, LUA_TTABLE);
+  luaL_checktype(lua, 3, LUA_TTABLE);
+  size_t n = lua_objlen(lua, 2);
+  luaL_argcheck(lua, n == lua_objlen(lua, 3), 3, "length mismatch");
+
+  // scratch space is garbage collected if an entry fails validation
+  uint64_t *ns = lua_newuserdata(lua, (sizeof(uint64_t) + sizeof(int)) * n);
+  int *v = (int *)(ns + n);
+  for (size_t i = 0; i < n; ++i) {
+    lua_rawgeti(lua, 2, (int)(i + 1));
+    lua_rawgeti(lua, 3, (int)(i + 1));
+    if (lua_type(lua, -2) != LUA_TNUMBER || lua_type(lua, -1) != LUA_TNUMBER) {
+      return luaL_error(lua, "entry %d is not numeric", (int)(i + 1));
+    }
+    double d = lua_tonumber(lua, -2);
+    if (d < 0 || d > UINT64_MAX) {
+      return luaL_error(lua, "entry %d must be 0 - UINT64_MAX", (int)(i + 1));
+    }
+    ns[i] = (uint64_t)d;
+    v[i] = (int)lua_tointeger(lua, -1);
+    lua_pop(lua, 2);
+  }
+  lua_pushnumber(lua, (lua_Number)sa_add_time_series_int_batch(ts, ns, v, n));
+  return 1;
+}
+
+
 static int ts_set_int(lua_State *lua)
 {
   sa_time_series_int *ts = check_ts_int(lua, 3);
@@ -126,29 +216,7 @@ static int ts_merge_int(lua_State *lua)
   sa_time_series_int *ts = luaL_checkudata(lua, 1, g_int_mt);
   sa_time_series_int *ts1 = luaL_checkudata(lua, 2, g_int_mt);
   int op = luaL_checkoption(lua, 3, ops[0], ops);
-  luaL_argcheck(lua, ts->ns_per_row <= ts1->ns_per_row, 3,
-                "the resolution of the time series being merged must be "
-                "greater than or equal to the destination");
-
-  int (*fn)(sa_time_series_int *, uint64_t, int);
-  switch (op) {
-  case 0:
-    fn = sa_add_time_series_int;
-    break;
-  case 1:
-    fn = sa_set_time_series_int;
-    break;
-  }
-
-  uint64_t start = ts1->current_time - ts1->ns_per_row * (ts1->rows - 1);
-  int idx = ts1->current_time / ts1->ns_per_row % ts1->rows + 1;
-  for (int i = 0; i < ts1->rows; ++i, ++idx) {
-    if (idx == ts1->rows) {
-      idx = 0;
-    }
-    uint64_t ns = start + i * ts1->ns_per_row;
-    fn(ts, ns, ts1->v[idx]);
-  }
+  sa_merge_time_series_int(ts, ts1, op ? SA_MERGE_SET : SA_MERGE_ADD);
   return 0;
 }
 
@@ -291,6 +359,44 @@ static double stats_sd_int(sa_time_series_int *ts, int idx, int n,
 }
 
 
+static double stats_index_int(sa_time_series_int *ts, uint64_t ns, int n,
+                              int type, bool include_zero, int *rows)
+{
+  sa_range_stats_int r;
+  if (sa_range_stats_time_series_int(ts, ns, n, &r)) {return 0;}
+
+  *rows = include_zero ? n : r.nonzero;
+  bool zeros = include_zero && r.nonzero < n;
+  switch (type) {
+  case 0:
+    return r.sum;
+  case 1:
+    return zeros && r.min > 0 ? 0 : r.min;
+  case 2:
+    return zeros && r.max < 0 ? 0 : r.max;
+  }
+
+  sa_running_stats rs;
+  sa_init_running_stats(&rs);
+  if (r.nonzero > 0) {
+    rs.count = r.nonzero;
+    rs.mean = (double)r.sum / r.nonzero;
+    rs.sum = r.m2;
+  }
+  if (zeros) {
+    sa_running_stats z = { n - r.nonzero, 0, 0 };
+    sa_merge_running_stats(&rs, &z);
+  }
+  switch (type) {
+  case 3:
+    return rs.mean;
+  case 4:
+    return sa_sd_running_stats(&rs);
+  }
+  return sa_usd_running_stats(&rs);
+}
+
+
 static int ts_stats_int(lua_State *lua)
 {
   static const char *types[] = { "sum", "min", "max", "avg", "sd", "usd",
@@ -319,28 +425,75 @@ static int ts_stats_int(lua_State *lua)
 
   double result = 0;
   int rows = 0;
+  if (ts->index) {
+    result = stats_index_int(ts, ns, n, type, include_zero, &rows);
+  } else {
+    switch (type) {
+    case 0:
+      result = stats_sum_int(ts, idx, n, include_zero, &rows);
+      break;
+    case 1:
+      result = stats_min_int(ts, idx, n, include_zero, &rows);
+      break;
+    case 2:
+      result = stats_max_int(ts, idx, n, include_zero, &rows);
+      break;
+    case 3:
+      result = stats_avg_int(ts, idx, n, include_zero, &rows);
+      break;
+    case 4:
+      result = stats_sd_int(ts, idx, n, include_zero, true, &rows);
+      break;
+    case 5:
+      result = stats_sd_int(ts, idx, n, include_zero, false, &rows);
+      break;
+    }
+  }
+  lua_pushnumber(lua, result);
+  lua_pushinteger(lua, rows);
+  return 2;
+}
+
+
+static int ts_window_stats_int(lua_State *lua)
+{
+  static const char *types[] = { "sum", "min", "max", "avg", "sd", "usd",
+    NULL };
+
+  int i = lua_gettop(lua);
+  luaL_argcheck(lua, i >= 1 && i <= 2, 0, "incorrect number of arguments");
+  sa_time_series_int *ts = luaL_checkudata(lua, 1, g_int_mt);
+  int type = luaL_checkoption(lua, 2, types[0], types);
+
+  sa_running_stats rs;
+  int min, max;
+  if (sa_window_stats_time_series_int(ts, &rs, &min, &max)) {
+    return luaL_error(lua, "no window configured");
+  }
+
+  double result = 0;
   switch (type) {
   case 0:
-    result = stats_sum_int(ts, idx, n, include_zero, &rows);
+    result = round(rs.mean * rs.count); // the sum is integral
     break;
   case 1:
-    result = stats_min_int(ts, idx, n, include_zero, &rows);
+    result = min;
     break;
   case 2:
-    result = stats_max_int(ts, idx, n, include_zero, &rows);
+    result = max;
     break;
   case 3:
-    result = stats_avg_int(ts, idx, n, include_zero, &rows);
+    result = rs.mean;
     break;
   case 4:
-    result = stats_sd_int(ts, idx, n, include_zero, true, &rows);
+    result = sa_sd_running_stats(&rs);
     break;
   case 5:
-    result = stats_sd_int(ts, idx, n, include_zero, false, &rows);
+    result = sa_usd_running_stats(&rs);
     break;
   }
   lua_pushnumber(lua, result);
-  lua_pushinteger(lua, rows);
+  lua_pushinteger(lua, ts->window);
   return 2;
 }
 
@@ -378,30 +531,18 @@ static int ts_mp_int(lua_State *lua)
   case 1: // todo this can be optimized to only compute the profile for the last
           // window
     {
-      sa_p2_quantile *q95 = sa_create_p2_quantile(0.95);
-      sa_p2_quantile *q50 = sa_create_p2_quantile(0.50);
-      int idx = 0;
-      double discord = -INFINITY;
-      double e95 = 0;
-      double e50 = 0;
-      for (int i = result == 0 ? 0 : mp_len - m; i < mp_len; ++i) {
-        e95 = sa_add_p2_quantile(q95, mp[i]);
-        e50 = sa_add_p2_quantile(q50, mp[i]);
-        if (mp[i] > discord) {
-          discord = mp[i];
-          idx = i;
-        }
-      }
-      if (!isinf(discord)) {
+      int start = result == 0 ? 0 : mp_len - m;
+      sa_mp_discord d;
+      double e50, e95;
+      if (sa_mp_discords(mp + start, mp_len - start, m, 1, &d, &e50, &e95)
+          && !isinf(d.distance)) {
         // percentage of the range represented by the top 5% of discords
-        double p = (discord - e95) / (discord - e50) * 100;
-        lua_pushnumber(lua, ns + idx * ts->ns_per_row);
+        double p = (d.distance - e95) / (d.distance - e50) * 100;
+        lua_pushnumber(lua, ns + (start + d.idx) * ts->ns_per_row);
         lua_pushnumber(lua, p);
-        lua_pushnumber(lua, discord - e50);
+        lua_pushnumber(lua, d.distance - e50);
         rv = 3;
       }
-      sa_destroy_p2_quantile(q50);
-      sa_destroy_p2_quantile(q95);
     }
     break;
   case 2:
@@ -427,6 +568,148 @@ static int ts_mp_int(lua_State *lua)
 }
 
 
+static int ts_dp_int(lua_State *lua)
+{
+  sa_time_series_int *ts = luaL_checkudata(lua, 1, g_int_mt);
+  luaL_argcheck(lua, lua_gettop(lua) == 4, 0, "incorrect number of arguments");
+  uint64_t query_ns = check_ns(lua, 2);
+  query_ns = query_ns - (query_ns % ts->ns_per_row);
+  int n = luaL_checkint(lua, 3);
+  int m = luaL_checkint(lua, 4);
+  luaL_argcheck(lua, n <= ts->rows && n / 4 >= m, 3, "invalid sequence length");
+  luaL_argcheck(lua, m > 3, 4, "invalid sub-sequence length");
+
+  // search the trailing sequence_length rows
+  uint64_t ns = ts->current_time - ts->ns_per_row * (n - 1);
+  double *dp = NULL;
+  int dp_len = sa_dp_time_series_int(ts, query_ns, ns, n, m, &dp);
+  if (dp_len == 0) {
+    return 0;
+  }
+  lua_createtable(lua, dp_len, 0);
+  for (int i = 0; i < dp_len; ++i) {
+    lua_pushnumber(lua, dp[i]);
+    lua_rawseti(lua, -2, i + 1);
+  }
+  free(dp);
+  return 1;
+}
+
+
+static int ts_mp_join_int(lua_State *lua)
+{
+  static const char *results[] = { "mp", "mpi", NULL };
+
+  sa_time_series_int *ts = luaL_checkudata(lua, 1, g_int_mt);
+  uint64_t ns = check_ns(lua, 2);
+  ns = ns - (ns % ts->ns_per_row);
+  int n = luaL_checkint(lua, 3);
+  sa_time_series_int *other = luaL_checkudata(lua, 4, g_int_mt);
+  uint64_t other_ns = check_ns(lua, 5);
+  other_ns = other_ns - (other_ns % other->ns_per_row);
+  int other_n = luaL_checkint(lua, 6);
+  int m = luaL_checkint(lua, 7);
+  luaL_argcheck(lua, n <= ts->rows && n >= m, 3, "invalid sequence length");
+  luaL_argcheck(lua, other_n <= other->rows && other_n >= m, 6,
+                "invalid sequence length");
+  luaL_argcheck(lua, m > 3, 7, "invalid sub-sequence length");
+  int result = luaL_checkoption(lua, 8, results[0], results);
+  int threads = luaL_optint(lua, 9, 1);
+  luaL_argcheck(lua, threads > 0, 9, "invalid thread count");
+
+  double *mp = NULL;
+  int *mpi = NULL;
+  int mp_len = sa_mp_join_time_series_int(ts, ns, n, other, other_ns, other_n,
+                                          m, threads, &mp, &mpi);
+  if (mp_len == 0) {
+    return 0;
+  }
+  lua_createtable(lua, mp_len, 0);
+  for (int i = 0; i < mp_len; ++i) {
+    if (result == 0) {
+      lua_pushnumber(lua, mp[i]);
+    } else {
+      lua_pushinteger(lua, (lua_Integer)mpi[i]);
+    }
+    lua_rawseti(lua, -2, i + 1);
+  }
+  free(mp);
+  free(mpi);
+  return 1;
+}
+
+
+static int ts_mp_stream_int(lua_State *lua)
+{
+  sa_time_series_int *ts = luaL_checkudata(lua, 1, g_int_mt);
+  luaL_argcheck(lua, lua_gettop(lua) == 3, 0, "incorrect number of arguments");
+  int n = luaL_checkint(lua, 2);
+  int m = luaL_checkint(lua, 3);
+  luaL_argcheck(lua, n < ts->rows && n / 4 >= m, 2, "invalid sequence length");
+  luaL_argcheck(lua, m > 3, 3, "invalid sub-sequence length");
+
+  sa_mp_stream_int *mps = lua_newuserdata(lua, MP_STREAM_INT_SIZE(n, m));
+  mps->ts = ts;
+  mps->n = n;
+  mps->m = m;
+  mps->len = n - m + 1;
+  sa_init_mp_stream_int(mps);
+
+  // the environment keeps the time series alive, it has no serialize function
+  // so the stream is not preserved
+  lua_createtable(lua, 1, 0);
+  lua_pushvalue(lua, 1);
+  lua_rawseti(lua, -2, 1);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the matrix_profile_stream environment");
+  }
+  luaL_getmetatable(lua, g_mps_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int mps_update(lua_State *lua)
+{
+  sa_mp_stream_int *mps = luaL_checkudata(lua, 1, g_mps_mt);
+  luaL_argcheck(lua, lua_gettop(lua) == 1, 0, "incorrect number of arguments");
+  double d = sa_update_mp_stream_int(mps);
+  if (isnan(d)) {
+    return 0;
+  }
+  lua_pushnumber(lua, (lua_Number)sa_timestamp_mp_stream_int(mps));
+  lua_pushnumber(lua, d);
+  return 2;
+}
+
+
+static int mps_get(lua_State *lua)
+{
+  static const char *results[] = { "mp", "mpi", NULL };
+  sa_mp_stream_int *mps = luaL_checkudata(lua, 1, g_mps_mt);
+  int result = luaL_checkoption(lua, 2, results[0], results);
+
+  // the profile is copied into scratch userdata so an error cannot leak it
+  double *mp = NULL;
+  int *mpi = NULL;
+  if (result == 0) {
+    mp = lua_newuserdata(lua, sizeof(double) * mps->len);
+  } else {
+    mpi = lua_newuserdata(lua, sizeof(int) * mps->len);
+  }
+  int len = sa_get_mp_stream_int(mps, mp, mpi);
+  lua_createtable(lua, len, 0);
+  for (int i = 0; i < len; ++i) {
+    if (mp) {
+      lua_pushnumber(lua, mp[i]);
+    } else {
+      lua_pushinteger(lua, (lua_Integer)mpi[i]);
+    }
+    lua_rawseti(lua, -2, i + 1);
+  }
+  return 1;
+}
+
 static int ts_current_time_int(lua_State *lua)
 {
   sa_time_series_int *ts = check_ts_int(lua, 1);
@@ -444,13 +727,27 @@ static int serialize_ts_int(lua_State *lua)
   if (!(ob && key && ts)) {
     return 1;
   }
-  if (lsb_outputf(ob,
-                  "if %s == nil then %s = "
-                  "streaming_algorithms.time_series.new(%d, %" PRIu64 ") end\n",
-                  key,
-                  key,
-                  ts->rows,
-                  ts->ns_per_row)) {
+  if (ts->window || ts->index) {
+    if (lsb_outputf(ob,
+                    "if %s == nil then %s = "
+                    "streaming_algorithms.time_series.new(%d, %" PRIu64
+                    ", \"int\", %d, %s) end\n",
+                    key,
+                    key,
+                    ts->rows,
+                    ts->ns_per_row,
+                    ts->window,
+                    ts->index ? "true" : "false")) {
+      return 1;
+    }
+  } else if (lsb_outputf(ob,
+                         "if %s == nil then %s = "
+                         "streaming_algorithms.time_series.new(%d, %" PRIu64
+                         ") end\n",
+                         key,
+                         key,
+                         ts->rows,
+                         ts->ns_per_row)) {
     return 1;
   }
 
@@ -495,9 +792,205 @@ static int ts_fromstring_int(lua_State *lua)
 }
 
 
+static sa_rollup_time_series_int* check_rollup(lua_State *lua, int args)
+{
+  sa_rollup_time_series_int *rts = luaL_checkudata(lua, 1, g_rollup_mt);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return rts;
+}
+
+
+static int rollup_new(lua_State *lua)
+{
+  luaL_argcheck(lua, lua_gettop(lua) == 3, 0, "incorrect number of arguments");
+  int cf = luaL_checkoption(lua, 1, NULL, g_rollup_cfs);
+  luaL_checktype(lua, 2, LUA_TTABLE);
+  luaL_checktype(lua, 3, LUA_TTABLE);
+  int levels = (int)lua_objlen(lua, 2);
+  luaL_argcheck(lua, levels > 0 && levels <= SA_ROLLUP_MAX_LEVELS, 2,
+                "invalid number of levels");
+  luaL_argcheck(lua, levels == (int)lua_objlen(lua, 3), 3, "length mismatch");
+
+  int rows[SA_ROLLUP_MAX_LEVELS];
+  uint64_t ns_per_row[SA_ROLLUP_MAX_LEVELS];
+  size_t nbytes = TS_ALIGN(sizeof(sa_rollup_time_series_int));
+  for (int l = 0; l < levels; ++l) {
+    lua_rawgeti(lua, 2, l + 1);
+    lua_rawgeti(lua, 3, l + 1);
+    rows[l] = (int)lua_tointeger(lua, -2);
+    luaL_argcheck(lua, rows[l] > 1, 2, "rows must be > 1");
+    double ns = lua_tonumber(lua, -1);
+    luaL_argcheck(lua, ns > 0 && ns <= UINT64_MAX, 3,
+                  "must be 1 - UINT64_MAX");
+    ns_per_row[l] = (uint64_t)ns;
+    luaL_argcheck(lua, l == 0 || (ns_per_row[l] > ns_per_row[l - 1]
+                                  && ns_per_row[l] % ns_per_row[l - 1] == 0),
+                  3, "must be a larger multiple of the previous level");
+    lua_pop(lua, 2);
+    nbytes += TIME_SERIES_INT_SIZE(rows[l], 0, 0);
+  }
+
+  sa_rollup_time_series_int *rts = lua_newuserdata(lua, nbytes);
+  rts->levels = levels;
+  rts->cf = (sa_rollup_cf)cf;
+  sa_time_series_int *ts = ROLLUP_FIRST_LEVEL_INT(rts);
+  for (int l = 0; l < levels; ++l) {
+    ts->ns_per_row = ns_per_row[l];
+    ts->rows = rows[l];
+    ts->window = 0;
+    ts->index = 0;
+    ts = ROLLUP_NEXT_LEVEL_INT(ts);
+  }
+  sa_init_rollup_time_series_int(rts);
+
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, g_rollup_env);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the rollup environment");
+  }
+#endif
+  luaL_getmetatable(lua, g_rollup_mt);
+  lua_setmetatable(lua, -2);
+  return 1;
+}
+
+
+static int rollup_add(lua_State *lua)
+{
+  sa_rollup_time_series_int *rts = check_rollup(lua, 3);
+  uint64_t ns = check_ns(lua, 2);
+  int v = luaL_checkint(lua, 3);
+  int rv = sa_add_rollup_time_series_int(rts, ns, v);
+  if (rv == INT_MIN) {
+    lua_pushnil(lua);
+  } else {
+    lua_pushinteger(lua, rv);
+  }
+  return 1;
+}
+
+
+static int rollup_get(lua_State *lua)
+{
+  sa_rollup_time_series_int *rts = check_rollup(lua, 3);
+  int level = luaL_checkint(lua, 2);
+  luaL_argcheck(lua, level >= 1 && level <= rts->levels, 2,
+                "invalid level");
+  uint64_t ns = check_ns(lua, 3);
+  double v = sa_get_rollup_time_series_int(rts, level - 1, ns);
+  if (isnan(v)) {
+    lua_pushnil(lua);
+  } else {
+    lua_pushnumber(lua, v);
+  }
+  return 1;
+}
+
+
+static int rollup_current_time(lua_State *lua)
+{
+  sa_rollup_time_series_int *rts = check_rollup(lua, 1);
+  lua_pushnumber(lua, (lua_Number)sa_timestamp_rollup_time_series_int(rts));
+  return 1;
+}
+
+
+static int rollup_tostring(lua_State *lua)
+{
+  sa_rollup_time_series_int *rts = check_rollup(lua, 1);
+  size_t len;
+  char *buf = sa_serialize_rollup_time_series_int(rts, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int rollup_fromstring(lua_State *lua)
+{
+  sa_rollup_time_series_int *rts = check_rollup(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (sa_deserialize_rollup_time_series_int(rts, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+#ifdef LUA_SANDBOX
+static int serialize_rollup(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  sa_rollup_time_series_int *rts = lua_touserdata(lua, -3);
+  if (!(ob && key && rts)) {
+    return 1;
+  }
+  if (lsb_outputf(ob,
+                  "if %s == nil then %s = "
+                  "streaming_algorithms.time_series.rollup(\"%s\", {",
+                  key,
+                  key,
+                  g_rollup_cfs[rts->cf])) {
+    return 1;
+  }
+  for (int l = 0; l < rts->levels; ++l) {
+    if (lsb_outputf(ob, l ? ", %d" : "%d", rts->level[l]->rows)) {
+      return 1;
+    }
+  }
+  if (lsb_outputs(ob, "}, {", 4)) {
+    return 1;
+  }
+  for (int l = 0; l < rts->levels; ++l) {
+    if (lsb_outputf(ob, l ? ", %" PRIu64 : "%" PRIu64,
+                    rts->level[l]->ns_per_row)) {
+      return 1;
+    }
+  }
+  if (lsb_outputf(ob, "}) end\n%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = sa_serialize_rollup_time_series_int(rts, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
+#endif
+
+
+static const struct luaL_reg rollup_m[] =
+{
+  { "__tostring", rollup_tostring },
+  { "add", rollup_add },
+  { "current_time", rollup_current_time },
+  { "fromstring", rollup_fromstring },
+  { "get", rollup_get },
+  { NULL, NULL }
+};
+
+
+static const struct luaL_reg mps_m[] =
+{
+  { "get", mps_get },
+  { "update", mps_update },
+  { NULL, NULL }
+};
+
+
 static const struct luaL_reg ts_f[] =
 {
   { "new", ts_new },
+  { "rollup", rollup_new },
   { NULL, NULL }
 };
 
@@ -506,15 +999,20 @@ static const struct luaL_reg ts_int_m[] =
 {
   { "__tostring", ts_tostring_int },
   { "add", ts_add_int },
+  { "add_many", ts_add_many_int },
   { "current_time", ts_current_time_int },
+  { "distance_profile", ts_dp_int },
   { "fromstring", ts_fromstring_int },
   { "get", ts_get_int },
   { "get_configuration", ts_get_configuration_int },
   { "get_range", ts_get_range_int },
   { "matrix_profile", ts_mp_int },
+  { "matrix_profile_join", ts_mp_join_int },
+  { "matrix_profile_stream", ts_mp_stream_int },
   { "merge", ts_merge_int },
   { "set", ts_set_int },
   { "stats", ts_stats_int },
+  { "window_stats", ts_window_stats_int },
   { NULL, NULL }
 };
 
@@ -524,6 +1022,23 @@ int luaopen_streaming_algorithms_time_series(lua_State *lua)
 #ifdef LUA_SANDBOX
   lua_newtable(lua);
   lsb_add_serialize_function(lua, serialize_ts_int);
+
+  lua_newtable(lua); // create a table for the int64 userdata environment
+  lsb_add_serialize_function(lua, serialize_ts_int64);
+  lua_setfield(lua, -2, g_int64_env);
+
+  lua_newtable(lua); // create a table for the float userdata environment
+  lsb_add_serialize_function(lua, serialize_ts_flt);
+  lua_setfield(lua, -2, g_flt_env);
+
+  lua_newtable(lua); // create a table for the double userdata environment
+  lsb_add_serialize_function(lua, serialize_ts_dbl);
+  lua_setfield(lua, -2, g_dbl_env);
+
+  lua_newtable(lua); // create a table for the rollup userdata environment
+  lsb_add_serialize_function(lua, serialize_rollup);
+  lua_setfield(lua, -2, g_rollup_env);
+
   lua_replace(lua, LUA_ENVIRONINDEX);
 #endif
   luaL_newmetatable(lua, g_int_mt);
@@ -532,6 +1047,36 @@ int luaopen_streaming_algorithms_time_series(lua_State *lua)
   luaL_register(lua, NULL, ts_int_m);
   lua_pop(lua, 1);
 
+  luaL_newmetatable(lua, g_int64_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, ts_m_int64);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_flt_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, ts_m_flt);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_dbl_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, ts_m_dbl);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_rollup_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, rollup_m);
+  lua_pop(lua, 1);
+
+  luaL_newmetatable(lua, g_mps_mt);
+  lua_pushvalue(lua, -1);
+  lua_setfield(lua, -2, "__index");
+  luaL_register(lua, NULL, mps_m);
+  lua_pop(lua, 1);
+
   luaL_register(lua, "streaming_algorithms.time_series", ts_f);
 
   // if necessary flag the parent table as non-data for preservation
@@ -0,0 +1,299 @@
+/* -*- Mode: C; tab_width: 8; indent_tabs_mode: nil; c_basic_offset: 2 -*- */
+/* vim: set ts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/** Lua typed time series binding template. Included once per value type with
+ *  the following macros defined (they are undefined at the end):
+ *  - TS_SUFFIX         type suffix e.g. int64
+ *  - TS_TYPE           value type
+ *  - TS_TYPE_NAME      Lua type name passed to new()
+ *  - TS_MT             metatable name variable
+ *  - TS_ENV            userdata environment name variable (sandbox only)
+ *  - TS_IS_INVALID(v)  true if v is the out of range return value
+ *  @file */
+
+#define TS_CAT_(a, b) a ## _ ## b
+#define TS_CAT(a, b) TS_CAT_(a, b)
+#define TS_NAME(name) TS_CAT(name, TS_SUFFIX)
+#define TS_T TS_NAME(sa_time_series)
+
+static TS_T* TS_NAME(check_ts)(lua_State *lua, int args)
+{
+  TS_T *ts = luaL_checkudata(lua, 1, TS_MT);
+  luaL_argcheck(lua, args == lua_gettop(lua), 0,
+                "incorrect number of arguments");
+  return ts;
+}
+
+
+static int TS_NAME(get_idx)(TS_T *ts, uint64_t ns)
+{
+  int64_t current_row = ts->current_time / ts->ns_per_row;
+  int64_t requested_row = ns / ts->ns_per_row;
+  int64_t row_delta = requested_row - current_row;
+  if (requested_row > current_row || row_delta <= -ts->rows) {
+    return -1;
+  }
+  return requested_row % ts->rows;
+}
+
+
+static uint64_t TS_NAME(check_start_ns)(lua_State *lua, TS_T *ts, int idx)
+{
+  if (lua_isnil(lua, idx)) {
+    return ts->current_time - ts->ns_per_row * (ts->rows - 1);
+  }
+  uint64_t ns = check_ns(lua, idx);
+  return ns - (ns % ts->ns_per_row);
+}
+
+
+static void TS_NAME(ts_new)(lua_State *lua, int rows, uint64_t ns_per_row)
+{
+  TS_T *ts = lua_newuserdata(lua, sizeof(*ts) + sizeof(TS_TYPE) * rows);
+  ts->ns_per_row = ns_per_row;
+  ts->rows = rows;
+  TS_NAME(sa_init_time_series)(ts);
+#ifdef LUA_SANDBOX
+  lua_getfield(lua, LUA_ENVIRONINDEX, TS_ENV);
+  if (!lua_setfenv(lua, -2)) {
+    luaL_error(lua, "failed to set the time series environment");
+  }
+#endif
+  luaL_getmetatable(lua, TS_MT);
+  lua_setmetatable(lua, -2);
+}
+
+
+static int TS_NAME(ts_get_configuration)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 1);
+  lua_pushinteger(lua, ts->rows);
+  lua_pushnumber(lua, ts->ns_per_row);
+  return 2;
+}
+
+
+static int TS_NAME(ts_add)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 3);
+  uint64_t ns = check_ns(lua, 2);
+  TS_TYPE v = (TS_TYPE)luaL_checknumber(lua, 3);
+  TS_TYPE rv = TS_NAME(sa_add_time_series)(ts, ns, v);
+  if (TS_IS_INVALID(rv)) {
+    lua_pushnil(lua);
+  } else {
+    lua_pushnumber(lua, (lua_Number)rv);
+  }
+  return 1;
+}
+
+
+static int TS_NAME(ts_set)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 3);
+  uint64_t ns = check_ns(lua, 2);
+  TS_TYPE v = (TS_TYPE)luaL_checknumber(lua, 3);
+  TS_TYPE rv = TS_NAME(sa_set_time_series)(ts, ns, v);
+  if (TS_IS_INVALID(rv)) {
+    lua_pushnil(lua);
+  } else {
+    lua_pushnumber(lua, (lua_Number)rv);
+  }
+  return 1;
+}
+
+
+static int TS_NAME(ts_get)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 2);
+  uint64_t ns = check_ns(lua, 2);
+  TS_TYPE rv = TS_NAME(sa_get_time_series)(ts, ns);
+  if (TS_IS_INVALID(rv)) {
+    lua_pushnil(lua);
+  } else {
+    lua_pushnumber(lua, (lua_Number)rv);
+  }
+  return 1;
+}
+
+
+static int TS_NAME(ts_get_range)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 3);
+  uint64_t ns = TS_NAME(check_start_ns)(lua, ts, 2);
+  int n = luaL_checkint(lua, 3);
+  luaL_argcheck(lua, n <= ts->rows, 3, "invalid sequence length");
+
+  int idx = TS_NAME(get_idx)(ts, ns);
+  if (idx == -1) {return 0;}
+
+  lua_createtable(lua, n, 0);
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == ts->rows) {
+      idx = 0;
+    }
+    lua_pushnumber(lua, (lua_Number)ts->v[idx]);
+    lua_rawseti(lua, -2, i + 1);
+  }
+  return 1;
+}
+
+
+static int TS_NAME(ts_stats)(lua_State *lua)
+{
+  static const char *types[] = { "sum", "min", "max", "avg", "sd", "usd",
+    NULL };
+
+  int args = lua_gettop(lua);
+  luaL_argcheck(lua, args >= 3 && args <= 5, 0, "incorrect number of arguments");
+  TS_T *ts = luaL_checkudata(lua, 1, TS_MT);
+  uint64_t ns = TS_NAME(check_start_ns)(lua, ts, 2);
+  int n = luaL_checkint(lua, 3);
+  luaL_argcheck(lua, n <= ts->rows, 3, "invalid sequence length");
+  int type = luaL_checkoption(lua, 4, types[0], types);
+  int include_zero = lua_toboolean(lua, 5);
+
+  int idx = TS_NAME(get_idx)(ts, ns);
+  if (idx == -1) {return 0;}
+
+  sa_running_stats rs;
+  sa_init_running_stats(&rs);
+  double sum = 0;
+  double min = INFINITY;
+  double max = -INFINITY;
+  for (int i = 0; i < n; ++i, ++idx) {
+    if (idx == ts->rows) {
+      idx = 0;
+    }
+    double v = (double)ts->v[idx];
+    if (isnan(v) || (v == 0 && !include_zero)) {continue;}
+    sa_add_running_stats(&rs, v);
+    sum += v;
+    if (v < min) {min = v;}
+    if (v > max) {max = v;}
+  }
+
+  double result = 0;
+  switch (type) {
+  case 0:
+    result = sum;
+    break;
+  case 1:
+    result = min;
+    break;
+  case 2:
+    result = max;
+    break;
+  case 3:
+    result = rs.count != 0 ? sum / rs.count : 0;
+    break;
+  case 4:
+    result = sa_sd_running_stats(&rs);
+    break;
+  case 5:
+    result = sa_usd_running_stats(&rs);
+    break;
+  }
+  lua_pushnumber(lua, result);
+  lua_pushinteger(lua, (lua_Integer)rs.count);
+  return 2;
+}
+
+
+static int TS_NAME(ts_current_time)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 1);
+  lua_pushnumber(lua, (lua_Number)TS_NAME(sa_timestamp_time_series)(ts));
+  return 1;
+}
+
+
+static int TS_NAME(ts_tostring)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 1);
+  size_t len;
+  char *buf = TS_NAME(sa_serialize_time_series)(ts, &len);
+  lua_pushlstring(lua, buf, len);
+  free(buf);
+  return 1;
+}
+
+
+static int TS_NAME(ts_fromstring)(lua_State *lua)
+{
+  TS_T *ts = TS_NAME(check_ts)(lua, 2);
+  size_t len = 0;
+  const char *buf = luaL_checklstring(lua, 2, &len);
+  if (TS_NAME(sa_deserialize_time_series)(ts, buf, len) != 0) {
+    luaL_error(lua, "invalid serialization");
+  }
+  return 0;
+}
+
+
+#ifdef LUA_SANDBOX
+static int TS_NAME(serialize_ts)(lua_State *lua)
+{
+  lsb_output_buffer *ob = lua_touserdata(lua, -1);
+  const char *key = lua_touserdata(lua, -2);
+  TS_T *ts = lua_touserdata(lua, -3);
+  if (!(ob && key && ts)) {
+    return 1;
+  }
+  if (lsb_outputf(ob,
+                  "if %s == nil then %s = "
+                  "streaming_algorithms.time_series.new(%d, %" PRIu64
+                  ", \"%s\") end\n",
+                  key,
+                  key,
+                  ts->rows,
+                  ts->ns_per_row,
+                  TS_TYPE_NAME)) {
+    return 1;
+  }
+
+  if (lsb_outputf(ob, "%s:fromstring(\"", key)) {
+    return 1;
+  }
+  size_t len;
+  char *buf = TS_NAME(sa_serialize_time_series)(ts, &len);
+  if (lsb_serialize_binary(ob, buf, len)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (lsb_outputs(ob, "\")\n", 3)) {
+    return 1;
+  }
+  return 0;
+}
+#endif
+
+
+static const struct luaL_reg TS_NAME(ts_m)[] =
+{
+  { "__tostring", TS_NAME(ts_tostring) },
+  { "add", TS_NAME(ts_add) },
+  { "current_time", TS_NAME(ts_current_time) },
+  { "fromstring", TS_NAME(ts_fromstring) },
+  { "get", TS_NAME(ts_get) },
+  { "get_configuration", TS_NAME(ts_get_configuration) },
+  { "get_range", TS_NAME(ts_get_range) },
+  { "set", TS_NAME(ts_set) },
+  { "stats", TS_NAME(ts_stats) },
+  { NULL, NULL }
+};
+
+#undef TS_T
+#undef TS_NAME
+#undef TS_CAT
+#undef TS_CAT_
+#undef TS_SUFFIX
+#undef TS_TYPE
+#undef TS_TYPE_NAME
+#undef TS_MT
+#undef TS_ENV
+#undef TS_IS_INVALID